@@ -0,0 +1,31 @@
+/**
+ * @file driver/ledc.h
+ * @brief Simulación en host. LEDC: guarda el duty de cada canal y sigue sus fundidos (ver @ref mock_ledc_duty).
+ */
+
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+typedef enum { LEDC_LOW_SPEED_MODE } ledc_mode_t;
+typedef enum { LEDC_TIMER_0, LEDC_TIMER_1, LEDC_TIMER_2, LEDC_TIMER_3 } ledc_timer_t;
+typedef enum { LEDC_CHANNEL_0, LEDC_CHANNEL_1, LEDC_CHANNEL_2, LEDC_CHANNEL_3, LEDC_CHANNEL_4, LEDC_CHANNEL_5, LEDC_CHANNEL_6, LEDC_CHANNEL_7, LEDC_CHANNEL_MAX } ledc_channel_t;
+typedef enum { LEDC_TIMER_1_BIT=1, LEDC_TIMER_8_BIT=8, LEDC_TIMER_10_BIT=10, LEDC_TIMER_11_BIT, LEDC_TIMER_12_BIT } ledc_timer_bit_t;
+typedef enum { LEDC_AUTO_CLK } ledc_clk_cfg_t;
+typedef enum { LEDC_FADE_NO_WAIT, LEDC_FADE_WAIT_DONE } ledc_fade_mode_t;
+typedef enum { LEDC_DUTY_DIR_DECREASE, LEDC_DUTY_DIR_INCREASE } ledc_duty_direction_t;
+typedef struct { ledc_mode_t speed_mode; ledc_timer_bit_t duty_resolution; ledc_timer_t timer_num; uint32_t freq_hz; ledc_clk_cfg_t clk_cfg; bool deconfigure; } ledc_timer_config_t;
+typedef struct { int gpio_num; ledc_mode_t speed_mode; ledc_channel_t channel; int intr_type; ledc_timer_t timer_sel; uint32_t duty; int hpoint; struct { unsigned output_invert: 1; } flags; } ledc_channel_config_t;
+esp_err_t ledc_timer_config(const ledc_timer_config_t *);
+esp_err_t ledc_channel_config(const ledc_channel_config_t *);
+esp_err_t ledc_set_duty(ledc_mode_t, ledc_channel_t, uint32_t);
+esp_err_t ledc_update_duty(ledc_mode_t, ledc_channel_t);
+uint32_t ledc_get_duty(ledc_mode_t, ledc_channel_t);
+esp_err_t ledc_stop(ledc_mode_t, ledc_channel_t, uint32_t);
+esp_err_t ledc_fade_func_install(int);
+esp_err_t ledc_set_fade_with_time(ledc_mode_t, ledc_channel_t, uint32_t, int);
+esp_err_t ledc_fade_start(ledc_mode_t, ledc_channel_t, ledc_fade_mode_t);
+esp_err_t ledc_set_fade_time_and_start(ledc_mode_t, ledc_channel_t, uint32_t, uint32_t, ledc_fade_mode_t);
+esp_err_t ledc_set_duty_and_update(ledc_mode_t, ledc_channel_t, uint32_t, uint32_t);
+esp_err_t ledc_fade_stop(ledc_mode_t, ledc_channel_t);
+esp_err_t ledc_set_fade(ledc_mode_t, ledc_channel_t, uint32_t, ledc_duty_direction_t, uint32_t, uint32_t, uint32_t);
@@ -0,0 +1,25 @@
+/**
+ * @file driver/mcpwm_cap.h
+ * @brief Simulación en host. Captura MCPWM: no disponible, la velocidad se estima por diferencia de cuentas.
+ */
+
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+typedef struct mcpwm_cap_timer_t *mcpwm_cap_timer_handle_t;
+typedef struct mcpwm_cap_channel_t *mcpwm_cap_channel_handle_t;
+typedef enum { MCPWM_CAPTURE_CLK_SRC_DEFAULT } mcpwm_capture_clock_source_t;
+typedef struct { int group_id; mcpwm_capture_clock_source_t clk_src; uint32_t resolution_hz; } mcpwm_capture_timer_config_t;
+typedef struct { int gpio_num; int intr_priority; uint32_t prescale; struct { uint32_t pos_edge:1; uint32_t neg_edge:1; uint32_t pull_up:1; uint32_t pull_down:1; uint32_t invert_cap_signal:1; uint32_t io_loop_back:1; } flags; } mcpwm_capture_channel_config_t;
+esp_err_t mcpwm_new_capture_timer(const mcpwm_capture_timer_config_t *, mcpwm_cap_timer_handle_t *);
+esp_err_t mcpwm_del_capture_timer(mcpwm_cap_timer_handle_t);
+esp_err_t mcpwm_capture_timer_enable(mcpwm_cap_timer_handle_t);
+esp_err_t mcpwm_capture_timer_disable(mcpwm_cap_timer_handle_t);
+esp_err_t mcpwm_capture_timer_start(mcpwm_cap_timer_handle_t);
+esp_err_t mcpwm_capture_timer_get_resolution(mcpwm_cap_timer_handle_t, uint32_t *);
+esp_err_t mcpwm_new_capture_channel(mcpwm_cap_timer_handle_t, const mcpwm_capture_channel_config_t *, mcpwm_cap_channel_handle_t *);
+esp_err_t mcpwm_del_capture_channel(mcpwm_cap_channel_handle_t);
+esp_err_t mcpwm_capture_channel_enable(mcpwm_cap_channel_handle_t);
+esp_err_t mcpwm_capture_channel_disable(mcpwm_cap_channel_handle_t);
+esp_err_t mcpwm_capture_channel_trigger_soft_catch(mcpwm_cap_channel_handle_t);
+esp_err_t mcpwm_capture_get_latched_value(mcpwm_cap_channel_handle_t, uint32_t *);
@@ -0,0 +1,13 @@
+/**
+ * @file driver/usb_serial_jtag.h
+ * @brief Simulación en host. USB Serial/JTAG: la escritura se descarta.
+ */
+
+#pragma once
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+typedef struct { uint32_t tx_buffer_size; uint32_t rx_buffer_size; } usb_serial_jtag_driver_config_t;
+#define USB_SERIAL_JTAG_DRIVER_CONFIG_DEFAULT() {.tx_buffer_size = 256, .rx_buffer_size = 256}
+esp_err_t usb_serial_jtag_driver_install(usb_serial_jtag_driver_config_t *);
+int usb_serial_jtag_write_bytes(const void *, size_t, TickType_t);
+int usb_serial_jtag_read_bytes(void *, uint32_t, TickType_t);
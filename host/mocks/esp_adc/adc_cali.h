@@ -0,0 +1,10 @@
+/**
+ * @file esp_adc/adc_cali.h
+ * @brief Simulación en host. Calibración del ADC: no disponible.
+ */
+
+#pragma once
+#include "esp_err.h"
+#include "hal/adc_types.h"
+typedef struct adc_cali_scheme_t *adc_cali_handle_t;
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t, int, int *);
@@ -0,0 +1,17 @@
+/**
+ * @file esp_adc/adc_oneshot.h
+ * @brief Simulación en host. ADC oneshot: no disponible (sin medida de batería ni de corriente).
+ */
+
+#pragma once
+#include "esp_err.h"
+#include "hal/adc_types.h"
+typedef struct adc_oneshot_unit_ctx_t *adc_oneshot_unit_handle_t;
+typedef enum { ADC_RTC_CLK_SRC_DEFAULT=0 } adc_oneshot_clk_src_t;
+typedef enum { ADC_ULP_MODE_DISABLE=0 } adc_ulp_mode_t;
+typedef struct { adc_unit_t unit_id; adc_oneshot_clk_src_t clk_src; adc_ulp_mode_t ulp_mode; } adc_oneshot_unit_init_cfg_t;
+typedef struct { adc_atten_t atten; adc_bitwidth_t bitwidth; } adc_oneshot_chan_cfg_t;
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t *, adc_oneshot_unit_handle_t *);
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t, adc_channel_t, const adc_oneshot_chan_cfg_t *);
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t, adc_channel_t, int *);
+esp_err_t adc_oneshot_io_to_channel(int, adc_unit_t *, adc_channel_t *);
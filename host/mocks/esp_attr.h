@@ -0,0 +1,12 @@
+/**
+ * @file esp_attr.h
+ * @brief Simulación en host. Atributos de sección: vacíos en el host.
+ */
+
+#pragma once
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+#define EXT_RAM_BSS_ATTR
+#define DMA_ATTR
@@ -0,0 +1,9 @@
+/**
+ * @file esp_cpu.h
+ * @brief Simulación en host. Contador de ciclos: nanosegundos del reloj monotónico del host.
+ */
+
+#pragma once
+#include <stdint.h>
+typedef uint32_t esp_cpu_cycle_count_t;
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void);
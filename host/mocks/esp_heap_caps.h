@@ -0,0 +1,14 @@
+/**
+ * @file esp_heap_caps.h
+ * @brief Simulación en host. Reserva por capacidades: no hay PSRAM, el resto sale de `malloc`.
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+void *heap_caps_malloc(size_t, uint32_t);
+void heap_caps_free(void *);
@@ -0,0 +1,8 @@
+/**
+ * @file esp_intr_alloc.h
+ * @brief Simulación en host. Solo las banderas de reserva de interrupciones.
+ */
+
+#pragma once
+#define ESP_INTR_FLAG_LEVEL1 (1 << 1)
+#define ESP_INTR_FLAG_IRAM (1 << 10)
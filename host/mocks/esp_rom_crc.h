@@ -0,0 +1,8 @@
+/**
+ * @file esp_rom_crc.h
+ * @brief Simulación en host. CRC32 de la ROM, implementado en C.
+ */
+
+#pragma once
+#include <stdint.h>
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
@@ -0,0 +1,8 @@
+/**
+ * @file esp_rom_sys.h
+ * @brief Simulación en host. Espera activa de la ROM.
+ */
+
+#pragma once
+#include <stdint.h>
+void esp_rom_delay_us(uint32_t us);
@@ -0,0 +1,9 @@
+/**
+ * @file esp_timer.h
+ * @brief Simulación en host. esp_timer: reloj virtual que avanza la reproducción (ver @ref mock_avanzar_tiempo).
+ */
+
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+int64_t esp_timer_get_time(void);
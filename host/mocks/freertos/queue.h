@@ -0,0 +1,13 @@
+/**
+ * @file freertos/queue.h
+ * @brief Simulación en host. Colas de FreeRTOS sin bloqueo: las esperas no se hacen (sin planificador).
+ */
+
+#pragma once
+#include "freertos/FreeRTOS.h"
+typedef void *QueueHandle_t;
+QueueHandle_t xQueueCreate(UBaseType_t, UBaseType_t);
+BaseType_t xQueueSend(QueueHandle_t, const void *, TickType_t);
+BaseType_t xQueueSendFromISR(QueueHandle_t, const void *, BaseType_t *);
+BaseType_t xQueueReceive(QueueHandle_t, void *, TickType_t);
+BaseType_t xQueueOverwrite(QueueHandle_t, const void *);
@@ -0,0 +1,12 @@
+/**
+ * @file freertos/semphr.h
+ * @brief Simulación en host. Semáforos de FreeRTOS: no disponibles (sin planificador).
+ */
+
+#pragma once
+#include "freertos/queue.h"
+typedef void *SemaphoreHandle_t;
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t, BaseType_t *);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t);
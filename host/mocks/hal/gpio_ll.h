@@ -0,0 +1,11 @@
+/**
+ * @file hal/gpio_ll.h
+ * @brief Simulación en host. Acceso directo a GPIO: pasa por @ref gpio_set_level.
+ */
+
+#pragma once
+#include <stdint.h>
+#include "soc/gpio_struct.h"
+#include "driver/gpio.h"
+static inline void gpio_ll_set_level(gpio_dev_t *hw, uint32_t gpio_num, uint32_t level) { (void)hw; gpio_set_level((gpio_num_t)gpio_num, level); }
+static inline int gpio_ll_get_level(gpio_dev_t *hw, uint32_t gpio_num) { (void)hw; return gpio_get_level((gpio_num_t)gpio_num); }
@@ -0,0 +1,52 @@
+/**
+ * @file mock_hw.h
+ * @brief Control de los periféricos simulados desde la reproducción en host.
+ * @details
+ * Las cabeceras de esta carpeta sustituyen a las de ESP-IDF con la misma ruta, de modo que el
+ * firmware de `main/` compila sin cambios en Linux. El estado de los periféricos vive en
+ * `mocks.c`; estas funciones permiten a la reproducción marcar el tiempo y cerrar el lazo con un
+ * modelo de planta del motor:
+ * - El tiempo de `esp_timer_get_time()` es virtual y solo avanza con @ref mock_avanzar_tiempo.
+ * - El duty de cada canal LEDC y el nivel de cada GPIO de salida se leen con @ref mock_ledc_duty y
+ *   @ref mock_gpio_nivel.
+ * - La cuenta del PCNT la mueve @ref mock_pcnt_mover paso a paso, disparando los puntos de
+ *   observación igual que el hardware.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+
+/**
+ * @brief Avanza el reloj virtual de `esp_timer_get_time()` y del tick de FreeRTOS.
+ * @param us Microsegundos a avanzar.
+ */
+void mock_avanzar_tiempo(int64_t us);
+
+/**
+ * @brief Duty actual de un canal LEDC: el último escrito y actualizado o, durante un fundido de
+ * `ledc_set_fade()`, el punto del fundido según el tiempo virtual.
+ */
+uint32_t mock_ledc_duty(ledc_channel_t canal);
+
+/**
+ * @brief Nivel del último `gpio_set_level()` sobre un pin (0 si nunca se ha escrito).
+ */
+int mock_gpio_nivel(gpio_num_t pin);
+
+/**
+ * @brief Mueve la cuenta de la unidad PCNT creada por el firmware.
+ * @param pasos Pasos del encoder (positivo hacia la posición máxima).
+ * @details Avanza de uno en uno y llama a `on_reach` al pasar por cada punto de observación. Sin
+ * unidad creada no hace nada.
+ */
+void mock_pcnt_mover(int pasos);
+
+/**
+ * @brief Ejecuta una línea como la REPL: busca el comando registrado y le pasa los argumentos.
+ * @param linea Comando y argumentos separados por espacios.
+ * @return Valor devuelto por el comando, o -1 si no está registrado.
+ */
+int mock_consola_ejecutar(const char *linea);
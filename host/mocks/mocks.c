@@ -0,0 +1,668 @@
+/**
+ * @file mocks.c
+ * @brief Estado e implementación de los periféricos simulados en host (ver @ref mock_hw.h).
+ * @details Los periféricos que el firmware trata como opcionales (captura MCPWM, ADC, sensor de
+ * temperatura, NVS) devuelven `ESP_ERR_NOT_SUPPORTED` y el firmware sigue por su camino sin ellos.
+ * No hay planificador: las tareas no se crean y las esperas vuelven enseguida. Las colas son FIFO
+ * reales, sin bloqueo, para que productor y consumidor en el mismo hilo se comuniquen.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mock_hw.h"
+#include "esp_console.h"
+#include "esp_cpu.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "driver/gptimer.h"
+#include "driver/ledc.h"
+#include "driver/mcpwm_cap.h"
+#include "driver/pulse_cnt.h"
+#include "driver/temperature_sensor.h"
+#include "driver/usb_serial_jtag.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_adc/adc_oneshot.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "soc/gpio_struct.h"
+
+#define MOCK_NUM_GPIO 64          ///< Pines simulados.
+#define MOCK_NUM_LEDC 8           ///< Canales LEDC simulados.
+#define MOCK_NUM_TEMPORIZADORES_LEDC 4 ///< Temporizadores LEDC simulados.
+#define MOCK_PUNTOS_OBSERVACION 8 ///< Puntos de observación por unidad PCNT.
+#define MOCK_COMANDOS 16          ///< Comandos de consola registrables.
+#define MOCK_ARGUMENTOS 8         ///< Argumentos por línea de consola.
+
+// ==========================
+//   Reloj
+// ==========================
+
+static int64_t tiempoVirtualUs = 0; ///< Tiempo de `esp_timer_get_time()`.
+
+void mock_avanzar_tiempo(int64_t us)
+{
+  tiempoVirtualUs += us;
+}
+
+int64_t esp_timer_get_time(void)
+{
+  return tiempoVirtualUs;
+}
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (esp_cpu_cycle_count_t)((uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec);
+}
+
+// ==========================
+//   GPIO y LEDC
+// ==========================
+
+gpio_dev_t GPIO;
+static int nivelGpio[MOCK_NUM_GPIO];
+
+/**
+ * @brief Fundido por hardware de un canal: `pasos` incrementos de `escala` cada `ciclos` periodos del PWM.
+ */
+struct mock_fundido
+{
+  int32_t escala; ///< Incremento por paso, con signo.
+  uint32_t pasos;
+  uint32_t ciclos;
+};
+
+static uint32_t dutyPendiente[MOCK_NUM_LEDC];
+static uint32_t dutyLedc[MOCK_NUM_LEDC];
+static struct mock_fundido fundidoPendiente[MOCK_NUM_LEDC];
+static struct mock_fundido fundidoLedc[MOCK_NUM_LEDC];
+static int64_t inicioFundidoUs[MOCK_NUM_LEDC];
+static uint32_t frecuenciaLedc[MOCK_NUM_TEMPORIZADORES_LEDC];
+static ledc_timer_t temporizadorCanal[MOCK_NUM_LEDC];
+
+int mock_gpio_nivel(gpio_num_t pin)
+{
+  return (pin >= 0 && pin < MOCK_NUM_GPIO) ? nivelGpio[pin] : 0;
+}
+
+// El fundido avanza con el tiempo virtual, a la frecuencia del temporizador del canal
+uint32_t mock_ledc_duty(ledc_channel_t canal)
+{
+  if (canal >= MOCK_NUM_LEDC)
+  {
+    return 0;
+  }
+  const struct mock_fundido *f = &fundidoLedc[canal];
+  if (f->pasos == 0)
+  {
+    return dutyLedc[canal];
+  }
+  uint64_t periodos = (uint64_t)(tiempoVirtualUs - inicioFundidoUs[canal]) * frecuenciaLedc[temporizadorCanal[canal]] / 1000000;
+  uint64_t hechos = periodos / (f->ciclos ? f->ciclos : 1);
+  if (hechos > f->pasos)
+  {
+    hechos = f->pasos;
+  }
+  return (uint32_t)((int64_t)dutyLedc[canal] + f->escala * (int64_t)hechos);
+}
+
+esp_err_t gpio_config(const gpio_config_t *cfg)
+{
+  return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t pin)
+{
+  return mock_gpio_nivel(pin);
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t nivel)
+{
+  if (pin < 0 || pin >= MOCK_NUM_GPIO)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+  nivelGpio[pin] = nivel ? 1 : 0;
+  return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int flags) { return ESP_OK; }
+esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t isr, void *arg) { return ESP_OK; }
+esp_err_t gpio_isr_handler_remove(gpio_num_t pin) { return ESP_OK; }
+esp_err_t gpio_intr_enable(gpio_num_t pin) { return ESP_OK; }
+esp_err_t gpio_intr_disable(gpio_num_t pin) { return ESP_OK; }
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *cfg)
+{
+  if (cfg->timer_num >= MOCK_NUM_TEMPORIZADORES_LEDC)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+  frecuenciaLedc[cfg->timer_num] = cfg->freq_hz;
+  return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t *cfg)
+{
+  if (cfg->channel >= MOCK_NUM_LEDC || cfg->timer_sel >= MOCK_NUM_TEMPORIZADORES_LEDC)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+  temporizadorCanal[cfg->channel] = cfg->timer_sel;
+  dutyPendiente[cfg->channel] = dutyLedc[cfg->channel] = cfg->duty;
+  fundidoPendiente[cfg->channel].pasos = fundidoLedc[cfg->channel].pasos = 0;
+  return ESP_OK;
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t modo, ledc_channel_t canal, uint32_t duty)
+{
+  if (canal >= MOCK_NUM_LEDC)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+  dutyPendiente[canal] = duty;
+  fundidoPendiente[canal].pasos = 0;
+  return ESP_OK;
+}
+
+esp_err_t ledc_set_fade(ledc_mode_t modo, ledc_channel_t canal, uint32_t duty, ledc_duty_direction_t sentido,
+                        uint32_t pasos, uint32_t ciclos, uint32_t escala)
+{
+  if (canal >= MOCK_NUM_LEDC || pasos > 1023 || ciclos > 1023 || escala > 1023)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+  dutyPendiente[canal] = duty;
+  fundidoPendiente[canal].escala = (sentido == LEDC_DUTY_DIR_INCREASE) ? (int32_t)escala : -(int32_t)escala;
+  fundidoPendiente[canal].pasos = pasos;
+  fundidoPendiente[canal].ciclos = ciclos;
+  return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t modo, ledc_channel_t canal)
+{
+  if (canal >= MOCK_NUM_LEDC)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+  dutyLedc[canal] = dutyPendiente[canal];
+  fundidoLedc[canal] = fundidoPendiente[canal];
+  inicioFundidoUs[canal] = tiempoVirtualUs;
+  return ESP_OK;
+}
+
+uint32_t ledc_get_duty(ledc_mode_t modo, ledc_channel_t canal) { return mock_ledc_duty(canal); }
+
+esp_err_t ledc_stop(ledc_mode_t modo, ledc_channel_t canal, uint32_t nivel)
+{
+  return ledc_set_duty_and_update(modo, canal, 0, 0);
+}
+
+esp_err_t ledc_fade_func_install(int flags) { return ESP_OK; }
+
+// Congela el fundido de ledc_set_fade() en el punto al que ha llegado
+esp_err_t ledc_fade_stop(ledc_mode_t modo, ledc_channel_t canal)
+{
+  if (canal >= MOCK_NUM_LEDC)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+  dutyLedc[canal] = mock_ledc_duty(canal);
+  fundidoLedc[canal].pasos = 0;
+  return ESP_OK;
+}
+
+// Los fundidos por tiempo se aplican de golpe: el tiempo virtual solo avanza entre ciclos de control
+esp_err_t ledc_set_fade_with_time(ledc_mode_t modo, ledc_channel_t canal, uint32_t duty, int ms)
+{
+  return ledc_set_duty(modo, canal, duty);
+}
+
+esp_err_t ledc_fade_start(ledc_mode_t modo, ledc_channel_t canal, ledc_fade_mode_t espera)
+{
+  return ledc_update_duty(modo, canal);
+}
+
+esp_err_t ledc_set_fade_time_and_start(ledc_mode_t modo, ledc_channel_t canal, uint32_t duty, uint32_t ms, ledc_fade_mode_t espera)
+{
+  ledc_set_duty(modo, canal, duty);
+  return ledc_update_duty(modo, canal);
+}
+
+esp_err_t ledc_set_duty_and_update(ledc_mode_t modo, ledc_channel_t canal, uint32_t duty, uint32_t hpoint)
+{
+  ledc_set_duty(modo, canal, duty);
+  return ledc_update_duty(modo, canal);
+}
+
+// ==========================
+//   PCNT
+// ==========================
+
+struct pcnt_unit_t
+{
+  int cuenta;
+  int puntos[MOCK_PUNTOS_OBSERVACION];
+  bool pendientes[MOCK_PUNTOS_OBSERVACION]; ///< Añadido tras la última puesta a cero: aún no compara.
+  int numPuntos;
+  pcnt_watch_cb_t alAlcanzar;
+  void *contexto;
+  bool enMarcha;
+};
+
+struct pcnt_chan_t
+{
+  int reservado;
+};
+
+static struct pcnt_unit_t unidadPcnt;
+static bool unidadPcntCreada = false;
+static struct pcnt_chan_t canalesPcnt[2];
+
+void mock_pcnt_mover(int pasos)
+{
+  struct pcnt_unit_t *u = &unidadPcnt;
+  if (!unidadPcntCreada || !u->enMarcha)
+  {
+    return;
+  }
+  int paso = (pasos > 0) ? 1 : -1;
+  for (int i = 0; i != pasos; i += paso)
+  {
+    u->cuenta += paso;
+    for (int p = 0; p < u->numPuntos; p++)
+    {
+      if (u->puntos[p] == u->cuenta && !u->pendientes[p] && u->alAlcanzar != NULL)
+      {
+        pcnt_watch_event_data_t evento = {.watch_point_value = u->cuenta};
+        u->alAlcanzar(u, &evento, u->contexto);
+      }
+    }
+  }
+}
+
+esp_err_t pcnt_new_unit(const pcnt_unit_config_t *cfg, pcnt_unit_handle_t *unidad)
+{
+  if (unidadPcntCreada)
+  {
+    return ESP_ERR_NOT_FOUND;
+  }
+  memset(&unidadPcnt, 0, sizeof(unidadPcnt));
+  unidadPcntCreada = true;
+  *unidad = &unidadPcnt;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_del_unit(pcnt_unit_handle_t unidad)
+{
+  unidadPcntCreada = false;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_set_glitch_filter(pcnt_unit_handle_t unidad, const pcnt_glitch_filter_config_t *cfg) { return ESP_OK; }
+
+esp_err_t pcnt_new_channel(pcnt_unit_handle_t unidad, const pcnt_chan_config_t *cfg, pcnt_channel_handle_t *canal)
+{
+  *canal = &canalesPcnt[cfg->edge_gpio_num & 1];
+  return ESP_OK;
+}
+
+esp_err_t pcnt_del_channel(pcnt_channel_handle_t canal) { return ESP_OK; }
+esp_err_t pcnt_channel_set_edge_action(pcnt_channel_handle_t canal, pcnt_channel_edge_action_t sube, pcnt_channel_edge_action_t baja) { return ESP_OK; }
+esp_err_t pcnt_channel_set_level_action(pcnt_channel_handle_t canal, pcnt_channel_level_action_t alto, pcnt_channel_level_action_t bajo) { return ESP_OK; }
+
+esp_err_t pcnt_unit_add_watch_point(pcnt_unit_handle_t unidad, int valor)
+{
+  for (int p = 0; p < unidad->numPuntos; p++)
+  {
+    if (unidad->puntos[p] == valor)
+    {
+      return ESP_ERR_INVALID_STATE;
+    }
+  }
+  if (unidad->numPuntos == MOCK_PUNTOS_OBSERVACION)
+  {
+    return ESP_ERR_NOT_FOUND;
+  }
+  // Como en el hardware, el punto nuevo no compara hasta la siguiente pcnt_unit_clear_count()
+  unidad->pendientes[unidad->numPuntos] = true;
+  unidad->puntos[unidad->numPuntos++] = valor;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_remove_watch_point(pcnt_unit_handle_t unidad, int valor)
+{
+  for (int p = 0; p < unidad->numPuntos; p++)
+  {
+    if (unidad->puntos[p] == valor)
+    {
+      unidad->numPuntos--;
+      unidad->puntos[p] = unidad->puntos[unidad->numPuntos];
+      unidad->pendientes[p] = unidad->pendientes[unidad->numPuntos];
+      return ESP_OK;
+    }
+  }
+  return ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t pcnt_unit_register_event_callbacks(pcnt_unit_handle_t unidad, const pcnt_event_callbacks_t *cbs, void *contexto)
+{
+  unidad->alAlcanzar = cbs->on_reach;
+  unidad->contexto = contexto;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_enable(pcnt_unit_handle_t unidad) { return ESP_OK; }
+esp_err_t pcnt_unit_disable(pcnt_unit_handle_t unidad) { return ESP_OK; }
+
+esp_err_t pcnt_unit_start(pcnt_unit_handle_t unidad)
+{
+  unidad->enMarcha = true;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_stop(pcnt_unit_handle_t unidad)
+{
+  unidad->enMarcha = false;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_clear_count(pcnt_unit_handle_t unidad)
+{
+  unidad->cuenta = 0;
+  memset(unidad->pendientes, 0, sizeof(unidad->pendientes));
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_get_count(pcnt_unit_handle_t unidad, int *cuenta)
+{
+  *cuenta = unidad->cuenta;
+  return ESP_OK;
+}
+
+// ==========================
+//   Periféricos no disponibles
+// ==========================
+
+esp_err_t mcpwm_new_capture_timer(const mcpwm_capture_timer_config_t *cfg, mcpwm_cap_timer_handle_t *t) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t mcpwm_del_capture_timer(mcpwm_cap_timer_handle_t t) { return ESP_OK; }
+esp_err_t mcpwm_capture_timer_enable(mcpwm_cap_timer_handle_t t) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t mcpwm_capture_timer_disable(mcpwm_cap_timer_handle_t t) { return ESP_OK; }
+esp_err_t mcpwm_capture_timer_start(mcpwm_cap_timer_handle_t t) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t mcpwm_capture_timer_get_resolution(mcpwm_cap_timer_handle_t t, uint32_t *r) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t mcpwm_new_capture_channel(mcpwm_cap_timer_handle_t t, const mcpwm_capture_channel_config_t *cfg, mcpwm_cap_channel_handle_t *c) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t mcpwm_del_capture_channel(mcpwm_cap_channel_handle_t c) { return ESP_OK; }
+esp_err_t mcpwm_capture_channel_enable(mcpwm_cap_channel_handle_t c) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t mcpwm_capture_channel_disable(mcpwm_cap_channel_handle_t c) { return ESP_OK; }
+esp_err_t mcpwm_capture_channel_trigger_soft_catch(mcpwm_cap_channel_handle_t c) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t mcpwm_capture_get_latched_value(mcpwm_cap_channel_handle_t c, uint32_t *v) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t *cfg, adc_continuous_handle_t *h) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t adc_continuous_config(adc_continuous_handle_t h, const adc_continuous_config_t *cfg) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t adc_continuous_register_event_callbacks(adc_continuous_handle_t h, const adc_continuous_evt_cbs_t *cbs, void *ctx) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t adc_continuous_start(adc_continuous_handle_t h) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t adc_continuous_stop(adc_continuous_handle_t h) { return ESP_OK; }
+esp_err_t adc_continuous_read(adc_continuous_handle_t h, uint8_t *buf, uint32_t n, uint32_t *leidos, uint32_t ms) { return ESP_ERR_TIMEOUT; }
+esp_err_t adc_continuous_io_to_channel(int pin, adc_unit_t *u, adc_channel_t *c) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t *cfg, adc_oneshot_unit_handle_t *h) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t h, adc_channel_t c, const adc_oneshot_chan_cfg_t *cfg) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t h, adc_channel_t c, int *v) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t adc_oneshot_io_to_channel(int pin, adc_unit_t *u, adc_channel_t *c) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t adc_cali_create_scheme_curve_fitting(const adc_cali_curve_fitting_config_t *cfg, adc_cali_handle_t *h) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t h, int crudo, int *mv) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t temperature_sensor_install(const temperature_sensor_config_t *cfg, temperature_sensor_handle_t *h) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t temperature_sensor_enable(temperature_sensor_handle_t h) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t temperature_sensor_get_celsius(temperature_sensor_handle_t h, float *c) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t usb_serial_jtag_driver_install(usb_serial_jtag_driver_config_t *cfg) { return ESP_OK; }
+int usb_serial_jtag_write_bytes(const void *datos, size_t n, TickType_t espera) { return (int)n; }
+int usb_serial_jtag_read_bytes(void *datos, uint32_t n, TickType_t espera) { return 0; }
+
+esp_err_t nvs_flash_init(void) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t nvs_flash_erase(void) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t nvs_open(const char *nombre, nvs_open_mode_t modo, nvs_handle_t *h) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *clave, void *datos, size_t *n) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *clave, const void *datos, size_t n) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t nvs_commit(nvs_handle_t h) { return ESP_ERR_NOT_SUPPORTED; }
+void nvs_close(nvs_handle_t h) {}
+
+// ==========================
+//   Consola
+// ==========================
+
+static esp_console_cmd_t comandos[MOCK_COMANDOS];
+static int numComandos = 0;
+
+esp_err_t esp_console_new_repl_uart(const esp_console_dev_uart_config_t *dev, const esp_console_repl_config_t *cfg, esp_console_repl_t **repl)
+{
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_console_start_repl(esp_console_repl_t *repl) { return ESP_ERR_NOT_SUPPORTED; }
+esp_err_t esp_console_register_help_command(void) { return ESP_OK; }
+
+esp_err_t esp_console_cmd_register(const esp_console_cmd_t *cmd)
+{
+  if (numComandos == MOCK_COMANDOS)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+  comandos[numComandos++] = *cmd;
+  return ESP_OK;
+}
+
+int mock_consola_ejecutar(const char *linea)
+{
+  static char copia[256];
+  char *argv[MOCK_ARGUMENTOS];
+  int argc = 0;
+  strncpy(copia, linea, sizeof(copia) - 1);
+  for (char *p = strtok(copia, " "); p != NULL && argc < MOCK_ARGUMENTOS; p = strtok(NULL, " "))
+  {
+    argv[argc++] = p;
+  }
+  for (int i = 0; argc > 0 && i < numComandos; i++)
+  {
+    if (strcmp(comandos[i].command, argv[0]) == 0)
+    {
+      return comandos[i].func(argc, argv);
+    }
+  }
+  return -1;
+}
+
+// ==========================
+//   Temporizador y FreeRTOS
+// ==========================
+
+struct gptimer_t
+{
+  int reservado;
+};
+
+static struct gptimer_t temporizador;
+
+esp_err_t gptimer_new_timer(const gptimer_config_t *cfg, gptimer_handle_t *t)
+{
+  *t = &temporizador;
+  return ESP_OK;
+}
+
+esp_err_t gptimer_register_event_callbacks(gptimer_handle_t t, const gptimer_event_callbacks_t *cbs, void *ctx) { return ESP_OK; }
+esp_err_t gptimer_set_alarm_action(gptimer_handle_t t, const gptimer_alarm_config_t *cfg) { return ESP_OK; }
+esp_err_t gptimer_enable(gptimer_handle_t t) { return ESP_OK; }
+esp_err_t gptimer_start(gptimer_handle_t t) { return ESP_OK; }
+esp_err_t gptimer_stop(gptimer_handle_t t) { return ESP_OK; }
+
+esp_err_t gptimer_get_raw_count(gptimer_handle_t t, uint64_t *cuenta)
+{
+  *cuenta = (uint64_t)tiempoVirtualUs;
+  return ESP_OK;
+}
+
+BaseType_t xPortGetCoreID(void) { return 0; }
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t f, const char *nombre, uint32_t pila, void *param, UBaseType_t prioridad, TaskHandle_t *tarea, BaseType_t nucleo)
+{
+  return pdFAIL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t f, const char *nombre, uint32_t pila, void *param, UBaseType_t prioridad, TaskHandle_t *tarea)
+{
+  return pdFAIL;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+  return (TickType_t)(tiempoVirtualUs / (1000000 / configTICK_RATE_HZ));
+}
+
+void vTaskDelay(TickType_t ticks) {}
+void vTaskDelayUntil(TickType_t *anterior, TickType_t periodo) { *anterior += periodo; }
+
+BaseType_t xTaskDelayUntil(TickType_t *anterior, TickType_t periodo)
+{
+  // FreeRTOS hace configASSERT del incremento: un periodo de 0 ticks aborta en el firmware
+  assert(periodo > 0);
+  *anterior += periodo;
+  return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t limpiar, TickType_t espera) { return 0; }
+void vTaskNotifyGiveFromISR(TaskHandle_t tarea, BaseType_t *despertar) {}
+BaseType_t xTaskNotifyGive(TaskHandle_t tarea) { return pdPASS; }
+TaskHandle_t xTaskGetCurrentTaskHandle(void) { return NULL; }
+void vTaskDelete(TaskHandle_t tarea) {}
+
+/**
+ * @struct mock_cola
+ * @brief Cola simulada: anillo de `longitud` elementos de `tamano` bytes.
+ */
+struct mock_cola
+{
+  UBaseType_t longitud;
+  UBaseType_t tamano;
+  UBaseType_t primero;
+  UBaseType_t ocupados;
+  uint8_t datos[];
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t n, UBaseType_t tamano)
+{
+  struct mock_cola *c = calloc(1, sizeof(struct mock_cola) + (size_t)n * tamano);
+  if (c != NULL)
+  {
+    c->longitud = n;
+    c->tamano = tamano;
+  }
+  return c;
+}
+
+BaseType_t xQueueSend(QueueHandle_t cola, const void *e, TickType_t espera)
+{
+  struct mock_cola *c = cola;
+  if (c == NULL || c->ocupados == c->longitud)
+  {
+    return pdFAIL;
+  }
+  memcpy(&c->datos[((c->primero + c->ocupados) % c->longitud) * c->tamano], e, c->tamano);
+  c->ocupados++;
+  return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t c, const void *e, BaseType_t *despertar) { return xQueueSend(c, e, 0); }
+
+BaseType_t xQueueReceive(QueueHandle_t cola, void *e, TickType_t espera)
+{
+  struct mock_cola *c = cola;
+  if (c == NULL || c->ocupados == 0)
+  {
+    return pdFAIL;
+  }
+  memcpy(e, &c->datos[c->primero * c->tamano], c->tamano);
+  c->primero = (c->primero + 1) % c->longitud;
+  c->ocupados--;
+  return pdPASS;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t cola, const void *e)
+{
+  struct mock_cola *c = cola;
+  if (c == NULL)
+  {
+    return pdFAIL;
+  }
+  c->primero = 0;
+  c->ocupados = 0;
+  return xQueueSend(c, e, 0);
+}
+SemaphoreHandle_t xSemaphoreCreateBinary(void) { return NULL; }
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s) { return pdFAIL; }
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t s, BaseType_t *despertar) { return pdFAIL; }
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t espera) { return pdFAIL; }
+
+// ==========================
+//   Utilidades
+// ==========================
+
+void *heap_caps_malloc(size_t n, uint32_t capacidades)
+{
+  return (capacidades & MALLOC_CAP_SPIRAM) ? NULL : malloc(n);
+}
+
+void heap_caps_free(void *p) { free(p); }
+
+// El tiempo virtual lo avanza la reproducción; una espera de microsegundos no lo mueve
+void esp_rom_delay_us(uint32_t us) {}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; i++)
+  {
+    crc ^= buf[i];
+    for (int b = 0; b < 8; b++)
+    {
+      crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1u));
+    }
+  }
+  return ~crc;
+}
+
+const char *esp_err_to_name(esp_err_t err)
+{
+  switch (err)
+  {
+  case ESP_OK:
+    return "ESP_OK";
+  case ESP_ERR_NO_MEM:
+    return "ESP_ERR_NO_MEM";
+  case ESP_ERR_INVALID_ARG:
+    return "ESP_ERR_INVALID_ARG";
+  case ESP_ERR_INVALID_STATE:
+    return "ESP_ERR_INVALID_STATE";
+  case ESP_ERR_NOT_FOUND:
+    return "ESP_ERR_NOT_FOUND";
+  case ESP_ERR_NOT_SUPPORTED:
+    return "ESP_ERR_NOT_SUPPORTED";
+  case ESP_ERR_TIMEOUT:
+    return "ESP_ERR_TIMEOUT";
+  default:
+    return "ESP_FAIL";
+  }
+}
@@ -0,0 +1,10 @@
+/**
+ * @file sdkconfig.h
+ * @brief Simulación en host. Configuración de la compilación en host: sin `CONFIG_IDF_TARGET_ESP32S3`, así que se usan las
+ * referencias escalares. El contador de ciclos simulado cuenta nanosegundos, de ahí la frecuencia de 1000 MHz.
+ */
+
+#pragma once
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_FREERTOS_HZ 100
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 1000
@@ -0,0 +1,8 @@
+/**
+ * @file soc/gpio_struct.h
+ * @brief Simulación en host. Registros de GPIO.
+ */
+
+#pragma once
+typedef struct { int dummy; } gpio_dev_t;
+extern gpio_dev_t GPIO;
@@ -0,0 +1,603 @@
+/**
+ * @file replay_emg.c
+ * @brief Reproducción en host de registros EMG por la cadena completa del firmware.
+ * @details
+ * Compila `main/` tal cual contra los periféricos simulados de `mocks/` y pasa un registro por las
+ * mismas funciones que las tareas de @ref tareas_nucleos.h, sin planificador y más rápido que en
+ * tiempo real:
+ * - Cada bloque de @ref ANILLO_MUESTRAS_POR_BLOQUE muestras se filtra (@ref filtro_procesar_bloque)
+ *   y pasa por la ventana deslizante con la decisión de @ref tareas_decidir en cada salto. Con
+ *   @ref ESPECTRO_EMG la etapa espectral se ejecuta en línea justo después del filtro, en lugar
+ *   de en su tarea, y se mide aparte.
+ * - Entre bloque y bloque se ejecutan los periodos de @ref activacionMotores que le tocan a
+ *   @ref FREC_BUCLE_CONTROL y un modelo de planta convierte el duty y la dirección del motor en
+ *   pasos del encoder simulado. El reloj de `esp_timer` avanza un periodo de control cada vez.
+ * - En @ref ESTADO_NORMAL la activación cierra la mano y el reposo la abre (@ref FASE_PASO_2 y
+ *   @ref FASE_PASO_1): es el mando mínimo para que el motor siga a la decisión. Con `-g` manda en
+ *   su lugar el decodificador de gestos (@ref gestos_aplicar), como en el firmware. Los gestos
+ *   reconocidos se cuentan en los dos casos.
+ *
+ * Al terminar imprime el rendimiento (muestras/s y veces el tiempo real), la latencia de cada
+ * etapa medida con el reloj del host y, si el registro está etiquetado, la exactitud de la
+ * decisión por umbrales y de la red (@ref result), junto con la latencia desde el inicio de cada
+ * contracción hasta la detección y hasta la orden de cierre al motor.
+ *
+ * Formato del registro: una muestra cruda del ADC (0–4095) por línea a @ref SAMPLING_FREQ,
+ * opcionalmente seguida de `,etiqueta` (0 = reposo, 1 = contracción). Las líneas vacías o que
+ * empiezan por `#` se ignoran. Sin archivo se genera una señal sintética etiquetada. El registro
+ * tiene un solo canal: con varios canales en @ref CANALES_EMG se copia en todas las filas del bloque.
+ *
+ * `replay_emg_float` es esta misma reproducción compilada con @ref EMG_MUESTRA_FLOAT: la señal
+ * filtrada y las sumas de las ventanas van en coma flotante y sus resultados son la referencia de
+ * la variante entera con el mismo registro.
+ *
+ * Con `-p` se vuelcan además los histogramas de las sondas del firmware (@ref perfilado.h) con el
+ * comando `perf`, en nanosegundos del host; las etapas de las tareas se miden con las mismas sondas
+ * en los puntos equivalentes de la reproducción.
+ *
+ * Uso: `replay_emg [-a umbral_act_mav] [-d umbral_des_mav] [-r repeticiones] [-s segundos] [-g] [-p] [registro.csv]`
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include "mock_hw.h"
+#include "tareas_nucleos.h"
+
+#define REPLAY_UMBRAL_ACT_MAV 150.0f   ///< Umbral de activación MAV por defecto (cuentas filtradas).
+#define REPLAY_UMBRAL_DES_MAV 90.0f    ///< Umbral de desactivación MAV por defecto.
+#define REPLAY_SEGUNDOS_SINTETICO 60   ///< Duración por defecto de la señal sintética.
+#define REPLAY_TAU_MOTOR_S 0.02f       ///< Constante de tiempo mecánica del modelo de planta (s).
+#define REPLAY_SIN_ETIQUETA (-1)       ///< Etiqueta de las muestras de un registro sin etiquetar.
+
+/// Periodos de control por bloque: el bloque llega cada `ANILLO_MUESTRAS_POR_BLOQUE / SAMPLING_FREQ` s.
+#define REPLAY_PERIODOS_POR_BLOQUE (ANILLO_MUESTRAS_POR_BLOQUE * FREC_BUCLE_CONTROL / SAMPLING_FREQ)
+_Static_assert(REPLAY_PERIODOS_POR_BLOQUE >= 1, "El bucle de control debe ejecutarse al menos una vez por bloque");
+
+/**
+ * @struct registro_emg
+ * @brief Registro cargado en memoria.
+ */
+struct registro_emg
+{
+  uint16_t *muestras; ///< Muestras crudas del ADC.
+  int8_t *etiquetas;  ///< 0/1 por muestra, o @ref REPLAY_SIN_ETIQUETA.
+  uint32_t n;         ///< Número de muestras.
+  bool etiquetado;    ///< `true` si todas las muestras tienen etiqueta.
+};
+
+/**
+ * @struct estadistica_etapa
+ * @brief Tiempo de host consumido por una etapa del procesado.
+ */
+struct estadistica_etapa
+{
+  const char *nombre;
+  uint64_t totalNs;
+  uint64_t maximoNs;
+  uint64_t llamadas;
+};
+
+/**
+ * @struct matriz_confusion
+ * @brief Aciertos y fallos de una decisión por salto de ventana frente a la etiqueta.
+ */
+struct matriz_confusion
+{
+  uint64_t vp, fp, vn, fn;
+};
+
+/**
+ * @struct latencia_activacion
+ * @brief Retardo desde el inicio etiquetado de cada contracción hasta un evento.
+ */
+struct latencia_activacion
+{
+  double totalMs;
+  double maximaMs;
+  uint32_t medidas;
+  uint32_t perdidas; ///< Contracciones terminadas sin que llegara el evento.
+};
+
+enum Etapa_Replay
+{
+  ETAPA_FILTRO,
+  ETAPA_ESPECTRO,
+  ETAPA_VENTANA,
+  ETAPA_DECISION,
+  ETAPA_CONTROL,
+  NUMERO_ETAPAS
+};
+
+static struct estadistica_etapa etapas[NUMERO_ETAPAS] = {
+  {"filtro (bloque)"},
+  {"espectro (bloque)"},
+  {"características (bloque)"},
+  {"decisión (salto)"},
+  {"control (periodo)"},
+};
+
+static const struct registro_emg *registro;      ///< Registro en reproducción.
+static uint64_t muestraBase;                     ///< Índice absoluto (desde el arranque) de la primera muestra del bloque en curso.
+static uint32_t desplazamientoBloque;            ///< Posición en @ref registro de la primera muestra del bloque en curso.
+static struct matriz_confusion confusionUmbrales;
+static struct matriz_confusion confusionRed;
+static struct latencia_activacion latenciaDeteccion;
+static struct latencia_activacion latenciaMotor;
+static int64_t inicioContraccionUs = -1;         ///< Tiempo virtual del inicio de la contracción en curso (-1 = reposo).
+static bool deteccionEnContraccion;
+static bool cierreEnContraccion;
+static bool mandoGestos;                          ///< `true` = la máquina de estados la mueven los gestos (`-g`).
+static uint32_t gestosReconocidos[GESTO_PULSO_DOBLE + 1]; ///< Gestos recogidos de @ref colaGestos, por @ref Tipo_Gesto.
+
+static inline uint64_t replay_ns()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+}
+
+static inline void replay_anotar(enum Etapa_Replay etapa, uint64_t ns)
+{
+  struct estadistica_etapa *e = &etapas[etapa];
+  e->totalNs += ns;
+  e->llamadas++;
+  if (ns > e->maximoNs)
+  {
+    e->maximoNs = ns;
+  }
+}
+
+static inline void replay_confusion(struct matriz_confusion *c, bool decision, bool etiqueta)
+{
+  if (decision)
+  {
+    etiqueta ? c->vp++ : c->fp++;
+  }
+  else
+  {
+    etiqueta ? c->fn++ : c->vn++;
+  }
+}
+
+static inline void replay_latencia(struct latencia_activacion *l, int64_t ahoraUs)
+{
+  double ms = (ahoraUs - inicioContraccionUs) / 1000.0;
+  l->totalMs += ms;
+  l->medidas++;
+  if (ms > l->maximaMs)
+  {
+    l->maximaMs = ms;
+  }
+}
+
+static inline int64_t replay_tiempo_muestra(uint64_t muestra)
+{
+  return (int64_t)(muestra * 1000000u / SAMPLING_FREQ);
+}
+
+// ==========================
+//   Carga del registro
+// ==========================
+
+/**
+ * @brief Carga un registro CSV.
+ * @return `true` si se ha leído al menos una muestra.
+ */
+static bool replay_cargar(const char *ruta, struct registro_emg *r)
+{
+  FILE *f = fopen(ruta, "r");
+  if (f == NULL)
+  {
+    perror(ruta);
+    return false;
+  }
+
+  uint32_t capacidad = 1u << 16;
+  r->muestras = malloc(capacidad * sizeof(*r->muestras));
+  r->etiquetas = malloc(capacidad * sizeof(*r->etiquetas));
+  r->n = 0;
+  r->etiquetado = true;
+
+  char linea[128];
+  while (fgets(linea, sizeof(linea), f) != NULL)
+  {
+    char *p = linea;
+    while (*p == ' ' || *p == '\t')
+    {
+      p++;
+    }
+    if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0')
+    {
+      continue;
+    }
+
+    char *fin;
+    long valor = strtol(p, &fin, 10);
+    if (fin == p)
+    {
+      fprintf(stderr, "%s: línea %u no válida\n", ruta, r->n + 1);
+      continue;
+    }
+    while (*fin == ',' || *fin == ';' || *fin == ' ' || *fin == '\t')
+    {
+      fin++;
+    }
+    char *finEtiqueta;
+    long etiqueta = strtol(fin, &finEtiqueta, 10);
+    bool conEtiqueta = (finEtiqueta != fin);
+
+    if (r->n == capacidad)
+    {
+      capacidad *= 2;
+      r->muestras = realloc(r->muestras, capacidad * sizeof(*r->muestras));
+      r->etiquetas = realloc(r->etiquetas, capacidad * sizeof(*r->etiquetas));
+    }
+    r->muestras[r->n] = (uint16_t)(valor < 0 ? 0 : (valor > 4095 ? 4095 : valor));
+    r->etiquetas[r->n] = conEtiqueta ? (etiqueta != 0) : REPLAY_SIN_ETIQUETA;
+    r->etiquetado = r->etiquetado && conEtiqueta;
+    r->n++;
+  }
+  fclose(f);
+  return r->n > 0;
+}
+
+/**
+ * @brief Genera una señal sintética etiquetada: ruido de fondo y ráfagas de ruido ancho.
+ * @details Alterna reposo y contracción con duraciones pseudoaleatorias (0,8–2 s y 0,4–1,5 s),
+ * e incluye interferencia de red de 50 Hz para ejercitar el notch. La semilla es fija para que
+ * las ejecuciones sean comparables.
+ */
+static void replay_sintetico(uint32_t segundos, struct registro_emg *r)
+{
+  r->n = segundos * SAMPLING_FREQ;
+  r->muestras = malloc(r->n * sizeof(*r->muestras));
+  r->etiquetas = malloc(r->n * sizeof(*r->etiquetas));
+  r->etiquetado = true;
+
+  uint32_t semilla = 13579;
+#define REPLAY_ALEATORIO() ((semilla = semilla * 1664525u + 1013904223u) / 4294967296.0)
+
+  uint32_t i = 0;
+  bool contraccion = false;
+  while (i < r->n)
+  {
+    double duracion = contraccion ? 0.4 + 1.1 * REPLAY_ALEATORIO() : 0.8 + 1.2 * REPLAY_ALEATORIO();
+    uint32_t fin = i + (uint32_t)(duracion * SAMPLING_FREQ);
+    double sigma = contraccion ? 500.0 : 15.0;
+    for (; i < fin && i < r->n; i++)
+    {
+      // Box-Muller
+      double u1 = REPLAY_ALEATORIO() + 1e-12;
+      double u2 = REPLAY_ALEATORIO();
+      double ruido = sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+      double red = 40.0 * sin(2.0 * M_PI * 50.0 * i / SAMPLING_FREQ);
+      double v = FILTRO_EMG_OFFSET_ADC + sigma * ruido + red;
+      r->muestras[i] = (uint16_t)(v < 0 ? 0 : (v > 4095 ? 4095 : v));
+      r->etiquetas[i] = contraccion;
+    }
+    contraccion = !contraccion;
+  }
+#undef REPLAY_ALEATORIO
+}
+
+// ==========================
+//   Cadena de procesado
+// ==========================
+
+/**
+ * @brief Salto de la ventana: decisión del firmware y comparación con la etiqueta.
+ */
+static void replay_decidir(const float caracteristicas[NUMERO_CANALES_EMG][NUMERO_CARACTERISTICAS], uint32_t muestra)
+{
+  uint64_t t0 = replay_ns();
+  tareas_decidir(caracteristicas, muestra);
+  replay_anotar(ETAPA_DECISION, replay_ns() - t0);
+#if !DETECCION_INFERENCIA
+  // El firmware solo ejecuta la red si decide con ella; aquí se ejecuta aparte para evaluarla
+  inferencia_ejecutar(caracteristicas, espectroControl.caracteristicas);
+#endif
+
+  int8_t etiqueta = registro->etiquetas[desplazamientoBloque + muestra];
+  if (etiqueta == REPLAY_SIN_ETIQUETA)
+  {
+    return;
+  }
+  replay_confusion(&confusionUmbrales, resultDeteccion != 0, etiqueta);
+  replay_confusion(&confusionRed, result[0] > parametrosControl->umbralInferencia, etiqueta);
+
+  if (etiqueta && inicioContraccionUs >= 0 && !deteccionEnContraccion && resultDeteccion)
+  {
+    deteccionEnContraccion = true;
+    replay_latencia(&latenciaDeteccion, replay_tiempo_muestra(muestraBase + muestra));
+  }
+}
+
+/**
+ * @brief Sigue las etiquetas del bloque para abrir y cerrar las medidas de latencia.
+ */
+static void replay_seguir_etiquetas()
+{
+  for (uint32_t i = 0; i < ANILLO_MUESTRAS_POR_BLOQUE; i++)
+  {
+    int8_t etiqueta = registro->etiquetas[desplazamientoBloque + i];
+    if (etiqueta == 1 && inicioContraccionUs < 0)
+    {
+      inicioContraccionUs = replay_tiempo_muestra(muestraBase + i);
+      deteccionEnContraccion = false;
+      cierreEnContraccion = false;
+    }
+    else if (etiqueta != 1 && inicioContraccionUs >= 0)
+    {
+      latenciaDeteccion.perdidas += !deteccionEnContraccion;
+      latenciaMotor.perdidas += !cierreEnContraccion;
+      inicioContraccionUs = -1;
+    }
+  }
+}
+
+/**
+ * @brief Modelo de planta: integra el duty y la dirección del motor durante un periodo de control.
+ * @details Primer orden con constante @ref REPLAY_TAU_MOTOR_S hacia
+ * `duty / MOTORES_DUTY_MAX · VELOCIDAD_MAXIMA_MOTOR`, con topes mecánicos en el recorrido.
+ */
+static void replay_planta(float dt)
+{
+  static float velocidad = 0;
+  static float posicion = 0;
+  static float pendiente = 0;
+
+  bool accionado = mock_gpio_nivel(motorPrincipal->sleep) != 0;
+  float sentido = (mock_gpio_nivel(motorPrincipal->ph) == CERRAR) ? 1.0f : -1.0f;
+  float objetivo = accionado ? sentido * VELOCIDAD_MAXIMA_MOTOR * mock_ledc_duty(motorPrincipal->pwm_channel) / MOTORES_DUTY_MAX : 0.0f;
+  velocidad += (objetivo - velocidad) * dt / REPLAY_TAU_MOTOR_S;
+
+  float nueva = posicion + velocidad * dt;
+  if (nueva < POSICION_MINIMA_MOTOR || nueva > POSICION_MAXIMA_MOTOR)
+  {
+    nueva = (nueva < POSICION_MINIMA_MOTOR) ? POSICION_MINIMA_MOTOR : POSICION_MAXIMA_MOTOR;
+    velocidad = 0;
+  }
+  pendiente += nueva - posicion;
+  posicion = nueva;
+
+  int pasos = (int)pendiente;
+  pendiente -= pasos;
+  mock_pcnt_mover(pasos);
+}
+
+/**
+ * @brief Procesa un bloque y los periodos de control que lo siguen, como @ref tarea_adquisicion y @ref tarea_control.
+ */
+static void replay_bloque(const uint16_t *crudo)
+{
+  static muestra_emg_t filtrado[ANILLO_MUESTRAS_HUECO] __attribute__((aligned(16)));
+
+  uint64_t t0 = replay_ns();
+  PERFIL_INICIO(PERFIL_FILTRO);
+  filtro_procesar_bloque(crudo, filtrado, ANILLO_MUESTRAS_POR_BLOQUE, ANILLO_FILA_CANAL);
+  PERFIL_FIN(PERFIL_FILTRO);
+  uint64_t t1 = replay_ns();
+  replay_anotar(ETAPA_FILTRO, t1 - t0);
+#if ESPECTRO_EMG
+  espectro_procesar_bloque(filtrado, ANILLO_MUESTRAS_POR_BLOQUE, ANILLO_FILA_CANAL);
+  replay_anotar(ETAPA_ESPECTRO, replay_ns() - t1);
+  t1 = replay_ns();
+#endif
+
+  uint64_t decisionAntes = etapas[ETAPA_DECISION].totalNs;
+  tiempoBloqueDecision = replay_tiempo_muestra(muestraBase + ANILLO_MUESTRAS_POR_BLOQUE - 1);
+  ultimaMuestraEMG = ANILLO_CANAL(filtrado, CANAL_EMG_PRINCIPAL)[0];
+  PERFIL_INICIO(PERFIL_CARACTERISTICAS);
+  ventana_procesar_bloque(filtrado, ANILLO_MUESTRAS_POR_BLOQUE, ANILLO_FILA_CANAL, replay_decidir);
+  PERFIL_FIN(PERFIL_CARACTERISTICAS);
+  replay_anotar(ETAPA_VENTANA, replay_ns() - t1 - (etapas[ETAPA_DECISION].totalNs - decisionAntes));
+
+  struct evento_gesto gesto;
+  while (gestos_recibir(&gesto))
+  {
+    gestosReconocidos[gesto.tipo]++;
+    if (mandoGestos)
+    {
+      tareas_aplicar_gesto(&gesto);
+    }
+  }
+  if (!mandoGestos && estado_protesis.estado_actual == ESTADO_NORMAL)
+  {
+    maquina_cambiarFase(&estado_protesis, resultDeteccion ? FASE_PASO_2 : FASE_PASO_1);
+  }
+
+  for (uint32_t p = 0; p < REPLAY_PERIODOS_POR_BLOQUE; p++)
+  {
+    parametros_confirmar();
+    uint64_t t2 = replay_ns();
+    PERFIL_INICIO(PERFIL_MOTORES);
+    activacionMotores();
+    PERFIL_FIN(PERFIL_MOTORES);
+    replay_anotar(ETAPA_CONTROL, replay_ns() - t2);
+
+    if (inicioContraccionUs >= 0 && !cierreEnContraccion && mock_ledc_duty(motorPrincipal->pwm_channel) > 0 &&
+        mock_gpio_nivel(motorPrincipal->ph) == CERRAR)
+    {
+      cierreEnContraccion = true;
+      replay_latencia(&latenciaMotor, esp_timer_get_time());
+    }
+
+    replay_planta(1.0f / FREC_BUCLE_CONTROL);
+    mock_avanzar_tiempo(TIMER_FREQ / FREC_BUCLE_CONTROL);
+  }
+}
+
+// ==========================
+//   Informe
+// ==========================
+
+static void replay_imprimir_confusion(const char *nombre, const struct matriz_confusion *c)
+{
+  uint64_t total = c->vp + c->fp + c->vn + c->fn;
+  double exactitud = total ? (double)(c->vp + c->vn) / total : 0;
+  double precision = (c->vp + c->fp) ? (double)c->vp / (c->vp + c->fp) : 0;
+  double sensibilidad = (c->vp + c->fn) ? (double)c->vp / (c->vp + c->fn) : 0;
+  printf("  %-8s exactitud %6.2f %%  precisión %6.2f %%  sensibilidad %6.2f %%  (VP %llu FP %llu VN %llu FN %llu)\n",
+         nombre, 100 * exactitud, 100 * precision, 100 * sensibilidad, (unsigned long long)c->vp,
+         (unsigned long long)c->fp, (unsigned long long)c->vn, (unsigned long long)c->fn);
+}
+
+static void replay_imprimir_latencia(const char *nombre, const struct latencia_activacion *l)
+{
+  printf("  media %7.2f ms  máx %7.2f ms  %s (%u contracciones, %u sin evento)\n",
+         l->medidas ? l->totalMs / l->medidas : 0.0, l->maximaMs, nombre, l->medidas, l->perdidas);
+}
+
+static void replay_informe(uint64_t muestras, uint64_t ns)
+{
+  double segundosHost = ns / 1e9;
+  double segundosSenal = (double)muestras / SAMPLING_FREQ;
+  printf("Rendimiento\n");
+  printf("  %llu muestras (%.1f s de señal) en %.3f s: %.0f muestras/s, %.0fx tiempo real\n",
+         (unsigned long long)muestras, segundosSenal, segundosHost, muestras / segundosHost, segundosSenal / segundosHost);
+
+  printf("Latencia por etapa (reloj del host)\n");
+  for (int e = 0; e < NUMERO_ETAPAS; e++)
+  {
+    const struct estadistica_etapa *s = &etapas[e];
+    printf("  media %8.1f ns  máx %8llu ns  %s (%llu llamadas)\n", s->llamadas ? (double)s->totalNs / s->llamadas : 0.0,
+           (unsigned long long)s->maximoNs, s->nombre, (unsigned long long)s->llamadas);
+  }
+
+  printf("Gestos reconocidos\n");
+  printf("  %u cortos, %u largos, %u dobles, %u perdidos%s\n", gestosReconocidos[GESTO_PULSO_CORTO],
+         gestosReconocidos[GESTO_PULSO_LARGO], gestosReconocidos[GESTO_PULSO_DOBLE], gestosPerdidos,
+         mandoGestos ? " (mandan la máquina de estados)" : "");
+
+  if (!registro->etiquetado)
+  {
+    printf("Registro sin etiquetas: no se evalúa la decisión\n");
+    return;
+  }
+  printf("Decisión por salto de ventana\n");
+  replay_imprimir_confusion("umbrales", &confusionUmbrales);
+  replay_imprimir_confusion("red", &confusionRed);
+  printf("Latencia desde el inicio de la contracción (tiempo de señal)\n");
+  replay_imprimir_latencia("hasta la detección", &latenciaDeteccion);
+  replay_imprimir_latencia("hasta que el motor cierra", &latenciaMotor);
+  printf("Posición final del motor: %u pasos\n", posicionMotor);
+}
+
+int main(int argc, char **argv)
+{
+  float umbralAct = REPLAY_UMBRAL_ACT_MAV;
+  float umbralDes = REPLAY_UMBRAL_DES_MAV;
+  uint32_t repeticiones = 1;
+  uint32_t segundos = REPLAY_SEGUNDOS_SINTETICO;
+  bool volcarPerf = false;
+
+  int opcion;
+  while ((opcion = getopt(argc, argv, "a:d:r:s:gph")) != -1)
+  {
+    switch (opcion)
+    {
+    case 'a':
+      umbralAct = strtof(optarg, NULL);
+      break;
+    case 'd':
+      umbralDes = strtof(optarg, NULL);
+      break;
+    case 'r':
+      repeticiones = (uint32_t)strtoul(optarg, NULL, 10);
+      break;
+    case 's':
+      segundos = (uint32_t)strtoul(optarg, NULL, 10);
+      break;
+    case 'g':
+      mandoGestos = true;
+      break;
+    case 'p':
+      volcarPerf = true;
+      break;
+    default:
+      fprintf(stderr, "Uso: %s [-a umbral_act_mav] [-d umbral_des_mav] [-r repeticiones] [-s segundos] [-g] [-p] [registro.csv]\n", argv[0]);
+      return opcion == 'h' ? 0 : 2;
+    }
+  }
+
+  static struct registro_emg r;
+  if (optind < argc)
+  {
+    if (!replay_cargar(argv[optind], &r))
+    {
+      return 1;
+    }
+  }
+  else
+  {
+    replay_sintetico(segundos, &r);
+  }
+  registro = &r;
+
+  // Mismo arranque que app_main y las tareas, sin los periféricos que no existen en el host
+  caracteristicas_iniciar();
+  inferencia_iniciar();
+  filtro_reiniciar();
+  ventanas_reiniciar();
+  espectro_preparar();
+  if (iniciaEncoder() != ESP_OK)
+  {
+    fprintf(stderr, "no se pueden iniciar los motores\n");
+    return 1;
+  }
+  maquina_inicializar(&estado_protesis);
+  gestos_iniciar();
+#if PERFILADO
+  perfil_registrar_comando();
+#endif
+  parametros_registrar_comando();
+  // Los umbrales entran por el comando `param`, como desde la consola
+  char ajuste[96];
+  snprintf(ajuste, sizeof(ajuste), "param umbral_act_mav %.9g umbral_des_mav %.9g", umbralAct, umbralDes);
+  if (mock_consola_ejecutar(ajuste) != 0)
+  {
+    return 2;
+  }
+  parametros_confirmar();
+
+  uint32_t bloques = r.n / ANILLO_MUESTRAS_POR_BLOQUE;
+  if (bloques == 0)
+  {
+    fprintf(stderr, "El registro no llega a un bloque (%u muestras)\n", ANILLO_MUESTRAS_POR_BLOQUE);
+    return 1;
+  }
+  uint16_t *bloque = malloc(ANILLO_MUESTRAS_HUECO * sizeof(uint16_t));
+  // Un bloque se procesa cuando ha llegado su última muestra
+  mock_avanzar_tiempo(replay_tiempo_muestra(ANILLO_MUESTRAS_POR_BLOQUE));
+  uint64_t inicio = replay_ns();
+  for (uint32_t rep = 0; rep < repeticiones; rep++)
+  {
+    for (uint32_t b = 0; b < bloques; b++)
+    {
+      desplazamientoBloque = b * ANILLO_MUESTRAS_POR_BLOQUE;
+      muestraBase = ((uint64_t)rep * bloques + b) * ANILLO_MUESTRAS_POR_BLOQUE;
+      for (int c = 0; c < NUMERO_CANALES_EMG; c++)
+      {
+        memcpy(ANILLO_CANAL(bloque, c), &r.muestras[desplazamientoBloque], ANILLO_MUESTRAS_POR_BLOQUE * sizeof(uint16_t));
+      }
+      if (r.etiquetado)
+      {
+        replay_seguir_etiquetas();
+      }
+      replay_bloque(bloque);
+    }
+  }
+  uint64_t duracion = replay_ns() - inicio;
+
+  replay_informe((uint64_t)repeticiones * bloques * ANILLO_MUESTRAS_POR_BLOQUE, duracion);
+  if (volcarPerf && mock_consola_ejecutar("perf") < 0)
+  {
+    printf("Sondas desactivadas (PERFILADO = 0)\n");
+  }
+  free(bloque);
+  return 0;
+}
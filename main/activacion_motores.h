@@ -7,163 +7,62 @@
  * Todas las variables globales y constantes utilizadas están definidas en @ref globales.h.
  */
 
+#pragma once
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_console.h"
 #include "globales.h"
+#include "parametros.h"
 #include "motores.h"
+#include "banco_motores.h"
+#include "agarre_motor.h"
+#include "persistencia.h"
+#include "perfilado.h"
 #include "maquina_de_estados_protesis.h"
 
 
 // Flags de control de motor
-bool motorAbrir = false;   ///< Indica si el motor debe abrir.
-bool motorCerrar = false;  ///< Indica si el motor debe cerrar.
-
-/**
- * @brief Instancia del controlador del motor (C style).
- * @details Declare the struct and initialize it in `iniciaEncoder()`.
- */
-struct motores motor;
-
-/**
- * @brief Rutina de interrupción para el encoder del motor.
- * @details Llamada en cada cambio de estado del pin del encoder A para registrar pasos.
- */
-void IRAM_ATTR updateMotores(void* arg)
-{
-  motores_step(&motor);
-}
-
-/**
- * @brief Inicializa la interrupción del encoder asociado al pin @ref encoderAPin. En cada cambio del pin ejecuta @ref updateMotores.
- */
-void iniciaEncoder()
-{
-
-  gpio_config_t io_conf = {0};
-  io_conf.intr_type = GPIO_INTR_ANYEDGE;
-  io_conf.mode = GPIO_MODE_INPUT;
-  io_conf.pin_bit_mask = (1ULL << encoderAPin);
-  io_conf.pull_up_en = GPIO_PULLUP_ENABLE;
-  io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
-  gpio_config(&io_conf);
-
-  // Registrar la ISR
-  gpio_install_isr_service(0); // 0 = usar default ISR service
-  gpio_isr_handler_add((gpio_num_t)encoderAPin, updateMotores, NULL);
-
-  /* Initialize motor controller now that GPIOs are ready */
-  motores_init(&motor,
-               (gpio_num_t)encoderBPin,
-               (gpio_num_t)encoderAPin,
-               (gpio_num_t)motorEnabePWMPin,
-               (gpio_num_t)motorPhasePin,
-               (gpio_num_t)motorSleepPin,
-               (uint16_t)POSICION_MAXIMA_MOTOR,
-               (uint16_t)POSICION_MINIMA_MOTOR,
-               LEDC_CHANNEL_0);
-
-}
+bool motorAbrir = false;   ///< Indica si los motores deben abrir.
+bool motorCerrar = false;  ///< Indica si los motores deben cerrar.
 
 /**
- * @brief Comprueba si el motor mantiene la posición estable por un tiempo determinado.
+ * @brief Inicializa los motores del banco y la lectura de sus encoders.
  * @details
- * Evalúa si la posición actual del motor se mantiene dentro de un margen de tolerancia
- * respecto a la posición anterior durante 3 segundos, para detectar si el motor se ha bloqueado.
- *
- * @retval true  Si la posición se mantiene estable por 3 segundos.
- * @retval false En caso contrario.
+ * Con @ref ENCODER_PCNT a `1` la cuadratura se decodifica por hardware (x4, con filtro de glitches)
+ * y no se registra ninguna interrupción. Con @ref ENCODER_PCNT a `0` todos comparten la ISR
+ * @ref updateMotores (ver @ref banco_iniciar).
+ * @return `ESP_OK`, o el error de @ref banco_iniciar: un motor sin encoder no debe accionarse, y
+ * sus drivers quedan dormidos.
  */
-bool checkMotorPressure()
+esp_err_t iniciaEncoder()
 {
-  static uint16_t posicionAnterior = 0;
-  static unsigned long tiempoPresion = 0;
-  static const uint8_t margenPresion = 1;
-
-  uint16_t posicionActual = motores_read_position(&motor);
-  // Asegurar que limiteInferior no tome valores negativos
-  uint16_t limiteInferior = (posicionAnterior > margenPresion) ? (posicionAnterior - margenPresion) : 0;
-  uint16_t limiteSuperior = posicionAnterior + margenPresion;
-
-  if ((posicionActual >= limiteInferior) && (posicionActual <= limiteSuperior))
-  { 
-    // Si está dentro del margen
-    if (tiempoPresion == 0)
-    {
-      tiempoPresion = esp_timer_get_time(); // Iniciar temporizador
-    }
-    else if ((esp_timer_get_time() - tiempoPresion) >= 3000000)
-    {
-      tiempoPresion = 0; // Reiniciar temporizador
-      return true;       // Se mantiene estable por 3 segundos
-    }
-  }
-  else
+  esp_err_t err = banco_iniciar();
+  if (err != ESP_OK)
   {
-    tiempoPresion = esp_timer_get_time(); // Reiniciar temporizador
+    return err;
   }
-
-  posicionAnterior = posicionActual;
-  return false;
+  // Sin ADC de corriente el agarre se detecta solo por la velocidad
+  sensores_iniciar_adc();
+  return ESP_OK;
 }
 
 /**
  * @brief Interpreta el estado de la prótesis y asigna las acciones de motor.
  * @details
  * Según el estado y la fase definidos en @ref estado_protesis,
- * establece los flags @ref motorAbrir y @ref motorCerrar.
+ * establece los flags @ref motorAbrir y @ref motorCerrar a partir de @ref tablaEstados.
  */
-
-
-
-void interpretarMaquinaEstados()   
+void interpretarMaquinaEstados()
 {
-  switch (estado_protesis.estado_actual)
-  {
-  case ESTADO_NORMAL:
-  case ESTADO_CALIBRADO_MOTORES:
-    switch (estado_protesis.fase_actual)
-    {
-    case FASE_1:
-      motorAbrir = motorCerrar = 0;
-      break;
-    case FASE_2:
-      motorAbrir = 1;
-      motorCerrar = 0;
-      break;
-    case FASE_3:
-      motorAbrir = 0;
-      motorCerrar = 1;
-      break;
-    default:
-      motorAbrir = motorCerrar = 0;
-      break;
-    }
-    break;
-
-  case ESTADO_SEGURIDAD:
-    switch (estado_protesis.fase_actual)
-    {
-    case FASE_1:
-      motorAbrir = motorCerrar = 0;
-      break;
-    case FASE_2:
-      motorAbrir = 1;
-      motorCerrar = 0;
-      break;
-    default:
-      motorAbrir = motorCerrar = 0;
-      break;
-    }
-    break;
-
-  default:
-    motorAbrir = motorCerrar = 0;
-    break;
-  }
+  uint8_t movimiento = maquina_accion(&estado_protesis)->movimiento;
+  motorAbrir = movimiento & MOVIMIENTO_ABRIR;
+  motorCerrar = (movimiento & MOVIMIENTO_CERRAR) != 0;
 }
 
 
 
-
-
 // ESPACIO EN BLANCO SIMPLEMENTE PARA QUE COINCIDAN LÍNEAS CON activacion_motores_copy
 
 
@@ -187,95 +86,279 @@ void interpretarMaquinaEstados()
 
 
 /**
- * @brief Ejecuta la acción de abrir el motor.
+ * @brief Indica si la apertura y el cierre se hacen con perfiles en lazo cerrado.
+ * @details En la calibración de motores la posición se reescribe en cada ciclo
+ * (@ref REFERENCIA_INTERMEDIA), así que el lazo cerrado no tiene una referencia válida y se
+ * mantiene el control todo o nada.
+ */
+static inline bool usarPerfilMotor()
+{
+  return CONTROL_MOTOR_PERFIL && maquina_accion(&estado_protesis)->referencia == REFERENCIA_LIBRE;
+}
+
+/**
+ * @brief Velocidad de crucero de los perfiles (pasos/s), escalada con @ref velocidad_motor_procesada.
+ */
+static inline float velocidadPerfilMotor()
+{
+  return VELOCIDAD_MAXIMA_MOTOR * velocidad_motor_procesada / MOTORES_DUTY_MAX;
+}
+
+/**
+ * @brief Posición hasta la que cierra un motor: la menor entre su máximo y `posicion_maxima`.
+ */
+static inline uint16_t posicionCierreMotor(const struct motores *m)
+{
+  float limite = parametrosControl->posicionMaximaMotor;
+  return (limite < m->max_pos) ? (uint16_t)limite : m->max_pos;
+}
+
+/**
+ * @brief Ejecuta la acción de abrir un motor.
+ * @param m Motor del banco.
  * @details
- * Hace girar el motor en sentido de apertura hasta la posición mínima.
+ * Lleva el motor hasta su posición mínima. Con @ref CONTROL_MOTOR_PERFIL se solicita un perfil
+ * trapezoidal y se ejecuta un paso del lazo cerrado, por lo que debe llamarse a
+ * @ref FREC_BUCLE_CONTROL; si no, gira a velocidad fija hasta el objetivo.
  *
  * @retval true  Si llega al límite.
  * @retval false En caso contrario.
  */
-bool abrirMotor()
+bool abrirMotor(struct motores *m)
 {
+  agarre_reiniciar();
+  if (usarPerfilMotor())
+  {
+    return motores_move_to(m, m->min_pos, velocidadPerfilMotor(), ACELERACION_MOTOR);
+  }
   bool direccionMotor = ABRIR;
-  bool motorLlegado = motores_start_until(&motor, direccionMotor, POSICION_MINIMA_MOTOR, velocidad_motor_procesada);
+  bool motorLlegado = motores_start_until(m, direccionMotor, m->min_pos, velocidad_motor_procesada);
   return motorLlegado;
 }
 
 /**
- * @brief Ejecuta la acción de cerrar el motor.
+ * @brief Ejecuta la acción de cerrar un motor.
+ * @param m Motor del banco.
  * @details
- * Hace girar el motor en sentido de cierre hasta la posición máxima o hasta detectar presión.
+ * Lleva el motor hasta su posición de cierre (@ref posicionCierreMotor), del mismo modo que
+ * @ref abrirMotor, o hasta que
+ * @ref agarre_motor.h detecta un agarre (solo en @ref ESTADO_NORMAL). El agarre lo detecta el
+ * motor principal; con el agarre confirmado todos los motores quedan al duty de sujeción hasta la
+ * siguiente apertura o parada.
  *
  * @retval true  Si llega al límite o detecta presión.
  * @retval false En caso contrario.
  */
-bool cerrarMotor()
+bool cerrarMotor(struct motores *m)
 {
-  bool direccionMotor = CERRAR;
-  bool motorLlegado = motores_start_until(&motor, direccionMotor, POSICION_MAXIMA_MOTOR, velocidad_motor_procesada);
-  bool motorPresionando = (estado_protesis.estado_actual == ESTADO_NORMAL) ? checkMotorPressure() : false;
+  bool detectarAgarre = (estado_protesis.estado_actual == ESTADO_NORMAL);
+  bool principal = (m == motorPrincipal);
+  if (detectarAgarre && agarre_sujetando())
+  {
+    if (principal)
+    {
+      return agarre_actualizar(m, m->vel.velocity);
+    }
+    agarre_sujetar(m);
+    return true;
+  }
+
+  bool motorLlegado;
+  if (usarPerfilMotor())
+  {
+    motorLlegado = motores_move_to(m, posicionCierreMotor(m), velocidadPerfilMotor(), ACELERACION_MOTOR);
+  }
+  else
+  {
+    bool direccionMotor = CERRAR;
+    motorLlegado = motores_start_until(m, direccionMotor, posicionCierreMotor(m), velocidad_motor_procesada);
+  }
+  bool motorPresionando = (detectarAgarre && principal && !motorLlegado) ? agarre_actualizar(m, m->vel.velocity) : false;
   return motorLlegado || motorPresionando;
 }
 
 /**
- * @brief Detiene la rotación del motor inmediatamente.
+ * @brief Detiene la rotación de un motor inmediatamente.
+ * @param m Motor del banco.
  */
-void pararMotor()
+void pararMotor(struct motores *m)
 {
-  motores_stop_rotation(&motor);
+  agarre_reiniciar();
+  motores_stop_rotation(m);
 }
 
 /**
  * @brief Control principal de activación de motores.
  * @details
- * Ajusta la velocidad del motor según el estado de la prótesis,
- * interpreta la máquina de estados y ejecuta las acciones correspondientes.
- * También gestiona la calibración de motores y actualiza la posición del motor.
- * @warning Siempre que el sistema salga de la calibración de motores, la posición será 0 (prótesis abierta).
+ * Ajusta la velocidad de los motores según el estado de la prótesis, interpreta la máquina de
+ * estados y ejecuta la misma acción sobre cada motor del banco, empezando por el principal (así
+ * los demás ven en el mismo ciclo un agarre recién confirmado). También gestiona la calibración
+ * de motores y actualiza sus posiciones. Al final escribe de una vez los duty del ciclo
+ * (@ref banco_confirmar_duty).
+ * @warning Siempre que el sistema salga de la calibración de motores, la posición será la mínima
+ * (prótesis abierta).
  */
 void activacionMotores()
 {
   // Ajustar la velocidad del motor según el estado
-  if (estado_protesis.estado_actual == ESTADO_CALIBRADO_MOTORES || estado_protesis.estado_actual == ESTADO_CALIBRADO_UMBRALES)
+  const struct accion_estado *accion = maquina_accion(&estado_protesis);
+  const struct parametros_ajustables *ajustes = parametrosControl;
+  velocidad_motor_procesada = (accion->lento ? ajustes->velocidadCalibracionMotor : ajustes->velocidadMotor) * MOTORES_DUTY_MAX / 100.0f;
+
+  interpretarMaquinaEstados();
+
+  bool llegados = true;
+  for (int i = 0; i < NUMERO_MOTORES; i++)
   {
-    
-    velocidad_motor_procesada = 2.55 * 50;
+    struct motores *m = &bancoMotores[i];
+    // Una estimación por ciclo de control: la usan el lazo cerrado y la detección de agarre
+    motores_read_velocity(m);
+
+    if (motorAbrir)
+    {
+      llegados &= abrirMotor(m);
+    }
+    else if (motorCerrar)
+    {
+      llegados &= cerrarMotor(m);
+    }
+    else
+    {
+      pararMotor(m);
+      llegados = false;
+    }
+
+    // Calibración de motores: establecer posición inicial
+    if (accion->referencia == REFERENCIA_INTERMEDIA)
+    {
+      motores_set_position(m, (m->max_pos + m->min_pos) / 2);
+    }
+    else if (accion->referencia == REFERENCIA_CERO)
+    {
+      motores_set_position(m, m->min_pos);
+    }
+    posicionesMotores[i] = motores_read_position(m);
   }
-  else
+  banco_confirmar_duty();
+
+  motorArrived = llegados;
+  velocidadMotor = motorPrincipal->vel.velocity;
+  posicionMotor = posicionesMotores[MOTOR_PRINCIPAL];
+  if (accion->referencia == REFERENCIA_CERO)
   {
-    velocidad_motor_procesada = 2.55 * VELOCIDAD_MOTOR;
+    motoresCalibrados = true;
+    persistencia_solicitar_guardado();
+    maquina_completar_fase(&estado_protesis);
   }
+}
 
-  interpretarMaquinaEstados();
+/**
+ * @brief Órdenes de la consola para la calibración de motores (@ref calibracion_motores_comando).
+ */
+enum Orden_Calibracion_Motores
+{
+  ORDEN_MOTORES_NINGUNA, ///< Sin orden pendiente.
+  ORDEN_MOTORES_INICIAR, ///< Desde @ref ESTADO_NORMAL, entrar en @ref ESTADO_CALIBRADO_MOTORES.
+  ORDEN_MOTORES_PARAR,   ///< `FASE_PAUSA`: motores parados.
+  ORDEN_MOTORES_ABRIR,   ///< `FASE_PASO_1`: abrir despacio.
+  ORDEN_MOTORES_CERRAR,  ///< `FASE_PASO_2`: cerrar despacio.
+  ORDEN_MOTORES_CERO     ///< `FASE_CAMBIO_ESTADO`: la posición actual es la mínima; fin de la calibración.
+};
+
+/// Orden pendiente de la consola; la consume la tarea de control en @ref calibracion_motores_aplicar.
+static atomic_int ordenCalibracionMotores = ORDEN_MOTORES_NINGUNA;
 
-  if (motorAbrir)
+/**
+ * @brief Aplica la orden de calibración de motores pendiente, si la hay.
+ * @details Se llama desde la tarea de control, la única que modifica @ref estado_protesis. La
+ * orden de entrar solo se atiende en @ref ESTADO_NORMAL y las de fase solo dentro de
+ * @ref ESTADO_CALIBRADO_MOTORES, con los saltos permitidos por @ref tablaEstados.
+ */
+void calibracion_motores_aplicar()
+{
+  static const enum Fase_Estado fases[] = {
+    [ORDEN_MOTORES_PARAR] = FASE_PAUSA,
+    [ORDEN_MOTORES_ABRIR] = FASE_PASO_1,
+    [ORDEN_MOTORES_CERRAR] = FASE_PASO_2,
+    [ORDEN_MOTORES_CERO] = FASE_CAMBIO_ESTADO,
+  };
+  int orden = atomic_exchange_explicit(&ordenCalibracionMotores, ORDEN_MOTORES_NINGUNA, memory_order_relaxed);
+  if (orden == ORDEN_MOTORES_NINGUNA)
   {
-    motorArrived = abrirMotor();
+    return;
   }
-  else if (motorCerrar)
+  if (orden == ORDEN_MOTORES_INICIAR)
   {
-    motorArrived = cerrarMotor();
+    if (estado_protesis.estado_actual == ESTADO_NORMAL)
+    {
+      maquina_cambiarEstado(&estado_protesis, ESTADO_CALIBRADO_MOTORES);
+    }
   }
-  else
+  else if (estado_protesis.estado_actual == ESTADO_CALIBRADO_MOTORES && estado_protesis.fase_actual != fases[orden])
   {
-    pararMotor();
-    motorArrived = false;
+    maquina_cambiarFase(&estado_protesis, fases[orden]);
   }
+}
 
-  // Calibración de motores: establecer posición inicial
-  if (estado_protesis.estado_actual == ESTADO_CALIBRADO_MOTORES)
+/**
+ * @brief Comando `motores`: guía la calibración de motores.
+ * @details `iniciar` entra en @ref ESTADO_CALIBRADO_MOTORES, `abrir` y `cerrar` mueven despacio
+ * la mano, `parar` la detiene y `cero` toma la posición actual como mínima (mano abierta) y
+ * vuelve a @ref ESTADO_NORMAL. La orden se aplica en el siguiente periodo de control. Sin
+ * argumentos muestra, por motor, la posición y las paradas por hardware que ha tenido que cubrir
+ * el sondeo (`target_missed`, ver motores.h).
+ */
+static int calibracion_motores_comando(int argc, char **argv)
+{
+  static const char *const nombresOrdenes[] = {
+    [ORDEN_MOTORES_INICIAR] = "iniciar",
+    [ORDEN_MOTORES_PARAR] = "parar",
+    [ORDEN_MOTORES_ABRIR] = "abrir",
+    [ORDEN_MOTORES_CERRAR] = "cerrar",
+    [ORDEN_MOTORES_CERO] = "cero",
+  };
+  if (argc == 1)
   {
-    if (estado_protesis.fase_actual != FASE_4)
+    for (int i = 0; i < NUMERO_MOTORES; i++)
     {
-      uint16_t posicionIntermedia = (POSICION_MAXIMA_MOTOR + POSICION_MINIMA_MOTOR) / 2;
-      motores_set_position(&motor, posicionIntermedia);
+      printf("motor %d  posición %u  paradas por hardware perdidas %lu\n", i, (unsigned)posicionesMotores[i],
+             (unsigned long)bancoMotores[i].target_missed);
     }
-    else
+    return 0;
+  }
+  if (argc != 2)
+  {
+    printf("uso: motores [iniciar|abrir|cerrar|parar|cero]\n");
+    return 1;
+  }
+  for (int orden = ORDEN_MOTORES_INICIAR; orden <= ORDEN_MOTORES_CERO; orden++)
+  {
+    if (strcmp(argv[1], nombresOrdenes[orden]) == 0)
     {
-      motores_set_position(&motor, 0);
-      maquina_cambiarEstado(&estado_protesis, ESTADO_NORMAL);
+      bool calibrando = estado_protesis.estado_actual == ESTADO_CALIBRADO_MOTORES;
+      if ((orden == ORDEN_MOTORES_INICIAR) == calibrando)
+      {
+        printf(calibrando ? "ya en calibración de motores\n" : "calibración de motores no iniciada\n");
+        return 1;
+      }
+      atomic_store_explicit(&ordenCalibracionMotores, orden, memory_order_relaxed);
+      return 0;
     }
   }
+  printf("orden desconocida: %s\n", argv[1]);
+  return 1;
+}
 
-  posicionMotor = motores_read_position(&motor);
-}
\ No newline at end of file
+/**
+ * @brief Registra el comando `motores` en la consola (ver @ref consola.h).
+ */
+esp_err_t calibracion_motores_registrar_comando()
+{
+  const esp_console_cmd_t comando = {
+    .command = "motores",
+    .help = "Calibración de motores: iniciar, abrir y cerrar despacio, parar y fijar la posición abierta como cero. Sin orden, posición y paradas perdidas",
+    .hint = "[iniciar|abrir|cerrar|parar|cero]",
+    .func = calibracion_motores_comando,
+  };
+  return esp_console_cmd_register(&comando);
+}
@@ -106,82 +106,16 @@ bool checkMotorPressure()
  * @brief Interpreta el estado de la prótesis y asigna las acciones de motor.
  * @details
  * Según el estado y la fase definidos en @ref estado_protesis,
- * establece los flags @ref motorAbrir y @ref motorCerrar.
+ * establece los flags @ref motorAbrir y @ref motorCerrar a partir de @ref tablaEstados.
  */
 
 
 
 void interpretarMaquinaEstados()
 {
-  switch (estado_protesis.estado_actual)
-  {
-  case ESTADO_NORMAL:
-  switch (estado_protesis.fase_actual)
-  {
-    case FASE_PAUSA: 
-      break;
-    case FASE_PASO_1:
-      motorAbrir = true;
-      break;
-    case FASE_PASO_2:
-      motorCerrar = true;
-      break;
-    default:
-      break;
-  }
-  case ESTADO_DESCANSO:
-  switch (estado_protesis.fase_actual)
-  {
-    case FASE_PASO_1: //parada 3s
-      break;
-    case FASE_PASO_2: //apertura 3s
-      motorAbrir = true;
-      break;
-    default:
-      break;
-  }
-  case ESTADO_CALIBRADO_MOTORES:
-    switch (estado_protesis.fase_actual)
-    {
-    case FASE_PAUSA:
-      motorAbrir = motorCerrar = 0;
-      break;
-    case FASE_PASO_1:
-      motorAbrir = 1;
-      motorCerrar = 0;
-      break;
-    case FASE_PASO_2:
-      motorAbrir = 0;
-      motorCerrar = 1;
-      break;
-    case FASE_CAMBIO_ESTADO: //pos 0 y estado normal
-      break;
-    default:
-      motorAbrir = motorCerrar = 0;
-      break;
-    }
-    break;
-
-  case ESTADO_SEGURIDAD:
-    switch (estado_protesis.fase_actual)
-    {
-    case FASE_PAUSA:
-      break;
-    case FASE_PASO_1:
-      motorAbrir = 1;
-      motorCerrar = 0;
-      break;
-    case FASE_PASO_2: //parada de motores
-    case FASE_CAMBIO_ESTADO:  //pos 0 y estado normal
-    default:
-      break;
-    }
-    break;
-
-  default:
-    motorAbrir = motorCerrar = 0;
-    break;
-  }
+  uint8_t movimiento = tabla_accion(estado_protesis.estado_actual, estado_protesis.fase_actual)->movimiento;
+  motorAbrir = movimiento & MOVIMIENTO_ABRIR;
+  motorCerrar = (movimiento & MOVIMIENTO_CERRAR) != 0;
 }
 
 /**
@@ -234,15 +168,8 @@ void pararMotor()
 void activacionMotores()
 {
   // Ajustar la velocidad del motor según el estado
-  if (estado_protesis.estado_actual == ESTADO_CALIBRADO_MOTORES || estado_protesis.estado_actual == ESTADO_CALIBRADO_UMBRALES)
-  {
-    
-    velocidad_motor_procesada = 2.55 * 50;
-  }
-  else
-  {
-    velocidad_motor_procesada = 2.55 * VELOCIDAD_MOTOR;
-  }
+  const accion_estado *accion = tabla_accion(estado_protesis.estado_actual, estado_protesis.fase_actual);
+  velocidad_motor_procesada = 2.55 * (accion->lento ? VELOCIDAD_CALIBRACION_MOTOR : VELOCIDAD_MOTOR);
 
   interpretarMaquinaEstados();
 
@@ -261,18 +188,16 @@ void activacionMotores()
   }
 
   // Calibración de motores: establecer posición inicial
-  if (estado_protesis.estado_actual == ESTADO_CALIBRADO_MOTORES)
+  if (accion->referencia == REFERENCIA_INTERMEDIA)
   {
-    if (estado_protesis.fase_actual != FASE_CAMBIO_ESTADO)              //// ESTA LÍNEA TAMBIÉN PRESENTA UN CAMBIO FRENTE AL ORIGINAL
-    {
-      uint16_t posicionIntermedia = (POSICION_MAXIMA_MOTOR + POSICION_MINIMA_MOTOR) / 2;
-      motor.set_position(posicionIntermedia);
-    }
-    else //FASE_CAMBIO_ESTADO
-    {
-      motor.set_position(0);
-      maquina_cambiarEstado(&estado_protesis, ESTADO_NORMAL);
-    }
+    uint16_t posicionIntermedia = (POSICION_MAXIMA_MOTOR + POSICION_MINIMA_MOTOR) / 2;
+    motor.set_position(posicionIntermedia);
+  }
+  else if (accion->referencia == REFERENCIA_CERO)
+  {
+    motor.set_position(0);
+    estado_protesis.cambiarEstado((Estado_Protesis)accion->estado_siguiente);
+    estado_protesis.cambiarFase(FASE_PAUSA);
   }
 
   posicionMotor = motor.read_position();
@@ -0,0 +1,151 @@
+/**
+ * @file agarre_motor.h
+ * @brief Detección rápida de bloqueo/agarre del motor durante el cierre.
+ * @details
+ * Combina la corriente del motor, leída en la salida de medida de corriente del driver
+ * (@ref corrienteMotorPin), con la velocidad estimada del encoder (@ref motores_read_velocity):
+ * hay agarre cuando la corriente supera @ref CORRIENTE_AGARRE_MOTOR y la velocidad es menor que
+ * @ref VELOCIDAD_AGARRE_MOTOR durante @ref TIEMPO_CONFIRMACION_AGARRE_MS. Los primeros
+ * @ref TIEMPO_ARRANQUE_AGARRE_MS de cada cierre se ignoran, porque el pico de arranque tiene la
+ * misma firma (mucha corriente, poca velocidad).
+ *
+ * Al confirmarse el agarre el motor deja de seguir el perfil y pasa al duty de sujeción
+ * @ref DUTY_SUJECION_MOTOR, en lugar de seguir bloqueado al duty de cierre.
+ *
+ * Si el canal de corriente no está disponible (@ref corrienteDisponible) la detección usa solo la
+ * velocidad, con una confirmación más larga (@ref TIEMPO_CONFIRMACION_AGARRE_SIN_CORRIENTE_MS).
+ * La corriente sale de la instantánea de @ref sensores.h, que la convierte cada
+ * @ref SENSORES_PERIODO_CORRIENTE_MS: el bucle de control no toca el ADC. Cada conversión nueva
+ * entra una sola vez en el filtro; entre dos se conserva el último valor filtrado.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "globales.h"
+#include "motores.h"
+#include "sensores.h"
+
+#define AGARRE_FILTRO_CORRIENTE 0.3f ///< Peso de la muestra nueva en el filtro exponencial de la corriente.
+
+/**
+ * @enum Estado_Agarre
+ * @brief Estados del detector de agarre.
+ */
+enum Estado_Agarre
+{
+  AGARRE_LIBRE,     ///< Cerrando sin oposición (o en el tiempo de arranque).
+  AGARRE_SOSPECHA,  ///< Condición de bloqueo presente, pendiente de confirmar.
+  AGARRE_SUJETANDO  ///< Agarre confirmado: motor al duty de sujeción.
+};
+
+enum Estado_Agarre estadoAgarre = AGARRE_LIBRE; ///< Estado actual del detector.
+int64_t inicioCierreAgarre = 0;                 ///< Instante (µs) de la primera actualización del cierre actual.
+int64_t inicioSospechaAgarre = 0;               ///< Instante (µs) en que apareció la condición de bloqueo.
+
+/**
+ * @brief Lee la corriente del motor de la última instantánea de los sensores, sin bloquear.
+ * @return Corriente en amperios, o un valor negativo si no hay una conversión nueva desde la
+ * llamada anterior (o ha fallado, o el seqlock estaba ocupado).
+ */
+float agarre_leer_corriente()
+{
+  static struct instantanea_sensores lectura = {0};
+  static uint32_t ultimoNumero = 0;
+  if (!corrienteDisponible || !sensores_leer(&lectura) || lectura.numero == ultimoNumero)
+  {
+    return -1.0f;
+  }
+  ultimoNumero = lectura.numero;
+  return lectura.corrienteValida ? lectura.corriente : -1.0f;
+}
+
+/**
+ * @brief Vuelve al estado libre. Debe llamarse cada vez que el motor deja de cerrar.
+ */
+void agarre_reiniciar()
+{
+  estadoAgarre = AGARRE_LIBRE;
+  inicioCierreAgarre = 0;
+  inicioSospechaAgarre = 0;
+}
+
+/**
+ * @brief Indica si hay un agarre confirmado y el motor está al duty de sujeción.
+ */
+static inline bool agarre_sujetando()
+{
+  return estadoAgarre == AGARRE_SUJETANDO;
+}
+
+/**
+ * @brief Deja un motor cerrando al duty de sujeción @ref DUTY_SUJECION_MOTOR, fuera del perfil.
+ * @param m Motor que sujeta.
+ * @details Repetirla en cada ciclo no cambia el duty, así que no genera escrituras en el LEDC.
+ */
+void agarre_sujetar(struct motores *m)
+{
+  motores_stop_rotation(m);
+  motores_start_rotation(m, CERRAR, (uint16_t)(DUTY_SUJECION_MOTOR * MOTORES_DUTY_MAX / 100));
+}
+
+/**
+ * @brief Actualiza el detector con la corriente y la velocidad actuales (una vez por ciclo de cierre).
+ * @param m Motor que está cerrando.
+ * @param velocidad Velocidad estimada del motor (pasos/s).
+ * @retval true  Si hay agarre: el motor ya está al duty de sujeción.
+ * @retval false Si el motor sigue cerrando libremente.
+ * @details Actualiza también @ref corrienteMotor.
+ */
+bool agarre_actualizar(struct motores *m, float velocidad)
+{
+  int64_t ahora = esp_timer_get_time();
+  float corriente = agarre_leer_corriente();
+  bool hayCorriente = corrienteDisponible;
+  if (corriente >= 0.0f)
+  {
+    corrienteMotor += AGARRE_FILTRO_CORRIENTE * (corriente - corrienteMotor);
+  }
+
+  if (estadoAgarre == AGARRE_SUJETANDO)
+  {
+    return true;
+  }
+
+  if (inicioCierreAgarre == 0)
+  {
+    inicioCierreAgarre = ahora;
+  }
+  if (ahora - inicioCierreAgarre < TIEMPO_ARRANQUE_AGARRE_MS * 1000LL)
+  {
+    return false;
+  }
+
+  bool parado = ((velocidad < 0) ? -velocidad : velocidad) < VELOCIDAD_AGARRE_MOTOR;
+  bool bloqueo = hayCorriente ? (parado && corrienteMotor > CORRIENTE_AGARRE_MOTOR) : parado;
+  int64_t confirmacion = (hayCorriente ? TIEMPO_CONFIRMACION_AGARRE_MS : TIEMPO_CONFIRMACION_AGARRE_SIN_CORRIENTE_MS) * 1000LL;
+
+  if (!bloqueo)
+  {
+    estadoAgarre = AGARRE_LIBRE;
+    return false;
+  }
+  if (estadoAgarre == AGARRE_LIBRE)
+  {
+    estadoAgarre = AGARRE_SOSPECHA;
+    inicioSospechaAgarre = ahora;
+    return false;
+  }
+  if (ahora - inicioSospechaAgarre < confirmacion)
+  {
+    return false;
+  }
+
+  // Agarre confirmado: abandonar el perfil y sujetar con el duty reducido
+  estadoAgarre = AGARRE_SUJETANDO;
+  agarre_sujetar(m);
+  return true;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file anillo_bloques.h
+ * @brief Anillo lock-free de un productor y un consumidor (SPSC) para bloques de muestras EMG.
+ * @details
+ * El productor (callback del ADC) escribe directamente en el hueco reservado y lo publica;
+ * el consumidor (tarea de procesado) lee los bloques en el propio anillo, sin copiarlos, y los
+ * libera al terminar. Los índices `cabeza` y `cola` son contadores libres de 32 bits:
+ * - `cabeza` solo la escribe el productor, con semántica *release* al publicar.
+ * - `cola` solo la escribe el consumidor, con semántica *release* al liberar.
+ * Cada lado lee el índice del otro con *acquire*, de forma que el contenido de un bloque es
+ * visible antes que su publicación y nunca se sobrescribe un bloque que todavía se está leyendo,
+ * aunque productor y consumidor se ejecuten en núcleos distintos.
+ *
+ * Si el anillo está lleno el bloque nuevo se descarta y se incrementa `desbordamientos`.
+ *
+ * Cada bloque contiene todos los canales de @ref CANALES_EMG como estructura de vectores: una fila
+ * contigua de @ref ANILLO_MUESTRAS_POR_BLOQUE muestras por canal, separadas @ref ANILLO_FILA_CANAL
+ * muestras (ver @ref ANILLO_CANAL). Así cada etapa recorre un canal entero en memoria consecutiva.
+ * Los huecos son de `uint16_t` y caben tanto un bloque crudo del ADC como uno filtrado
+ * (@ref muestra_emg_t), que el consumidor lee con un *cast*.
+ *
+ * Las funciones del productor están en IRAM: se llaman desde el callback del ADC, que se ejecuta
+ * también durante las escrituras en flash (`CONFIG_ADC_CONTINUOUS_ISR_IRAM_SAFE`).
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_attr.h"
+#include "globales.h"
+
+#define ANILLO_MUESTRAS_POR_BLOQUE FREC_EJ_TAREAS_POST_TOMA_DATOS ///< Muestras por canal y bloque: las que llegan entre dos ejecuciones del procesado.
+#define ANILLO_FILA_CANAL FILA_EMG(ANILLO_MUESTRAS_POR_BLOQUE) ///< Distancia, en muestras, entre las filas de dos canales consecutivos de un bloque.
+#define ANILLO_MUESTRAS_HUECO (NUMERO_CANALES_EMG * ANILLO_FILA_CANAL) ///< Tamaño de un hueco del anillo, en muestras.
+#define ANILLO_PALABRAS_HUECO (ANILLO_MUESTRAS_HUECO * sizeof(muestra_emg_t) / sizeof(uint16_t)) ///< Tamaño de un hueco en `uint16_t`: el de un bloque filtrado, que nunca es menor que uno crudo.
+#define ANILLO_CANAL(bloque, canal) ((bloque) + (canal) * ANILLO_FILA_CANAL) ///< Fila de un canal (@ref Indice_Canal_EMG) dentro de un bloque.
+#define ANILLO_BLOQUES_POR_VENTANA (CIRCULAR_ARRAY_SIZE / FREC_EJ_TAREAS_POST_TOMA_DATOS) ///< Bloques que forman una ventana de análisis.
+#define ANILLO_NUM_BLOQUES 4 ///< Huecos del anillo. Potencia de 2 mayor que @ref ANILLO_BLOQUES_POR_VENTANA.
+
+_Static_assert((ANILLO_NUM_BLOQUES & (ANILLO_NUM_BLOQUES - 1)) == 0, "ANILLO_NUM_BLOQUES debe ser potencia de 2");
+_Static_assert(ANILLO_NUM_BLOQUES > ANILLO_BLOQUES_POR_VENTANA, "El anillo debe alojar una ventana completa y un bloque en escritura");
+_Static_assert(CIRCULAR_ARRAY_SIZE % FREC_EJ_TAREAS_POST_TOMA_DATOS == 0, "FREC_EJ_TAREAS_POST_TOMA_DATOS debe dividir a CIRCULAR_ARRAY_SIZE");
+
+/**
+ * @struct anillo_bloques
+ * @brief Anillo de @ref ANILLO_NUM_BLOQUES bloques de @ref NUMERO_CANALES_EMG × @ref ANILLO_MUESTRAS_POR_BLOQUE muestras.
+ */
+struct anillo_bloques
+{
+  uint16_t bloques[ANILLO_NUM_BLOQUES][ANILLO_PALABRAS_HUECO] __attribute__((aligned(16))); ///< Almacenamiento de los bloques.
+  atomic_uint_least32_t cabeza;          ///< Bloques publicados por el productor.
+  atomic_uint_least32_t cola;            ///< Bloques liberados por el consumidor.
+  atomic_uint_least32_t desbordamientos; ///< Bloques descartados por encontrarse el anillo lleno.
+};
+
+/**
+ * @brief Reserva el siguiente hueco para escritura (lado productor).
+ * @return Puntero al hueco, o `NULL` si el anillo está lleno (se cuenta un desbordamiento).
+ */
+static inline IRAM_ATTR uint16_t *anillo_reservar(struct anillo_bloques *a)
+{
+  uint32_t cabeza = atomic_load_explicit(&a->cabeza, memory_order_relaxed);
+  uint32_t cola = atomic_load_explicit(&a->cola, memory_order_acquire);
+  if (cabeza - cola >= ANILLO_NUM_BLOQUES)
+  {
+    atomic_fetch_add_explicit(&a->desbordamientos, 1, memory_order_relaxed);
+    return NULL;
+  }
+  return a->bloques[cabeza & (ANILLO_NUM_BLOQUES - 1)];
+}
+
+/**
+ * @brief Publica el hueco reservado con @ref anillo_reservar (lado productor).
+ */
+static inline void IRAM_ATTR anillo_publicar(struct anillo_bloques *a)
+{
+  uint32_t cabeza = atomic_load_explicit(&a->cabeza, memory_order_relaxed);
+  atomic_store_explicit(&a->cabeza, cabeza + 1, memory_order_release);
+}
+
+/**
+ * @brief Número de bloques publicados pendientes de liberar (lado consumidor).
+ */
+static inline uint32_t anillo_pendientes(struct anillo_bloques *a)
+{
+  uint32_t cola = atomic_load_explicit(&a->cola, memory_order_relaxed);
+  uint32_t cabeza = atomic_load_explicit(&a->cabeza, memory_order_acquire);
+  return cabeza - cola;
+}
+
+/**
+ * @brief Acceso en el sitio al bloque pendiente número `i`, empezando por el más antiguo (lado consumidor).
+ * @warning `i` debe ser menor que @ref anillo_pendientes.
+ */
+static inline const uint16_t *anillo_bloque(struct anillo_bloques *a, uint32_t i)
+{
+  uint32_t cola = atomic_load_explicit(&a->cola, memory_order_relaxed);
+  return a->bloques[(cola + i) & (ANILLO_NUM_BLOQUES - 1)];
+}
+
+/**
+ * @brief Devuelve al productor el bloque más antiguo (lado consumidor).
+ */
+static inline void anillo_liberar(struct anillo_bloques *a)
+{
+  uint32_t cola = atomic_load_explicit(&a->cola, memory_order_relaxed);
+  atomic_store_explicit(&a->cola, cola + 1, memory_order_release);
+}
+
+/**
+ * @brief Posición (0 a @ref ANILLO_NUM_BLOQUES - 1) de un bloque del anillo.
+ * @details Permite guardar metadatos por bloque en vectores paralelos del mismo tamaño.
+ */
+static inline uint32_t IRAM_ATTR anillo_hueco(const struct anillo_bloques *a, const uint16_t *bloque)
+{
+  return (uint32_t)((bloque - a->bloques[0]) / ANILLO_PALABRAS_HUECO);
+}
+
+/**
+ * @brief Lee el contador de desbordamientos (bloques perdidos desde el arranque).
+ */
+static inline uint32_t anillo_desbordamientos(struct anillo_bloques *a)
+{
+  return atomic_load_explicit(&a->desbordamientos, memory_order_relaxed);
+}
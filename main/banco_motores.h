@@ -0,0 +1,206 @@
+/**
+ * @file banco_motores.h
+ * @brief Banco de actuadores: una instancia de @ref motores por cada entrada de @ref MOTORES_BANCO.
+ * @details
+ * Los recursos caros se comparten entre todos los motores del banco, de modo que añadir un dedo
+ * no añade trabajo proporcional en las interrupciones ni en el bucle de control:
+ * - PWM: todos los canales LEDC cuelgan de un único temporizador (@ref BANCO_TIMER_PWM), que se
+ *   configura una sola vez a `MOTORES_PWM_FREQ_HZ` con `MOTORES_DUTY_BITS` de resolución. Las
+ *   subidas de duty las rampea el propio LEDC (`MOTORES_RAMP_US`, ver motores.h).
+ * - Duty por lotes: `motores_set_duty()` solo anota el duty pedido y @ref banco_confirmar_duty lo
+ *   escribe en el LEDC una vez por ciclo de control, y solo en los canales que han cambiado.
+ * - Encoders: con @ref ENCODER_PCNT a `1` cada motor usa una unidad PCNT (cuadratura por hardware,
+ *   sin interrupción por flanco). Con `0` todos comparten el servicio de interrupciones GPIO y una
+ *   única rutina, @ref updateMotores, que recibe su instancia en `arg`. No se mezclan: recorridos,
+ *   objetivos y posiciones guardadas están en pasos de @ref ENCODER_PASOS_POR_CICLO, y un encoder
+ *   x2 con límites de x4 recorrería el doble hasta el tope mecánico.
+ * - Velocidad: el primer motor con captura MCPWM crea el temporizador de captura y los demás solo
+ *   añaden un canal sobre él (`motores_share_velocity()`). Sin canales libres la velocidad se
+ *   estima por diferencia de cuentas.
+ *
+ * @note Solo la tarea de control (@ref NUCLEO_CONTROL) llama a las funciones de `motores.h` sobre
+ * el banco; las interrupciones solo cuentan pasos y cortan el driver. Lo hacen desde IRAM y sobre
+ * @ref bancoMotores, que está en DRAM interna, así que no dependen de la caché de la flash.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "esp_intr_alloc.h"
+#include "globales.h"
+#include "motores.h"
+#include "latencia.h"
+#include "perfilado.h"
+
+#define BANCO_TIMER_PWM LEDC_TIMER_0 ///< Temporizador LEDC compartido por los canales PWM de todos los motores.
+
+#define BANCO_ENUM(id, encoderA, encoderB, pwm, fase, sleep, canal, minima, maxima) id,
+
+/**
+ * @enum Indice_Motor
+ * @brief Posición de cada motor de @ref MOTORES_BANCO en @ref bancoMotores.
+ */
+enum Indice_Motor
+{
+  MOTORES_BANCO(BANCO_ENUM)
+  NUMERO_MOTORES
+};
+
+/**
+ * @struct config_motor
+ * @brief Pines, canal PWM y recorrido de un motor del banco.
+ */
+struct config_motor
+{
+  gpio_num_t encoderA; ///< Canal A del encoder (flancos que cuenta la ISR software y la captura).
+  gpio_num_t encoderB; ///< Canal B del encoder.
+  gpio_num_t pwm;      ///< Salida PWM de velocidad (ENABLE del driver).
+  gpio_num_t fase;     ///< Salida de dirección (PHASE del driver).
+  gpio_num_t sleep;    ///< Salida SLEEP del driver.
+  ledc_channel_t canal; ///< Canal LEDC de la salida PWM.
+  uint16_t minima;     ///< Posición mínima (abierto), en pasos del encoder.
+  uint16_t maxima;     ///< Posición máxima (cerrado), en pasos del encoder.
+};
+
+#define BANCO_CONFIG(id, encoderA, encoderB, pwm, fase, sleep, canal, minima, maxima) \
+  [id] = {(gpio_num_t)(encoderA), (gpio_num_t)(encoderB), (gpio_num_t)(pwm), (gpio_num_t)(fase), (gpio_num_t)(sleep), (canal), (minima), (maxima)},
+
+static const struct config_motor configMotores[NUMERO_MOTORES] = {MOTORES_BANCO(BANCO_CONFIG)}; ///< Configuración de cada motor.
+
+_Static_assert(MOTOR_PRINCIPAL == 0, "El motor principal debe ser la primera entrada de MOTORES_BANCO");
+_Static_assert((int)NUMERO_MOTORES <= (int)LEDC_CHANNEL_MAX, "Hay más motores que canales LEDC");
+
+struct motores bancoMotores[NUMERO_MOTORES];                            ///< Controladores del banco, inicializados en @ref banco_iniciar.
+struct motores *const motorPrincipal = &bancoMotores[MOTOR_PRINCIPAL]; ///< Motor con medida de corriente y detección de agarre.
+uint16_t posicionesMotores[NUMERO_MOTORES];                             ///< Última posición leída de cada motor (pasos del encoder).
+
+/**
+ * @brief Rutina de interrupción compartida por los encoders decodificados por software.
+ * @param arg Motor al que pertenece el pin (`struct motores *`).
+ * @details Llamada en cada cambio del canal A de cada encoder sin unidad PCNT (ver @ref ENCODER_PCNT).
+ */
+void IRAM_ATTR updateMotores(void *arg)
+{
+  PERFIL_INICIO(PERFIL_ENCODER_ISR);
+  motores_step((struct motores *)arg);
+  PERFIL_FIN(PERFIL_ENCODER_ISR);
+}
+
+#if !ENCODER_PCNT
+/**
+ * @brief Conecta el canal A de un encoder a @ref updateMotores.
+ * @param m Motor del encoder.
+ * @details El servicio de interrupciones GPIO se instala una vez, con `ESP_INTR_FLAG_IRAM` para
+ * que siga atendiendo los encoders durante las escrituras en flash, y después solo se añade el pin.
+ */
+static esp_err_t banco_conectar_isr(struct motores *m)
+{
+  static bool servicioInstalado = false;
+
+  gpio_config_t io_conf = {0};
+  io_conf.intr_type = GPIO_INTR_ANYEDGE;
+  io_conf.mode = GPIO_MODE_INPUT;
+  io_conf.pin_bit_mask = (1ULL << m->dt);
+  io_conf.pull_up_en = GPIO_PULLUP_ENABLE;
+  io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
+  esp_err_t err = gpio_config(&io_conf);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+
+  if (!servicioInstalado)
+  {
+    err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
+    {
+      return err;
+    }
+    servicioInstalado = true;
+  }
+  return gpio_isr_handler_add(m->dt, updateMotores, m);
+}
+#endif
+
+/**
+ * @brief Inicializa todos los motores del banco y la lectura de sus encoders.
+ * @details
+ * Configura el temporizador PWM compartido y, para cada motor, el driver, el lazo cerrado, la
+ * captura de velocidad y el encoder: por PCNT con @ref ENCODER_PCNT a `1`, o por la ISR compartida
+ * con `0`. Cada motor se inicializa antes de conectar su interrupción, así que la ISR nunca ve una
+ * instancia sin configurar.
+ * @return `ESP_OK`, o el primer error del temporizador PWM, de la unidad PCNT o de la interrupción
+ * de un encoder. Un motor sin PCNT no pasa a la ISR: contaría en otra escala que la de sus límites.
+ * Sin captura MCPWM un motor no falla: su velocidad se estima solo por diferencia de cuentas.
+ * Ante un error todos los drivers quedan dormidos (SLEEP a nivel bajo), sin salida al motor.
+ */
+esp_err_t banco_iniciar()
+{
+  esp_err_t err = motores_setup_pwm_timer(BANCO_TIMER_PWM, MOTORES_PWM_FREQ_HZ);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+
+  struct motores *propietarioCaptura = NULL;
+  for (int i = 0; i < NUMERO_MOTORES; i++)
+  {
+    const struct config_motor *c = &configMotores[i];
+    struct motores *m = &bancoMotores[i];
+    motores_init(m, c->encoderB, c->encoderA, c->pwm, c->fase, c->sleep, c->maxima, c->minima, BANCO_TIMER_PWM, c->canal);
+    motores_profile_setup(m, MOTOR_PID_KP * MOTORES_DUTY_MAX, MOTOR_PID_KI * MOTORES_DUTY_MAX, MOTORES_DUTY_MAX / VELOCIDAD_MAXIMA_MOTOR,
+                          MOTOR_PID_KV * MOTORES_DUTY_MAX,
+                          1.0f / FREC_BUCLE_CONTROL, TOLERANCIA_POSICION_MOTOR);
+
+    // Sin captura MCPWM la velocidad se estima solo por diferencia de cuentas
+    if (propietarioCaptura == NULL)
+    {
+      if (motores_setup_velocity(m, TIMER_FREQ) == ESP_OK)
+      {
+        propietarioCaptura = m;
+      }
+    }
+    else
+    {
+      motores_share_velocity(m, propietarioCaptura);
+    }
+
+#if ENCODER_PCNT
+    esp_err_t errEncoder = motores_setup_pcnt(m, ENCODER_FILTRO_GLITCH_NS);
+#else
+    esp_err_t errEncoder = banco_conectar_isr(m);
+#endif
+    if (err == ESP_OK)
+    {
+      err = errEncoder;
+    }
+  }
+
+  if (err != ESP_OK)
+  {
+    for (int i = 0; i < NUMERO_MOTORES; i++)
+    {
+      gpio_set_level(bancoMotores[i].sleep, 0);
+    }
+  }
+  return err;
+}
+
+/**
+ * @brief Escribe en el LEDC el duty pedido en este ciclo a cada motor que lo haya cambiado.
+ * @details Se llama una vez al final de cada ciclo de control, después de todas las órdenes. Es
+ * el punto en que una orden llega al PWM, así que cierra aquí la medida de @ref latencia.h.
+ */
+static inline void banco_confirmar_duty()
+{
+  bool cambiado = false;
+  for (int i = 0; i < NUMERO_MOTORES; i++)
+  {
+    cambiado |= motores_commit_duty(&bancoMotores[i]);
+  }
+  latencia_confirmar(cambiado);
+}
@@ -0,0 +1,392 @@
+/**
+ * @file calibracion_umbrales.h
+ * @brief Calibración en línea de los umbrales de activación y desactivación (@ref ESTADO_CALIBRADO_UMBRALES).
+ * @details
+ * Cada salto de la ventana deslizante actualiza, para cada característica, la media y la varianza
+ * por el método de Welford y, en reposo, el percentil @ref CALIBRACION_PERCENTIL_REPOSO con el
+ * estimador P² (Jain y Chlamtac). La memoria es constante: no se guarda ningún vector de
+ * características.
+ *
+ * Fases de @ref ESTADO_CALIBRADO_UMBRALES (ver @ref tablaEstados):
+ * - `FASE_PAUSA`: pausa de @ref CALIBRACION_PAUSA_MS para que el usuario se prepare.
+ * - `FASE_PASO_1`: contracción mantenida. Estadísticos de activación.
+ * - `FASE_PAUSA`: nueva pausa para relajar el músculo.
+ * - `FASE_PASO_2`: reposo. Estadísticos de desactivación.
+ * - Al terminar el reposo se calculan los umbrales, se publican en @ref parametros.h, se guardan
+ *   (@ref persistencia.h) y se pasa a @ref ESTADO_NORMAL.
+ *
+ * Una fase de medida termina en cuanto el error estándar de la media de todas las características
+ * baja de @ref CALIBRACION_TOLERANCIA_RELATIVA (tras un mínimo de @ref CALIBRACION_VENTANAS_MINIMAS
+ * saltos) o al llegar a @ref CALIBRACION_VENTANAS_MAXIMAS.
+ *
+ * Umbrales, para cada característica con media en reposo μr, desviación σr y media en contracción μc:
+ * - Desactivación: el mayor entre el percentil de reposo y μr + @ref CALIBRACION_DESVIACIONES_REPOSO·σr.
+ * - Activación: μr + @ref CALIBRACION_FRACCION_ACTIVACION·(μc − μr), y nunca por debajo del de desactivación.
+ *
+ * @note Las ventanas consecutivas se solapan, así que las muestras no son independientes y el error
+ * estándar resulta optimista. Por eso el mínimo de saltos cubre varias ventanas completas.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_timer.h"
+#include "globales.h"
+#include "caracteristicas_emg.h"
+#include "maquina_de_estados_protesis.h"
+#include "parametros.h"
+#include "persistencia.h"
+
+/**
+ * @struct estadistico_welford
+ * @brief Media y suma de cuadrados de las desviaciones, actualizadas muestra a muestra.
+ */
+struct estadistico_welford
+{
+  uint32_t n;  ///< Muestras acumuladas.
+  float media; ///< Media de las muestras.
+  float m2;    ///< Σ(x - media)².
+};
+
+/**
+ * @struct percentil_p2
+ * @brief Estimador P² de un percentil con cinco marcadores.
+ */
+struct percentil_p2
+{
+  uint32_t n;        ///< Muestras acumuladas.
+  float p;           ///< Percentil buscado (0–1).
+  float altura[5];   ///< Altura de cada marcador. `altura[2]` es la estimación.
+  float posicion[5]; ///< Posición real de cada marcador (empezando en 1).
+  float deseada[5];  ///< Posición deseada de cada marcador.
+};
+
+/**
+ * @struct calibracion_umbrales
+ * @brief Estado de la calibración en curso.
+ */
+struct calibracion_umbrales
+{
+  struct estadistico_welford contraccion[NUMERO_CARACTERISTICAS]; ///< Estadísticos de la fase de contracción.
+  struct estadistico_welford reposo[NUMERO_CARACTERISTICAS];      ///< Estadísticos de la fase de reposo.
+  struct percentil_p2 percentilReposo[NUMERO_CARACTERISTICAS];    ///< Percentil de cada característica en reposo.
+  enum Fase_Estado faseAnterior;                                  ///< Fase del salto anterior; un cambio reinicia la fase nueva.
+  bool enCalibracion;                                             ///< `true` si el salto anterior estaba en calibración.
+  bool contraccionHecha;                                          ///< `true` una vez medida la contracción.
+  int64_t inicioFase;                                             ///< Instante (µs) de entrada en la fase actual.
+};
+
+struct calibracion_umbrales calibracion; ///< Calibración de umbrales en curso.
+
+/**
+ * @brief Pone a cero un estimador de Welford.
+ */
+static inline void welford_reiniciar(struct estadistico_welford *w)
+{
+  w->n = 0;
+  w->media = 0.0f;
+  w->m2 = 0.0f;
+}
+
+/**
+ * @brief Añade una muestra a un estimador de Welford.
+ */
+static inline void welford_actualizar(struct estadistico_welford *w, float x)
+{
+  w->n++;
+  float delta = x - w->media;
+  w->media += delta / w->n;
+  w->m2 += delta * (x - w->media);
+}
+
+/**
+ * @brief Desviación típica muestral.
+ */
+static inline float welford_desviacion(const struct estadistico_welford *w)
+{
+  return (w->n > 1) ? sqrtf(w->m2 / (w->n - 1)) : 0.0f;
+}
+
+/**
+ * @brief Indica si el error estándar de la media es menor que `tolerancia`·|media|.
+ */
+static inline bool welford_convergido(const struct estadistico_welford *w, float tolerancia)
+{
+  if (w->n < 2)
+  {
+    return false;
+  }
+  // σ²/n ≤ (tol·μ)², sin raíz cuadrada
+  float errorCuadrado = w->m2 / ((float)(w->n - 1) * w->n);
+  float limite = tolerancia * w->media;
+  return errorCuadrado <= limite * limite;
+}
+
+/**
+ * @brief Reinicia un estimador P² para el percentil `p`.
+ */
+static inline void p2_reiniciar(struct percentil_p2 *e, float p)
+{
+  e->n = 0;
+  e->p = p;
+}
+
+/**
+ * @brief Añade una muestra a un estimador P².
+ * @details Las cinco primeras muestras se guardan ordenadas; a partir de ahí cada marcador interior
+ * se desplaza como mucho una posición por muestra, con interpolación parabólica (o lineal si
+ * la parabólica rompe el orden).
+ */
+void p2_actualizar(struct percentil_p2 *e, float x)
+{
+  if (e->n < 5)
+  {
+    // Inserción ordenada
+    uint32_t i = e->n;
+    while (i > 0 && e->altura[i - 1] > x)
+    {
+      e->altura[i] = e->altura[i - 1];
+      i--;
+    }
+    e->altura[i] = x;
+    if (++e->n == 5)
+    {
+      float p = e->p;
+      for (int k = 0; k < 5; k++)
+      {
+        e->posicion[k] = k + 1;
+      }
+      e->deseada[0] = 1.0f;
+      e->deseada[1] = 1.0f + 2.0f * p;
+      e->deseada[2] = 1.0f + 4.0f * p;
+      e->deseada[3] = 3.0f + 2.0f * p;
+      e->deseada[4] = 5.0f;
+    }
+    return;
+  }
+
+  int k;
+  if (x < e->altura[0])
+  {
+    e->altura[0] = x;
+    k = 0;
+  }
+  else if (x >= e->altura[4])
+  {
+    e->altura[4] = x;
+    k = 3;
+  }
+  else
+  {
+    k = 0;
+    while (k < 3 && x >= e->altura[k + 1])
+    {
+      k++;
+    }
+  }
+  for (int i = k + 1; i < 5; i++)
+  {
+    e->posicion[i] += 1.0f;
+  }
+
+  float p = e->p;
+  const float incremento[5] = {0.0f, p / 2.0f, p, (1.0f + p) / 2.0f, 1.0f};
+  for (int i = 0; i < 5; i++)
+  {
+    e->deseada[i] += incremento[i];
+  }
+  e->n++;
+
+  for (int i = 1; i < 4; i++)
+  {
+    float d = e->deseada[i] - e->posicion[i];
+    if ((d >= 1.0f && e->posicion[i + 1] - e->posicion[i] > 1.0f) || (d <= -1.0f && e->posicion[i - 1] - e->posicion[i] < -1.0f))
+    {
+      float s = (d > 0) ? 1.0f : -1.0f;
+      float qi = e->altura[i];
+      float ni = e->posicion[i];
+      float q = qi + s / (e->posicion[i + 1] - e->posicion[i - 1]) *
+                         ((ni - e->posicion[i - 1] + s) * (e->altura[i + 1] - qi) / (e->posicion[i + 1] - ni) +
+                          (e->posicion[i + 1] - ni - s) * (qi - e->altura[i - 1]) / (ni - e->posicion[i - 1]));
+      if (!(e->altura[i - 1] < q && q < e->altura[i + 1]))
+      {
+        int j = i + (int)s;
+        q = qi + s * (e->altura[j] - qi) / (e->posicion[j] - ni);
+      }
+      e->altura[i] = q;
+      e->posicion[i] = ni + s;
+    }
+  }
+}
+
+/**
+ * @brief Estimación actual del percentil.
+ */
+static inline float p2_valor(const struct percentil_p2 *e)
+{
+  if (e->n >= 5)
+  {
+    return e->altura[2];
+  }
+  return (e->n > 0) ? e->altura[(uint32_t)(e->p * (e->n - 1) + 0.5f)] : 0.0f;
+}
+
+/**
+ * @brief Indica si una fase de medida ha terminado (convergencia o máximo de saltos).
+ */
+static bool calibracion_fase_terminada(const struct estadistico_welford w[NUMERO_CARACTERISTICAS])
+{
+  if (w[0].n >= CALIBRACION_VENTANAS_MAXIMAS)
+  {
+    return true;
+  }
+  if (w[0].n < CALIBRACION_VENTANAS_MINIMAS)
+  {
+    return false;
+  }
+  for (int c = 0; c < NUMERO_CARACTERISTICAS; c++)
+  {
+    if (!welford_convergido(&w[c], CALIBRACION_TOLERANCIA_RELATIVA))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Calcula los umbrales a partir de los estadísticos de contracción y reposo y los publica.
+ * @return `false` si los parámetros estaban ocupados (p. ej. por el comando `param`); se reintenta
+ * en el salto siguiente.
+ */
+static bool calibracion_aplicar_umbrales()
+{
+  struct parametros_ajustables *p = parametros_editar();
+  if (p == NULL)
+  {
+    return false;
+  }
+
+  float umbralAct[NUMERO_CARACTERISTICAS];
+  float umbralDes[NUMERO_CARACTERISTICAS];
+  for (int c = 0; c < NUMERO_CARACTERISTICAS; c++)
+  {
+    const struct estadistico_welford *r = &calibracion.reposo[c];
+    float porDesviacion = r->media + CALIBRACION_DESVIACIONES_REPOSO * welford_desviacion(r);
+    float percentil = p2_valor(&calibracion.percentilReposo[c]);
+    umbralDes[c] = (percentil > porDesviacion) ? percentil : porDesviacion;
+
+    float activacion = r->media + CALIBRACION_FRACCION_ACTIVACION * (calibracion.contraccion[c].media - r->media);
+    umbralAct[c] = (activacion > umbralDes[c]) ? activacion : umbralDes[c];
+  }
+
+  p->umbralActMAV = umbralAct[CARACTERISTICA_MAV];
+  p->umbralDesMAV = umbralDes[CARACTERISTICA_MAV];
+  p->umbralActVar = umbralAct[CARACTERISTICA_VARIANZA];
+  p->umbralDesVar = umbralDes[CARACTERISTICA_VARIANZA];
+  p->umbralActWL = umbralAct[CARACTERISTICA_WL];
+  p->umbralDesWL = umbralDes[CARACTERISTICA_WL];
+  parametros_publicar(p);
+  umbralesCalibrados = true;
+  persistencia_solicitar_guardado();
+  return true;
+}
+
+/**
+ * @brief Prepara los estimadores de la fase en la que se acaba de entrar.
+ */
+static void calibracion_entrar_fase(enum Fase_Estado fase, int64_t ahora)
+{
+  calibracion.faseAnterior = fase;
+  calibracion.inicioFase = ahora;
+  for (int c = 0; c < NUMERO_CARACTERISTICAS; c++)
+  {
+    if (fase == FASE_PASO_1)
+    {
+      welford_reiniciar(&calibracion.contraccion[c]);
+    }
+    else if (fase == FASE_PASO_2)
+    {
+      welford_reiniciar(&calibracion.reposo[c]);
+      p2_reiniciar(&calibracion.percentilReposo[c], CALIBRACION_PERCENTIL_REPOSO);
+    }
+  }
+}
+
+/**
+ * @brief Actualiza la calibración con las características de un salto.
+ * @param caracteristicas Vector de @ref NUMERO_CARACTERISTICAS valores (ver @ref Indice_Caracteristica).
+ * @details Se llama en cada salto de la ventana; fuera de @ref ESTADO_CALIBRADO_UMBRALES no hace
+ * nada. Avanza la fase de @ref estado_protesis según termina cada parte de la calibración.
+ */
+void calibracion_actualizar(const float caracteristicas[NUMERO_CARACTERISTICAS])
+{
+  if (estado_protesis.estado_actual != ESTADO_CALIBRADO_UMBRALES)
+  {
+    calibracion.enCalibracion = false;
+    return;
+  }
+
+  int64_t ahora = esp_timer_get_time();
+  if (!calibracion.enCalibracion)
+  {
+    calibracion.enCalibracion = true;
+    calibracion.contraccionHecha = false;
+    calibracion_entrar_fase(estado_protesis.fase_actual, ahora);
+  }
+  else if (estado_protesis.fase_actual != calibracion.faseAnterior)
+  {
+    calibracion_entrar_fase(estado_protesis.fase_actual, ahora);
+  }
+
+  switch (estado_protesis.fase_actual)
+  {
+  case FASE_PAUSA:
+    if (ahora - calibracion.inicioFase < CALIBRACION_PAUSA_MS * 1000LL)
+    {
+      break;
+    }
+    if (calibracion.contraccionHecha)
+    {
+      MAQUINA_CAMBIAR_FASE(&estado_protesis, ESTADO_CALIBRADO_UMBRALES, FASE_PAUSA, FASE_PASO_2);
+    }
+    else
+    {
+      MAQUINA_CAMBIAR_FASE(&estado_protesis, ESTADO_CALIBRADO_UMBRALES, FASE_PAUSA, FASE_PASO_1);
+    }
+    break;
+
+  case FASE_PASO_1:
+    for (int c = 0; c < NUMERO_CARACTERISTICAS; c++)
+    {
+      welford_actualizar(&calibracion.contraccion[c], caracteristicas[c]);
+    }
+    if (calibracion_fase_terminada(calibracion.contraccion))
+    {
+      calibracion.contraccionHecha = true;
+      MAQUINA_CAMBIAR_FASE(&estado_protesis, ESTADO_CALIBRADO_UMBRALES, FASE_PASO_1, FASE_PAUSA);
+    }
+    break;
+
+  case FASE_PASO_2:
+    for (int c = 0; c < NUMERO_CARACTERISTICAS; c++)
+    {
+      welford_actualizar(&calibracion.reposo[c], caracteristicas[c]);
+      p2_actualizar(&calibracion.percentilReposo[c], caracteristicas[c]);
+    }
+    if (calibracion_fase_terminada(calibracion.reposo))
+    {
+      if (calibracion.contraccionHecha && !calibracion_aplicar_umbrales())
+      {
+        break;
+      }
+      maquina_completar_fase(&estado_protesis);
+    }
+    break;
+
+  default:
+    break;
+  }
+}
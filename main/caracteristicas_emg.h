@@ -0,0 +1,295 @@
+/**
+ * @file caracteristicas_emg.h
+ * @brief Cálculo en una sola pasada de las características EMG (MAV, varianza y WL).
+ * @details
+ * Las tres características se obtienen a partir de cuatro sumas (enteras con muestras `int16_t`,
+ * en `double` con @ref EMG_MUESTRA_FLOAT) que se acumulan recorriendo la ventana una única vez:
+ * - Σ|x|            → MAV = Σ|x| / N
+ * - Σx y Σx²        → Varianza = (Σx² - (Σx)² / N) / (N - 1)
+ * - Σ|x[i]-x[i-1]|  → WL
+ *
+ * Existen dos implementaciones de las sumas:
+ * - @ref caracteristicas_sumas_ref: referencia escalar en C, válida en cualquier destino.
+ * - `caracteristicas_sumas_s3`: kernel vectorial en ensamblador PIE del ESP32-S3
+ *   (ver caracteristicas_emg_s3.S), 8 muestras de 16 bits por instrucción.
+ *
+ * El kernel vectorial se usa solo si @ref CARACTERISTICAS_SIMD está activo, las muestras son
+ * `int16_t` y tras comprobar en @ref caracteristicas_iniciar que da exactamente el mismo resultado
+ * que la referencia.
+ *
+ * @warning Con muestras `int16_t` ambas implementaciones requieren el rango ±4095 (ADC de 12 bits centrado).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include "sdkconfig.h"
+#include "esp_cpu.h"
+#include "globales.h"
+
+/**
+ * @enum Indice_Caracteristica
+ * @brief Posición de cada característica dentro del vector de características.
+ */
+enum Indice_Caracteristica
+{
+  CARACTERISTICA_MAV,      ///< Media del valor absoluto.
+  CARACTERISTICA_VARIANZA, ///< Varianza.
+  CARACTERISTICA_WL        ///< Longitud de onda.
+};
+
+_Static_assert(CARACTERISTICA_WL + 1 == NUMERO_CARACTERISTICAS, "Indice_Caracteristica no coincide con NUMERO_CARACTERISTICAS");
+
+#define CARACTERISTICAS_KERNEL_S3 (CARACTERISTICAS_SIMD && CONFIG_IDF_TARGET_ESP32S3 && !EMG_MUESTRA_FLOAT) ///< Se compila el kernel PIE (solo para muestras `int16_t`).
+
+#if EMG_MUESTRA_FLOAT
+/**
+ * @struct sumas_emg
+ * @brief Sumas de una ventana de la variante de referencia.
+ */
+struct sumas_emg
+{
+  acumulador_emg_t suma_abs;                ///< Σ|x|.
+  acumulador_emg_t suma_dif_abs;            ///< Σ|x[i] - x[i-1]|.
+  acumulador_emg_t suma;                    ///< Σx.
+  acumulador_cuadrados_emg_t suma_cuadrados; ///< Σx².
+};
+#else
+/**
+ * @struct sumas_emg
+ * @brief Sumas enteras de una ventana. La disposición la comparte el kernel en ensamblador.
+ */
+struct sumas_emg
+{
+  int32_t suma_abs;          ///< Σ|x|.
+  int32_t suma_dif_abs;      ///< Σ|x[i] - x[i-1]|.
+  int32_t suma;              ///< Σx.
+  uint32_t suma_cuadrados_lo; ///< Σx², 32 bits bajos.
+  int32_t suma_cuadrados_hi;  ///< Σx², bits altos (el acumulador ACCX es de 40 bits).
+};
+#endif
+
+#if CARACTERISTICAS_KERNEL_S3
+/**
+ * @brief Kernel PIE: sumas de `bloques` grupos de 8 muestras. `x` debe estar alineado a 16 bytes.
+ * @note La primera diferencia se calcula contra 0, por lo que `suma_dif_abs` incluye |x[0]|.
+ */
+extern void caracteristicas_sumas_s3(const int16_t *x, uint32_t bloques, struct sumas_emg *s);
+#endif
+
+bool caracteristicasSimdValidado = false; ///< `true` si el kernel vectorial ha superado la comprobación de arranque.
+
+/**
+ * @brief Devuelve Σx² de unas sumas.
+ */
+static inline acumulador_cuadrados_emg_t caracteristicas_suma_cuadrados(const struct sumas_emg *s)
+{
+#if EMG_MUESTRA_FLOAT
+  return s->suma_cuadrados;
+#else
+  return ((int64_t)s->suma_cuadrados_hi << 32) | s->suma_cuadrados_lo;
+#endif
+}
+
+/**
+ * @brief Guarda Σx² en unas sumas.
+ */
+static inline void caracteristicas_fijar_cuadrados(struct sumas_emg *s, acumulador_cuadrados_emg_t sumaCuadrados)
+{
+#if EMG_MUESTRA_FLOAT
+  s->suma_cuadrados = sumaCuadrados;
+#else
+  s->suma_cuadrados_lo = (uint32_t)sumaCuadrados;
+  s->suma_cuadrados_hi = (int32_t)(sumaCuadrados >> 32);
+#endif
+}
+
+/**
+ * @brief Implementación escalar de referencia de las sumas de una ventana.
+ * @param x Ventana de muestras.
+ * @param n Número de muestras.
+ * @param s Sumas resultantes.
+ */
+static inline void caracteristicas_sumas_ref(const muestra_emg_t *x, uint32_t n, struct sumas_emg *s)
+{
+  acumulador_emg_t sumaAbs = 0;
+  acumulador_emg_t sumaDif = 0;
+  acumulador_emg_t suma = 0;
+  acumulador_cuadrados_emg_t sumaCuadrados = 0;
+  acumulador_emg_t anterior = (n > 0) ? x[0] : 0;
+
+  for (uint32_t i = 0; i < n; i++)
+  {
+    acumulador_emg_t v = x[i];
+    acumulador_emg_t d = v - anterior;
+    suma += v;
+    sumaAbs += (v < 0) ? -v : v;
+    sumaDif += (d < 0) ? -d : d;
+    sumaCuadrados += v * v;
+    anterior = v;
+  }
+
+  s->suma_abs = sumaAbs;
+  s->suma_dif_abs = sumaDif;
+  s->suma = suma;
+  caracteristicas_fijar_cuadrados(s, sumaCuadrados);
+}
+
+/**
+ * @brief Sumas de una ventana con la mejor implementación disponible.
+ * @details El kernel vectorial procesa los grupos completos de 8 muestras y la cola se completa en C.
+ */
+static inline void caracteristicas_sumas(const muestra_emg_t *x, uint32_t n, struct sumas_emg *s)
+{
+#if CARACTERISTICAS_KERNEL_S3
+  uint32_t bloques = n / 8;
+  if (caracteristicasSimdValidado && bloques > 0 && ((uintptr_t)x & 0xF) == 0)
+  {
+    caracteristicas_sumas_s3(x, bloques, s);
+    s->suma_dif_abs -= (x[0] < 0) ? -x[0] : x[0];
+
+    uint32_t hechas = bloques * 8;
+    if (hechas < n)
+    {
+      // La cola empieza en la última muestra vectorial para incluir su diferencia
+      struct sumas_emg cola;
+      caracteristicas_sumas_ref(&x[hechas - 1], n - hechas + 1, &cola);
+      int32_t ultima = x[hechas - 1];
+      int64_t cuadrados = caracteristicas_suma_cuadrados(s) + caracteristicas_suma_cuadrados(&cola) - ultima * ultima;
+      s->suma_abs += cola.suma_abs - ((ultima < 0) ? -ultima : ultima);
+      s->suma_dif_abs += cola.suma_dif_abs;
+      s->suma += cola.suma - ultima;
+      caracteristicas_fijar_cuadrados(s, cuadrados);
+    }
+    return;
+  }
+#endif
+  caracteristicas_sumas_ref(x, n, s);
+}
+
+/**
+ * @brief Convierte las sumas de una ventana de `n` muestras en el vector de características.
+ */
+static inline void caracteristicas_desde_sumas(const struct sumas_emg *s, uint32_t n, float caracteristicas[NUMERO_CARACTERISTICAS])
+{
+  // Con muestras int16_t, n·Σx² - (Σx)² es exacto en 64 bits; solo la división final se hace en coma flotante
+  acumulador_cuadrados_emg_t numerador = (acumulador_cuadrados_emg_t)n * caracteristicas_suma_cuadrados(s) -
+                                         (acumulador_cuadrados_emg_t)s->suma * s->suma;
+  caracteristicas[CARACTERISTICA_MAV] = (float)s->suma_abs / n;
+  caracteristicas[CARACTERISTICA_VARIANZA] = (n > 1) ? (float)numerador / ((float)n * (n - 1)) : 0.0f;
+  caracteristicas[CARACTERISTICA_WL] = (float)s->suma_dif_abs;
+}
+
+/**
+ * @brief Calcula las características de una ventana en una sola pasada.
+ * @param x Ventana de muestras (alineada a 16 bytes para usar el kernel vectorial).
+ * @param n Número de muestras.
+ * @param caracteristicas Vector de @ref NUMERO_CARACTERISTICAS resultados (ver @ref Indice_Caracteristica).
+ */
+static inline void caracteristicas_calcular(const muestra_emg_t *x, uint32_t n, float caracteristicas[NUMERO_CARACTERISTICAS])
+{
+  struct sumas_emg s;
+  caracteristicas_sumas(x, n, &s);
+  caracteristicas_desde_sumas(&s, n, caracteristicas);
+}
+
+/**
+ * @brief Calcula las características del canal principal de @ref filteredEMG y actualiza @ref MAVEMG,
+ * @ref VarianzaEMG y @ref WLEMG.
+ */
+void caracteristicas_actualizar()
+{
+  float caracteristicas[NUMERO_CARACTERISTICAS];
+  caracteristicas_calcular(filteredEMG[CANAL_EMG_PRINCIPAL], CIRCULAR_ARRAY_SIZE, caracteristicas);
+  MAVEMG = caracteristicas[CARACTERISTICA_MAV];
+  VarianzaEMG = caracteristicas[CARACTERISTICA_VARIANZA];
+  WLEMG = caracteristicas[CARACTERISTICA_WL];
+}
+
+/**
+ * @brief Rellena una ventana de prueba con ruido pseudoaleatorio en el rango ±4095.
+ */
+static inline void caracteristicas_ventana_prueba(muestra_emg_t *x, uint32_t n, uint32_t semilla)
+{
+  for (uint32_t i = 0; i < n; i++)
+  {
+    semilla = semilla * 1664525u + 1013904223u;
+    x[i] = (muestra_emg_t)((int32_t)((semilla >> 16) % 8191) - 4095);
+  }
+}
+
+/**
+ * @brief Comprueba el kernel vectorial contra la referencia escalar y lo habilita si coinciden.
+ * @details Se prueban longitudes con y sin cola escalar. Debe llamarse una vez al arrancar.
+ * @return `true` si se usará el kernel vectorial.
+ */
+bool caracteristicas_iniciar()
+{
+  caracteristicasSimdValidado = false;
+#if CARACTERISTICAS_KERNEL_S3
+  static int16_t prueba[256] __attribute__((aligned(16)));
+  caracteristicas_ventana_prueba(prueba, 256, 12345);
+
+  static const uint32_t longitudes[] = {8, 50, 64, 255, 256};
+  bool iguales = true;
+  for (uint32_t i = 0; i < sizeof(longitudes) / sizeof(longitudes[0]); i++)
+  {
+    struct sumas_emg ref, simd;
+    caracteristicas_sumas_ref(prueba, longitudes[i], &ref);
+    caracteristicasSimdValidado = true;
+    caracteristicas_sumas(prueba, longitudes[i], &simd);
+    caracteristicasSimdValidado = false;
+    iguales = iguales && ref.suma_abs == simd.suma_abs && ref.suma_dif_abs == simd.suma_dif_abs &&
+              ref.suma == simd.suma && caracteristicas_suma_cuadrados(&ref) == caracteristicas_suma_cuadrados(&simd);
+  }
+  caracteristicasSimdValidado = iguales;
+#endif
+  return caracteristicasSimdValidado;
+}
+
+/**
+ * @brief Microbenchmark: ciclos de CPU por ventana de `n` muestras de cada implementación.
+ * @param n Muestras por ventana (máximo 1024).
+ * @param repeticiones Número de ventanas medidas.
+ * @details Imprime los ciclos medios por ventana y por muestra para comparar con el presupuesto
+ * de cada bloque (@ref FREC_EJ_TAREAS_POST_TOMA_DATOS / @ref SAMPLING_FREQ segundos).
+ */
+void caracteristicas_benchmark(uint32_t n, uint32_t repeticiones)
+{
+  static muestra_emg_t ventana[1024] __attribute__((aligned(16)));
+  if (n > 1024 || n == 0 || repeticiones == 0)
+  {
+    return;
+  }
+  caracteristicas_ventana_prueba(ventana, n, 6789);
+
+  float caracteristicas[NUMERO_CARACTERISTICAS];
+  struct sumas_emg s;
+
+  uint32_t inicio = esp_cpu_get_cycle_count();
+  for (uint32_t i = 0; i < repeticiones; i++)
+  {
+    caracteristicas_sumas_ref(ventana, n, &s);
+    caracteristicas_desde_sumas(&s, n, caracteristicas);
+  }
+  uint32_t ciclosRef = (esp_cpu_get_cycle_count() - inicio) / repeticiones;
+  printf("caracteristicas: ventana %lu muestras, escalar %lu ciclos (%lu/muestra)\n",
+         (unsigned long)n, (unsigned long)ciclosRef, (unsigned long)(ciclosRef / n));
+
+  if (caracteristicasSimdValidado)
+  {
+    inicio = esp_cpu_get_cycle_count();
+    for (uint32_t i = 0; i < repeticiones; i++)
+    {
+      caracteristicas_calcular(ventana, n, caracteristicas);
+    }
+    uint32_t ciclosSimd = (esp_cpu_get_cycle_count() - inicio) / repeticiones;
+    printf("caracteristicas: ventana %lu muestras, PIE %lu ciclos (%lu/muestra)\n",
+           (unsigned long)n, (unsigned long)ciclosSimd, (unsigned long)(ciclosSimd / n));
+  }
+  else
+  {
+    printf("caracteristicas: kernel PIE no disponible\n");
+  }
+}
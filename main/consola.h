@@ -0,0 +1,41 @@
+/**
+ * @file consola.h
+ * @brief Consola de comandos (`esp_console`) sobre la UART de la consola principal.
+ * @details
+ * USB-Serial-JTAG está reservado para la traza binaria (@ref traza.h), así que la consola usa la
+ * UART configurada en `sdkconfig` (`CONFIG_ESP_CONSOLE_UART_NUM`). Cada módulo registra sus
+ * comandos con `esp_console_cmd_register()` después de @ref consola_iniciar; la REPL los busca al
+ * ejecutarlos, de modo que el orden de registro no importa.
+ */
+
+#pragma once
+
+#include "esp_console.h"
+#include "esp_err.h"
+
+#define CONSOLA_PROMPT "protesis> " ///< Indicador de la línea de comandos.
+#define CONSOLA_PILA 4096           ///< Pila de la tarea de la REPL (los comandos se ejecutan en ella).
+#define CONSOLA_PRIORIDAD 1         ///< Prioridad de la tarea de la REPL, por debajo de adquisición y control.
+
+esp_console_repl_t *consolaRepl = NULL; ///< REPL en marcha (`NULL` si no se ha iniciado).
+
+/**
+ * @brief Crea y arranca la REPL con el comando `help`.
+ * @return `ESP_OK` si la consola está en marcha, o el error de `esp_console`.
+ */
+esp_err_t consola_iniciar()
+{
+  esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+  repl_config.prompt = CONSOLA_PROMPT;
+  repl_config.task_stack_size = CONSOLA_PILA;
+  repl_config.task_priority = CONSOLA_PRIORIDAD;
+  esp_console_dev_uart_config_t uart_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+
+  esp_err_t err = esp_console_new_repl_uart(&uart_config, &repl_config, &consolaRepl);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+  esp_console_register_help_command();
+  return esp_console_start_repl(consolaRepl);
+}
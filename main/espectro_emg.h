@@ -0,0 +1,472 @@
+/**
+ * @file espectro_emg.h
+ * @brief Características espectrales EMG (frecuencia media, mediana y potencia por bandas) sobre una FFT real.
+ * @details
+ * Las características temporales (@ref ventana_deslizante.h) no distinguen una contracción débil de
+ * un músculo fatigado; la fatiga desplaza el espectro hacia frecuencias bajas. Esta etapa calcula,
+ * para cada canal de @ref CANALES_EMG, sobre ventanas de @ref ESPECTRO_MUESTRAS muestras filtradas
+ * solapadas cada @ref ESPECTRO_SALTO:
+ * - Frecuencia media y mediana del espectro de potencia entre @ref ESPECTRO_FRECUENCIA_MINIMA y
+ *   @ref ESPECTRO_FRECUENCIA_MAXIMA.
+ * - Potencia de cada banda de @ref ESPECTRO_BANDAS, en cuentas² (comparable con @ref VarianzaEMG).
+ *
+ * Cada ventana se multiplica por una ventana de Hann y pasa por una FFT real de
+ * @ref ESPECTRO_MUESTRAS puntos, hecha como FFT compleja de la mitad de puntos (muestras pares en la
+ * parte real, impares en la imaginaria) y una pasada de separación. La FFT compleja es
+ * `dsps_fft2r_fc32` de ESP-DSP si el componente está disponible o, si no, una radix-2 en C. Las
+ * tablas de Hann y de giro se calculan una vez en @ref espectro_preparar.
+ *
+ * Todo corre en una tarea propia de baja prioridad en @ref NUCLEO_ADQUISICION, el núcleo con menos
+ * carga: la tarea de adquisición le pasa cada bloque filtrado por @ref anilloEspectro (sin esperar,
+ * si está lleno el bloque se pierde) y el resultado se publica con un seqlock, igual que
+ * @ref sensores.h. El bucle de control lo lee con @ref espectro_leer en tiempo constante y sin
+ * bloquear, así que la etapa espectral nunca retrasa el camino temporal.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "esp_err.h"
+#include "globales.h"
+#include "anillo_bloques.h"
+#include "perfilado.h"
+
+#if __has_include("dsps_fft2r.h")
+#include "dsps_fft2r.h"
+#define ESPECTRO_EMG_ESP_DSP 1 ///< La FFT compleja usa ESP-DSP.
+#else
+#define ESPECTRO_EMG_ESP_DSP 0
+#endif
+
+#define ESPECTRO_MUESTRAS 256           ///< Puntos de la FFT real (128 ms a 2 kHz, resolución de 7,8 Hz). Potencia de 2.
+#define ESPECTRO_SALTO 128              ///< Muestras entre dos ventanas espectrales (solape del 50 %).
+#define ESPECTRO_FRECUENCIA_MINIMA 20.0f  ///< Límite inferior (Hz) de la frecuencia media y mediana.
+#define ESPECTRO_FRECUENCIA_MAXIMA 450.0f ///< Límite superior (Hz) de la frecuencia media y mediana.
+#define ESPECTRO_PRIORIDAD 1            ///< Prioridad de la tarea espectral (justo por encima de idle).
+#define ESPECTRO_REINTENTOS_LECTURA 4   ///< Intentos de lectura del seqlock antes de usar la copia anterior.
+
+_Static_assert((ESPECTRO_MUESTRAS & (ESPECTRO_MUESTRAS - 1)) == 0 && ESPECTRO_MUESTRAS >= 8, "ESPECTRO_MUESTRAS debe ser potencia de 2");
+_Static_assert(ESPECTRO_SALTO >= 1 && ESPECTRO_SALTO <= ESPECTRO_MUESTRAS, "ESPECTRO_SALTO debe estar entre 1 y ESPECTRO_MUESTRAS");
+
+/**
+ * @brief Bandas de potencia, en orden: `BANDA(id, desde Hz, hasta Hz)`.
+ * @details Cada banda suma los bins de `desde` (incluido) a `hasta` (excluido).
+ */
+#define ESPECTRO_BANDAS(BANDA)                    \
+  BANDA(ESPECTRO_POTENCIA_BAJA, 20.0f, 60.0f)     \
+  BANDA(ESPECTRO_POTENCIA_MEDIA, 60.0f, 150.0f)   \
+  BANDA(ESPECTRO_POTENCIA_ALTA, 150.0f, 450.0f)
+
+#define ESPECTRO_ENUM(id, desde, hasta) id,
+
+/**
+ * @enum Indice_Espectro
+ * @brief Posición de cada característica espectral dentro de la fila de un canal.
+ */
+enum Indice_Espectro
+{
+  ESPECTRO_FRECUENCIA_MEDIA,   ///< Frecuencia media (Hz).
+  ESPECTRO_FRECUENCIA_MEDIANA, ///< Frecuencia mediana (Hz).
+  ESPECTRO_BANDAS(ESPECTRO_ENUM)
+  NUMERO_CARACTERISTICAS_ESPECTRO
+};
+
+#define ESPECTRO_BIN(f) ((uint32_t)((f) * ESPECTRO_MUESTRAS / SAMPLING_FREQ + 0.5f)) ///< Bin más cercano a una frecuencia.
+#define ESPECTRO_RANGO(id, desde, hasta) {ESPECTRO_BIN(desde), ESPECTRO_BIN(hasta)},
+
+static const uint16_t espectroBandas[][2] = {ESPECTRO_BANDAS(ESPECTRO_RANGO)}; ///< Bins [desde, hasta) de cada banda.
+
+_Static_assert(sizeof(espectroBandas) / sizeof(espectroBandas[0]) == NUMERO_CARACTERISTICAS_ESPECTRO - ESPECTRO_POTENCIA_BAJA, "ESPECTRO_BANDAS no coincide con Indice_Espectro");
+_Static_assert(ESPECTRO_FRECUENCIA_MAXIMA < SAMPLING_FREQ / 2, "ESPECTRO_FRECUENCIA_MAXIMA debe estar por debajo de Nyquist");
+
+/**
+ * @struct resultado_espectro
+ * @brief Características espectrales de la última ventana de todos los canales.
+ */
+struct resultado_espectro
+{
+  float caracteristicas[NUMERO_CANALES_EMG][NUMERO_CARACTERISTICAS_ESPECTRO]; ///< Una fila por canal (ver @ref Indice_Espectro).
+  uint32_t ventanas; ///< Ventanas analizadas desde el arranque (0 = todavía no hay resultado).
+};
+
+/**
+ * @struct seqlock_espectro
+ * @brief Resultado publicado con contador de secuencia (un escritor, varios lectores).
+ */
+struct seqlock_espectro
+{
+  atomic_uint_least32_t secuencia;  ///< Impar mientras se escribe.
+  struct resultado_espectro datos;  ///< Último resultado publicado.
+};
+
+/**
+ * @struct historial_espectro
+ * @brief Últimas @ref ESPECTRO_MUESTRAS muestras filtradas de cada canal.
+ */
+struct historial_espectro
+{
+  muestra_emg_t muestras[NUMERO_CANALES_EMG][ESPECTRO_MUESTRAS]; ///< Historial circular de cada canal.
+  uint32_t indice;     ///< Muestra más antigua (siguiente posición de escritura), común a todos los canales.
+  uint32_t llenas;     ///< Muestras válidas (hasta @ref ESPECTRO_MUESTRAS).
+  uint32_t desdeSalto; ///< Muestras recibidas desde la última ventana.
+};
+
+struct anillo_bloques anilloEspectro;         ///< Bloques filtrados de la tarea de adquisición a la espectral.
+struct seqlock_espectro espectroPublicado;    ///< Último resultado de la etapa espectral.
+struct historial_espectro historialEspectro;  ///< Ventana en curso (solo la tarea espectral).
+struct resultado_espectro espectroCalculado;  ///< Resultado en construcción (solo la tarea espectral).
+TaskHandle_t tareaEspectro = NULL;            ///< Tarea de la etapa espectral.
+atomic_uint_least32_t espectroOmitidos;       ///< Bloques que la tarea de adquisición no ha enviado a propósito (@ref espectro_omitir_bloque).
+
+float espectroHann[ESPECTRO_MUESTRAS];                                   ///< Ventana de Hann periódica.
+float espectroGiro[ESPECTRO_MUESTRAS / 2 + 1][2];                        ///< Factores de giro `e^{-j2πk/N}` (cos, -sen), k = 0…N/2.
+float espectroDatos[ESPECTRO_MUESTRAS] __attribute__((aligned(16)));     ///< Ventana como N/2 complejos intercalados (re, im).
+float espectroPotencia[ESPECTRO_MUESTRAS / 2 + 1];                       ///< |X[k]|² de la ventana en curso.
+float espectroEscala = 0;                                                ///< Paso de |X[k]|² a potencia unilateral: 2 / (N · Σw²).
+#if ESPECTRO_EMG_ESP_DSP
+float espectroTablaDsp[ESPECTRO_MUESTRAS / 2] __attribute__((aligned(16))); ///< Tabla de giro de ESP-DSP para la FFT de N/2 puntos.
+#endif
+
+/**
+ * @brief Calcula las tablas de Hann y de giro y vacía el historial.
+ * @return `ESP_OK`, o el error de ESP-DSP al preparar su tabla.
+ */
+esp_err_t espectro_preparar()
+{
+  float sumaCuadrados = 0;
+  for (uint32_t i = 0; i < ESPECTRO_MUESTRAS; i++)
+  {
+    espectroHann[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / ESPECTRO_MUESTRAS);
+    sumaCuadrados += espectroHann[i] * espectroHann[i];
+  }
+  espectroEscala = 2.0f / (ESPECTRO_MUESTRAS * sumaCuadrados);
+
+  for (uint32_t k = 0; k <= ESPECTRO_MUESTRAS / 2; k++)
+  {
+    espectroGiro[k][0] = cosf(2.0f * (float)M_PI * k / ESPECTRO_MUESTRAS);
+    espectroGiro[k][1] = -sinf(2.0f * (float)M_PI * k / ESPECTRO_MUESTRAS);
+  }
+
+  historialEspectro.indice = 0;
+  historialEspectro.llenas = 0;
+  historialEspectro.desdeSalto = 0;
+
+#if ESPECTRO_EMG_ESP_DSP
+  esp_err_t err = dsps_fft2r_init_fc32(espectroTablaDsp, ESPECTRO_MUESTRAS / 2);
+  if (err != ESP_OK && err != ESP_ERR_DSP_REINITIALIZED)
+  {
+    return err;
+  }
+#endif
+  return ESP_OK;
+}
+
+#if !ESPECTRO_EMG_ESP_DSP
+/**
+ * @brief FFT compleja radix-2 en el sitio, de `n` puntos intercalados (re, im), con @ref espectroGiro.
+ */
+static void espectro_fft_ref(float *z, uint32_t n)
+{
+  for (uint32_t i = 1, j = 0; i < n; i++)
+  {
+    uint32_t bit = n >> 1;
+    for (; j & bit; bit >>= 1)
+    {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j)
+    {
+      float re = z[2 * i], im = z[2 * i + 1];
+      z[2 * i] = z[2 * j];
+      z[2 * i + 1] = z[2 * j + 1];
+      z[2 * j] = re;
+      z[2 * j + 1] = im;
+    }
+  }
+
+  for (uint32_t largo = 2; largo <= n; largo <<= 1)
+  {
+    // e^{-j2πk/largo} = espectroGiro[k · N / largo]
+    uint32_t paso = ESPECTRO_MUESTRAS / largo;
+    for (uint32_t i = 0; i < n; i += largo)
+    {
+      for (uint32_t k = 0; k < largo / 2; k++)
+      {
+        const float *w = espectroGiro[k * paso];
+        float *a = &z[2 * (i + k)];
+        float *b = &z[2 * (i + k + largo / 2)];
+        float tr = b[0] * w[0] - b[1] * w[1];
+        float ti = b[0] * w[1] + b[1] * w[0];
+        b[0] = a[0] - tr;
+        b[1] = a[1] - ti;
+        a[0] += tr;
+        a[1] += ti;
+      }
+    }
+  }
+}
+#endif
+
+/**
+ * @brief Espectro de potencia de un canal: Hann, FFT real y |X[k]|² en @ref espectroPotencia.
+ * @param c Canal (@ref Indice_Canal_EMG) del historial.
+ */
+static void espectro_potencia_canal(uint32_t c)
+{
+  // La muestra más antigua del historial es la primera de la ventana
+  const muestra_emg_t *x = historialEspectro.muestras[c];
+  uint32_t j = historialEspectro.indice;
+  for (uint32_t i = 0; i < ESPECTRO_MUESTRAS; i++)
+  {
+    espectroDatos[i] = x[j] * espectroHann[i];
+    j = (j + 1) & (ESPECTRO_MUESTRAS - 1);
+  }
+
+  const uint32_t m = ESPECTRO_MUESTRAS / 2;
+#if ESPECTRO_EMG_ESP_DSP
+  dsps_fft2r_fc32(espectroDatos, m);
+  dsps_bit_rev_fc32(espectroDatos, m);
+#else
+  espectro_fft_ref(espectroDatos, m);
+#endif
+
+  // Separación: Z = FFT(pares + j·impares); X[k] = E[k] + W^k·O[k], con
+  // E = (Z[k] + Z*[m-k]) / 2 y O = (Z[k] - Z*[m-k]) / 2j
+  for (uint32_t k = 0; k <= m; k++)
+  {
+    const float *zk = &espectroDatos[2 * (k & (m - 1))];
+    const float *zc = &espectroDatos[2 * ((m - k) & (m - 1))];
+    float er = 0.5f * (zk[0] + zc[0]);
+    float ei = 0.5f * (zk[1] - zc[1]);
+    float orr = 0.5f * (zk[1] + zc[1]);
+    float oi = -0.5f * (zk[0] - zc[0]);
+    const float *w = espectroGiro[k];
+    float xr = er + w[0] * orr - w[1] * oi;
+    float xi = ei + w[0] * oi + w[1] * orr;
+    espectroPotencia[k] = xr * xr + xi * xi;
+  }
+}
+
+/**
+ * @brief Características de @ref espectroPotencia (ver @ref Indice_Espectro).
+ */
+static void espectro_caracteristicas(float caracteristicas[NUMERO_CARACTERISTICAS_ESPECTRO])
+{
+  const float resolucion = (float)SAMPLING_FREQ / ESPECTRO_MUESTRAS;
+  const uint32_t desde = ESPECTRO_BIN(ESPECTRO_FRECUENCIA_MINIMA);
+  const uint32_t hasta = ESPECTRO_BIN(ESPECTRO_FRECUENCIA_MAXIMA);
+
+  float total = 0;
+  float momento = 0;
+  for (uint32_t k = desde; k <= hasta; k++)
+  {
+    total += espectroPotencia[k];
+    momento += k * espectroPotencia[k];
+  }
+
+  float media = 0;
+  float mediana = 0;
+  if (total > 0)
+  {
+    media = momento / total * resolucion;
+    // Cada bin cubre [k - 1/2, k + 1/2): se interpola dentro del bin que cruza la mitad
+    float acumulado = 0;
+    for (uint32_t k = desde; k <= hasta; k++)
+    {
+      if (acumulado + espectroPotencia[k] >= 0.5f * total)
+      {
+        mediana = (k - 0.5f + (0.5f * total - acumulado) / espectroPotencia[k]) * resolucion;
+        break;
+      }
+      acumulado += espectroPotencia[k];
+    }
+  }
+  caracteristicas[ESPECTRO_FRECUENCIA_MEDIA] = media;
+  caracteristicas[ESPECTRO_FRECUENCIA_MEDIANA] = mediana;
+
+  for (uint32_t b = 0; b < NUMERO_CARACTERISTICAS_ESPECTRO - ESPECTRO_POTENCIA_BAJA; b++)
+  {
+    float potencia = 0;
+    for (uint32_t k = espectroBandas[b][0]; k < espectroBandas[b][1]; k++)
+    {
+      potencia += espectroPotencia[k];
+    }
+    caracteristicas[ESPECTRO_POTENCIA_BAJA + b] = potencia * espectroEscala;
+  }
+}
+
+// ==========================
+//   Seqlock
+// ==========================
+
+/**
+ * @brief Publica un resultado nuevo (solo la tarea espectral).
+ */
+static inline void espectro_publicar(const struct resultado_espectro *r)
+{
+  uint32_t secuencia = atomic_load_explicit(&espectroPublicado.secuencia, memory_order_relaxed);
+  atomic_store_explicit(&espectroPublicado.secuencia, secuencia + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  espectroPublicado.datos = *r;
+  atomic_store_explicit(&espectroPublicado.secuencia, secuencia + 2, memory_order_release);
+}
+
+/**
+ * @brief Lee el último resultado en tiempo constante y sin bloquear.
+ * @param r Copia de destino. Si no hay resultado nuevo o no se consigue una lectura coherente
+ * conserva su contenido.
+ * @retval true  Si `r` contiene un resultado coherente nuevo.
+ * @retval false Si no había resultado nuevo o el escritor estaba publicando en todos los intentos.
+ */
+static inline bool espectro_leer(struct resultado_espectro *r)
+{
+  for (int intento = 0; intento < ESPECTRO_REINTENTOS_LECTURA; intento++)
+  {
+    uint32_t antes = atomic_load_explicit(&espectroPublicado.secuencia, memory_order_acquire);
+    if (antes & 1)
+    {
+      continue;
+    }
+    if (espectroPublicado.datos.ventanas == r->ventanas)
+    {
+      return false; // Nada nuevo: se evita la copia
+    }
+    struct resultado_espectro copia = espectroPublicado.datos;
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&espectroPublicado.secuencia, memory_order_relaxed) == antes)
+    {
+      *r = copia;
+      return true;
+    }
+  }
+  return false;
+}
+
+// ==========================
+//   Tarea espectral
+// ==========================
+
+/**
+ * @brief Pasa un bloque filtrado por el historial y analiza cada ventana completada.
+ * @param muestras Bloque de muestras filtradas, una fila por canal (@ref Indice_Canal_EMG).
+ * @param n Número de muestras de cada canal.
+ * @param paso Distancia, en muestras, entre las filas de dos canales consecutivos.
+ * @return Número de ventanas analizadas y publicadas en el bloque.
+ */
+uint32_t espectro_procesar_bloque(const muestra_emg_t *muestras, uint32_t n, uint32_t paso)
+{
+  struct historial_espectro *h = &historialEspectro;
+  uint32_t ventanas = 0;
+
+  for (uint32_t i = 0; i < n; i++)
+  {
+    for (uint32_t c = 0; c < NUMERO_CANALES_EMG; c++)
+    {
+      h->muestras[c][h->indice] = muestras[c * paso + i];
+    }
+    h->indice = (h->indice + 1) & (ESPECTRO_MUESTRAS - 1);
+
+    if (h->llenas < ESPECTRO_MUESTRAS)
+    {
+      if (++h->llenas < ESPECTRO_MUESTRAS)
+      {
+        continue;
+      }
+    }
+    else if (++h->desdeSalto < ESPECTRO_SALTO)
+    {
+      continue;
+    }
+    h->desdeSalto = 0;
+
+    PERFIL_INICIO(PERFIL_ESPECTRO);
+    for (uint32_t c = 0; c < NUMERO_CANALES_EMG; c++)
+    {
+      espectro_potencia_canal(c);
+      espectro_caracteristicas(espectroCalculado.caracteristicas[c]);
+    }
+    espectroCalculado.ventanas++;
+    espectro_publicar(&espectroCalculado);
+    PERFIL_FIN(PERFIL_ESPECTRO);
+    ventanas++;
+  }
+  return ventanas;
+}
+
+/**
+ * @brief Entrega un bloque filtrado a la etapa espectral (tarea de adquisición).
+ * @param bloque Bloque filtrado, una fila de @ref ANILLO_MUESTRAS_POR_BLOQUE muestras por canal.
+ * @details No espera nunca: si la tarea espectral va atrasada el bloque se descarta y queda contado
+ * en @ref anilloEspectro, y la tarea rehace la ventana desde cero para no unir tramos separados.
+ */
+static inline void espectro_enviar_bloque(const muestra_emg_t *bloque)
+{
+  if (tareaEspectro == NULL)
+  {
+    return;
+  }
+  uint16_t *destino = anillo_reservar(&anilloEspectro);
+  if (destino == NULL)
+  {
+    return;
+  }
+  memcpy(destino, bloque, ANILLO_MUESTRAS_HUECO * sizeof(muestra_emg_t));
+  anillo_publicar(&anilloEspectro);
+  xTaskNotifyGive(tareaEspectro);
+}
+
+/**
+ * @brief Anota un bloque que no se envía a la etapa espectral (p. ej. por sobrecarga, @ref plazos.h).
+ * @details La tarea lo trata como un bloque perdido: la siguiente ventana empieza desde cero.
+ */
+static inline void espectro_omitir_bloque()
+{
+  atomic_fetch_add_explicit(&espectroOmitidos, 1, memory_order_relaxed);
+}
+
+/**
+ * @brief Tarea espectral: analiza los bloques de @ref anilloEspectro a medida que llegan.
+ */
+void espectro_tarea(void *parametros)
+{
+  uint32_t desbordamientos = anillo_desbordamientos(&anilloEspectro) + atomic_load_explicit(&espectroOmitidos, memory_order_relaxed);
+  while (1)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    while (anillo_pendientes(&anilloEspectro) > 0)
+    {
+      uint32_t ahora = anillo_desbordamientos(&anilloEspectro) + atomic_load_explicit(&espectroOmitidos, memory_order_relaxed);
+      if (ahora != desbordamientos)
+      {
+        desbordamientos = ahora;
+        historialEspectro.llenas = 0;
+        historialEspectro.desdeSalto = 0;
+      }
+      espectro_procesar_bloque((const muestra_emg_t *)anillo_bloque(&anilloEspectro, 0), ANILLO_MUESTRAS_POR_BLOQUE, ANILLO_FILA_CANAL);
+      anillo_liberar(&anilloEspectro);
+    }
+  }
+}
+
+/**
+ * @brief Prepara las tablas y arranca la tarea espectral en @ref NUCLEO_ADQUISICION.
+ * @return `ESP_OK` si la tarea está en marcha, el error de @ref espectro_preparar o `ESP_ERR_NO_MEM`.
+ */
+esp_err_t espectro_iniciar()
+{
+  esp_err_t err = espectro_preparar();
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+  if (xTaskCreatePinnedToCore(espectro_tarea, "espectro", 3072, NULL, ESPECTRO_PRIORIDAD, &tareaEspectro, NUCLEO_ADQUISICION) != pdPASS)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
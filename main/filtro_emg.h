@@ -0,0 +1,229 @@
+/**
+ * @file filtro_emg.h
+ * @brief Etapa de prefiltrado EMG por bloques: cascada de biquads (notch 50 Hz + paso banda).
+ * @details
+ * Se ejecuta entre la adquisición (@ref muestreo_emg.h) y la extracción de características.
+ * Recibe bloques de muestras crudas del ADC y escribe muestras filtradas (@ref muestra_emg_t, de
+ * 16 bits con signo salvo en la variante de referencia), conservando el estado de cada biquad
+ * entre bloques. Una sola llamada filtra todos los canales de
+ * @ref CANALES_EMG: cada canal tiene su propio estado y comparte los coeficientes de la cascada.
+ *
+ * La cascada se define en @ref FILTRO_EMG_ETAPAS y sus coeficientes se calculan en tiempo de
+ * compilación (fórmulas del *Audio EQ Cookbook*) a partir de las frecuencias de corte y de
+ * @ref SAMPLING_FREQ. Hay dos variantes, elegidas con @ref FILTRO_EMG_PUNTO_FIJO:
+ * - Coma flotante: `dsps_biquad_f32` de ESP-DSP (optimizada para el ESP32-S3; internamente es forma
+ *   directa II) si el componente está disponible o, si no, forma directa II transpuesta en C.
+ * - Punto fijo: forma directa II transpuesta con coeficientes Q28, señal con
+ *   @ref FILTRO_EMG_BITS_FRACCION bits fraccionarios y estado de 64 bits.
+ *
+ * Con @ref EMG_MUESTRA_FLOAT la salida no se redondea ni se satura a `int16_t`.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include "globales.h"
+
+#if !FILTRO_EMG_PUNTO_FIJO && __has_include("dsps_biquad.h")
+#include "dsps_biquad.h"
+#define FILTRO_EMG_ESP_DSP 1 ///< La variante en coma flotante usa ESP-DSP.
+#else
+#define FILTRO_EMG_ESP_DSP 0
+#endif
+
+// ==========================
+//   Configuración de la cascada
+// ==========================
+
+#define FILTRO_EMG_OFFSET_ADC 2048 ///< Nivel medio del ADC de 12 bits, se resta antes de filtrar para evitar el transitorio de arranque.
+#define FILTRO_EMG_BITS_FRACCION 12 ///< Bits fraccionarios de la señal entre etapas en la variante en punto fijo.
+
+/**
+ * @brief Etapas de la cascada, en orden: `ETAPA(tipo, frecuencia en Hz, Q)`.
+ * @details Tipos disponibles: `BIQUAD_NOTCH`, `BIQUAD_PASO_ALTO`, `BIQUAD_PASO_BAJO`.
+ * Por defecto: rechazo de red a 50 Hz y banda EMG de 20–450 Hz.
+ */
+#define FILTRO_EMG_ETAPAS(ETAPA)          \
+  ETAPA(BIQUAD_NOTCH, 50.0, 10.0)         \
+  ETAPA(BIQUAD_PASO_ALTO, 20.0, 0.7071)   \
+  ETAPA(BIQUAD_PASO_BAJO, 450.0, 0.7071)
+
+// ==========================
+//   Coeficientes en compilación
+// ==========================
+
+#define BIQUAD_PI 3.14159265358979323846
+#define BIQUAD_W0(f) (2.0 * BIQUAD_PI * (f) / SAMPLING_FREQ)
+#define BIQUAD_COS(f) __builtin_cos(BIQUAD_W0(f))
+#define BIQUAD_ALFA(f, q) (__builtin_sin(BIQUAD_W0(f)) / (2.0 * (q)))
+#define BIQUAD_A0(f, q) (1.0 + BIQUAD_ALFA(f, q))
+#define BIQUAD_A1(f, q) (-2.0 * BIQUAD_COS(f))
+#define BIQUAD_A2(f, q) (1.0 - BIQUAD_ALFA(f, q))
+
+#define BIQUAD_NOTCH_B0(f, q) (1.0)
+#define BIQUAD_NOTCH_B1(f, q) (-2.0 * BIQUAD_COS(f))
+#define BIQUAD_NOTCH_B2(f, q) (1.0)
+
+#define BIQUAD_PASO_ALTO_B0(f, q) ((1.0 + BIQUAD_COS(f)) / 2.0)
+#define BIQUAD_PASO_ALTO_B1(f, q) (-(1.0 + BIQUAD_COS(f)))
+#define BIQUAD_PASO_ALTO_B2(f, q) ((1.0 + BIQUAD_COS(f)) / 2.0)
+
+#define BIQUAD_PASO_BAJO_B0(f, q) ((1.0 - BIQUAD_COS(f)) / 2.0)
+#define BIQUAD_PASO_BAJO_B1(f, q) (1.0 - BIQUAD_COS(f))
+#define BIQUAD_PASO_BAJO_B2(f, q) ((1.0 - BIQUAD_COS(f)) / 2.0)
+
+/// Coeficientes normalizados {b0, b1, b2, a1, a2} (orden de ESP-DSP) escalados por `escala`.
+#define BIQUAD_COEFICIENTES(tipo, f, q, escala, conv)       \
+  {conv(tipo##_B0(f, q) / BIQUAD_A0(f, q) * (escala)),     \
+   conv(tipo##_B1(f, q) / BIQUAD_A0(f, q) * (escala)),     \
+   conv(tipo##_B2(f, q) / BIQUAD_A0(f, q) * (escala)),     \
+   conv(BIQUAD_A1(f, q) / BIQUAD_A0(f, q) * (escala)),     \
+   conv(BIQUAD_A2(f, q) / BIQUAD_A0(f, q) * (escala))},
+
+#define BIQUAD_A_FLOAT(v) ((float)(v))
+#define BIQUAD_A_Q28(v) ((int32_t)((v) < 0 ? (v) - 0.5 : (v) + 0.5))
+#define BIQUAD_CONTAR(tipo, f, q) +1
+#define BIQUAD_ETAPA_FLOAT(tipo, f, q) BIQUAD_COEFICIENTES(tipo, f, q, 1.0, BIQUAD_A_FLOAT)
+#define BIQUAD_ETAPA_Q28(tipo, f, q) BIQUAD_COEFICIENTES(tipo, f, q, (double)(1 << 28), BIQUAD_A_Q28)
+
+#define FILTRO_EMG_NUM_ETAPAS (0 FILTRO_EMG_ETAPAS(BIQUAD_CONTAR)) ///< Número de biquads de la cascada.
+
+_Static_assert(FILTRO_EMG_NUM_ETAPAS > 0, "La cascada del filtro EMG necesita al menos una etapa");
+
+// ==========================
+//   Estado del filtro
+// ==========================
+
+#if FILTRO_EMG_PUNTO_FIJO
+static const int32_t filtroCoeficientes[FILTRO_EMG_NUM_ETAPAS][5] = {FILTRO_EMG_ETAPAS(BIQUAD_ETAPA_Q28)}; ///< Coeficientes Q28.
+int64_t filtroEstado[NUMERO_CANALES_EMG][FILTRO_EMG_NUM_ETAPAS][2]; ///< Estado s1, s2 de cada biquad de cada canal (Q28).
+#else
+static const float filtroCoeficientes[FILTRO_EMG_NUM_ETAPAS][5] = {FILTRO_EMG_ETAPAS(BIQUAD_ETAPA_FLOAT)}; ///< Coeficientes en coma flotante.
+float filtroEstado[NUMERO_CANALES_EMG][FILTRO_EMG_NUM_ETAPAS][2]; ///< Estado de cada biquad de cada canal (s1, s2, o w1, w2 con ESP-DSP).
+float filtroTrabajo[CIRCULAR_ARRAY_SIZE];                          ///< Bloque intermedio en coma flotante.
+#endif
+
+/**
+ * @brief Pone a cero el estado de todos los biquads de todos los canales.
+ */
+void filtro_reiniciar()
+{
+  memset(filtroEstado, 0, sizeof(filtroEstado));
+}
+
+/**
+ * @brief Satura un valor al rango de `int16_t`.
+ */
+static inline int16_t filtro_saturar(int32_t v)
+{
+  if (v > INT16_MAX)
+  {
+    return INT16_MAX;
+  }
+  if (v < INT16_MIN)
+  {
+    return INT16_MIN;
+  }
+  return (int16_t)v;
+}
+
+#if FILTRO_EMG_PUNTO_FIJO
+
+/**
+ * @brief Filtra un bloque completo de todos los canales por la cascada (variante en punto fijo).
+ * @param entrada Muestras crudas del ADC, una fila por canal (@ref Indice_Canal_EMG).
+ * @param salida Muestras filtradas, con la misma disposición que `entrada`.
+ * @param n Número de muestras de cada canal.
+ * @param paso Distancia, en muestras, entre las filas de dos canales consecutivos.
+ */
+void filtro_procesar_bloque(const uint16_t *entrada, muestra_emg_t *salida, uint32_t n, uint32_t paso)
+{
+  for (uint32_t canal = 0; canal < NUMERO_CANALES_EMG; canal++)
+  {
+    const uint16_t *x_canal = &entrada[canal * paso];
+    muestra_emg_t *y_canal = &salida[canal * paso];
+    for (uint32_t i = 0; i < n; i++)
+    {
+      // Entre etapas la señal lleva FILTRO_EMG_BITS_FRACCION bits fraccionarios para que el
+      // redondeo no se realimente a través de los polos del paso alto
+      int32_t x = ((int32_t)x_canal[i] - FILTRO_EMG_OFFSET_ADC) * (1 << FILTRO_EMG_BITS_FRACCION);
+      for (int e = 0; e < FILTRO_EMG_NUM_ETAPAS; e++)
+      {
+        const int32_t *c = filtroCoeficientes[e];
+        int64_t *s = filtroEstado[canal][e];
+        // Forma directa II transpuesta: y = b0·x + s1; s1 = b1·x - a1·y + s2; s2 = b2·x - a2·y
+        int64_t acumulado = (int64_t)c[0] * x + s[0];
+        int32_t y = (int32_t)((acumulado + (1 << 27)) >> 28);
+        s[0] = (int64_t)c[1] * x - (int64_t)c[3] * y + s[1];
+        s[1] = (int64_t)c[2] * x - (int64_t)c[4] * y;
+        x = y;
+      }
+#if EMG_MUESTRA_FLOAT
+      y_canal[i] = (float)x / (1 << FILTRO_EMG_BITS_FRACCION);
+#else
+      y_canal[i] = filtro_saturar((x + (1 << (FILTRO_EMG_BITS_FRACCION - 1))) >> FILTRO_EMG_BITS_FRACCION);
+#endif
+    }
+  }
+}
+
+#else
+
+/**
+ * @brief Filtra un bloque completo de todos los canales por la cascada (variante en coma flotante).
+ * @param entrada Muestras crudas del ADC, una fila por canal (@ref Indice_Canal_EMG).
+ * @param salida Muestras filtradas, con la misma disposición que `entrada`.
+ * @param n Número de muestras de cada canal.
+ * @param paso Distancia, en muestras, entre las filas de dos canales consecutivos.
+ * @details Cada etapa recorre la fila entera de un canal antes de pasar a la siguiente, que es el
+ * patrón que aprovecha la implementación vectorizada de ESP-DSP.
+ */
+void filtro_procesar_bloque(const uint16_t *entrada, muestra_emg_t *salida, uint32_t n, uint32_t paso)
+{
+  for (uint32_t canal = 0; canal < NUMERO_CANALES_EMG; canal++)
+  {
+    const uint16_t *x_canal = &entrada[canal * paso];
+    muestra_emg_t *y_canal = &salida[canal * paso];
+    for (uint32_t inicio = 0; inicio < n; inicio += CIRCULAR_ARRAY_SIZE)
+    {
+      uint32_t m = (n - inicio < CIRCULAR_ARRAY_SIZE) ? n - inicio : CIRCULAR_ARRAY_SIZE;
+
+      for (uint32_t i = 0; i < m; i++)
+      {
+        filtroTrabajo[i] = (float)((int32_t)x_canal[inicio + i] - FILTRO_EMG_OFFSET_ADC);
+      }
+
+      for (int e = 0; e < FILTRO_EMG_NUM_ETAPAS; e++)
+      {
+#if FILTRO_EMG_ESP_DSP
+        dsps_biquad_f32(filtroTrabajo, filtroTrabajo, m, (float *)filtroCoeficientes[e], filtroEstado[canal][e]);
+#else
+        const float *c = filtroCoeficientes[e];
+        float *s = filtroEstado[canal][e];
+        for (uint32_t i = 0; i < m; i++)
+        {
+          // Forma directa II transpuesta
+          float x = filtroTrabajo[i];
+          float y = c[0] * x + s[0];
+          s[0] = c[1] * x - c[3] * y + s[1];
+          s[1] = c[2] * x - c[4] * y;
+          filtroTrabajo[i] = y;
+        }
+#endif
+      }
+
+      for (uint32_t i = 0; i < m; i++)
+      {
+        float y = filtroTrabajo[i];
+#if EMG_MUESTRA_FLOAT
+        y_canal[inicio + i] = y;
+#else
+        y_canal[inicio + i] = filtro_saturar((int32_t)(y < 0 ? y - 0.5f : y + 0.5f));
+#endif
+      }
+    }
+  }
+}
+
+#endif
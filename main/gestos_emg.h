@@ -0,0 +1,204 @@
+/**
+ * @file gestos_emg.h
+ * @brief Decodificador de gestos: convierte los flancos de la activación EMG en órdenes para la máquina de estados.
+ * @details
+ * En cada salto de la ventana deslizante (@ref SALTO_VENTANA muestras) @ref tareas_decidir pasa a
+ * @ref gestos_actualizar la salida del comparador con histéresis (@ref resultDeteccion, ver los
+ * umbrales `umbral_act_*` / `umbral_des_*` de @ref parametros.h) y el instante de la última muestra del salto. La duración
+ * de cada activación se mide así con la resolución de un salto, no de un bloque.
+ *
+ * Gestos reconocidos (@ref Tipo_Gesto):
+ * - Pulso largo: se notifica en el mismo salto en que la activación cumple
+ *   @ref GESTO_PULSO_LARGO_MS, sin esperar a que termine.
+ * - Pulso corto: activación de entre @ref GESTO_PULSO_MINIMO_MS y @ref GESTO_PULSO_LARGO_MS. Se
+ *   notifica cuando pasan @ref GESTO_DOBLE_MS sin un segundo pulso, o en el salto en que termina
+ *   si @ref GESTO_DOBLE_MS es `0`.
+ * - Pulso doble: dos pulsos cortos separados como mucho @ref GESTO_DOBLE_MS. Se notifica en el
+ *   salto en que termina el segundo.
+ *
+ * Las activaciones más cortas que @ref GESTO_PULSO_MINIMO_MS se descartan. Cada gesto se envía a
+ * @ref colaGestos sin esperar; la tarea de control los recoge con @ref gestos_recibir y los aplica
+ * a @ref estado_protesis con @ref gestos_aplicar antes de mover los motores.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "globales.h"
+#include "maquina_de_estados_protesis.h"
+
+#define GESTOS_COLA_LONGITUD 8 ///< Gestos que caben en @ref colaGestos sin que la tarea de control los haya recogido.
+
+_Static_assert(GESTO_PULSO_MINIMO_MS < GESTO_PULSO_LARGO_MS, "GESTO_PULSO_MINIMO_MS debe ser menor que GESTO_PULSO_LARGO_MS");
+
+/**
+ * @enum Tipo_Gesto
+ * @brief Gesto reconocido. Los valores son los de @ref estadoPulso.
+ */
+enum Tipo_Gesto
+{
+  GESTO_NINGUNO,     ///< Sin gesto.
+  GESTO_PULSO_CORTO, ///< Una activación corta.
+  GESTO_PULSO_LARGO, ///< Una activación de al menos @ref GESTO_PULSO_LARGO_MS.
+  GESTO_PULSO_DOBLE  ///< Dos activaciones cortas seguidas.
+};
+
+/**
+ * @struct evento_gesto
+ * @brief Gesto enviado a @ref colaGestos.
+ */
+struct evento_gesto
+{
+  int64_t instanteUs;  ///< Instante (µs, reloj de `esp_timer`) de la muestra del salto en que se ha reconocido.
+  uint32_t duracionUs; ///< Duración de la activación: la del segundo pulso en el doble, y la cumplida al reconocerlo en el largo.
+  uint8_t tipo;        ///< @ref Tipo_Gesto.
+};
+
+/**
+ * @struct decodificador_gestos
+ * @brief Estado del decodificador entre saltos.
+ */
+struct decodificador_gestos
+{
+  bool activo;              ///< Salida del comparador en el salto anterior.
+  bool largoEmitido;        ///< La activación en curso ya se ha notificado como pulso largo.
+  bool cortoPendiente;      ///< Hay un pulso corto terminado a la espera de un posible segundo pulso.
+  int64_t inicioUs;         ///< Inicio de la activación en curso.
+  int64_t finCortoUs;       ///< Fin del pulso corto pendiente.
+  uint32_t duracionCortoUs; ///< Duración del pulso corto pendiente.
+};
+
+QueueHandle_t colaGestos = NULL;                  ///< Gestos del decodificador a la máquina de estados (@ref evento_gesto).
+struct decodificador_gestos decodificadorGestos;  ///< Estado del decodificador, solo en la tarea de control.
+volatile uint32_t gestosPerdidos = 0;             ///< Gestos descartados por tener @ref colaGestos llena (o sin crear).
+
+/**
+ * @brief Crea @ref colaGestos y deja el decodificador en reposo.
+ * @return `ESP_OK`, o `ESP_ERR_NO_MEM` si no se ha podido crear la cola.
+ */
+esp_err_t gestos_iniciar()
+{
+  memset(&decodificadorGestos, 0, sizeof(decodificadorGestos));
+  if (colaGestos == NULL)
+  {
+    colaGestos = xQueueCreate(GESTOS_COLA_LONGITUD, sizeof(struct evento_gesto));
+  }
+  return colaGestos != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+/**
+ * @brief Envía un gesto a @ref colaGestos sin esperar; si no cabe queda contado en @ref gestosPerdidos.
+ */
+static void gestos_emitir(enum Tipo_Gesto tipo, uint32_t duracionUs, int64_t instanteUs)
+{
+  struct evento_gesto e = {instanteUs, duracionUs, (uint8_t)tipo};
+  if (colaGestos == NULL || xQueueSend(colaGestos, &e, 0) != pdPASS)
+  {
+    gestosPerdidos++;
+  }
+}
+
+/**
+ * @brief Avanza el decodificador un salto de la ventana.
+ * @param activo Salida del comparador con histéresis en este salto.
+ * @param ahoraUs Instante (µs) de la última muestra del salto.
+ */
+void gestos_actualizar(bool activo, int64_t ahoraUs)
+{
+  struct decodificador_gestos *d = &decodificadorGestos;
+
+  if (activo && !d->activo)
+  {
+    d->inicioUs = ahoraUs;
+    d->largoEmitido = false;
+  }
+  else if (activo)
+  {
+    uint32_t duracion = (uint32_t)(ahoraUs - d->inicioUs);
+    if (!d->largoEmitido && duracion >= GESTO_PULSO_LARGO_MS * 1000u)
+    {
+      // El corto anterior ya no puede formar un doble: sale primero, en su orden
+      if (d->cortoPendiente)
+      {
+        gestos_emitir(GESTO_PULSO_CORTO, d->duracionCortoUs, ahoraUs);
+        d->cortoPendiente = false;
+      }
+      gestos_emitir(GESTO_PULSO_LARGO, duracion, ahoraUs);
+      d->largoEmitido = true;
+    }
+  }
+  else if (d->activo)
+  {
+    uint32_t duracion = (uint32_t)(ahoraUs - d->inicioUs);
+    if (!d->largoEmitido && duracion >= GESTO_PULSO_MINIMO_MS * 1000u)
+    {
+      if (d->cortoPendiente)
+      {
+        gestos_emitir(GESTO_PULSO_DOBLE, duracion, ahoraUs);
+        d->cortoPendiente = false;
+      }
+      else if (GESTO_DOBLE_MS == 0)
+      {
+        gestos_emitir(GESTO_PULSO_CORTO, duracion, ahoraUs);
+      }
+      else
+      {
+        d->cortoPendiente = true;
+        d->finCortoUs = ahoraUs;
+        d->duracionCortoUs = duracion;
+      }
+    }
+  }
+  else if (d->cortoPendiente && ahoraUs - d->finCortoUs > GESTO_DOBLE_MS * 1000)
+  {
+    gestos_emitir(GESTO_PULSO_CORTO, d->duracionCortoUs, ahoraUs);
+    d->cortoPendiente = false;
+  }
+  d->activo = activo;
+}
+
+/**
+ * @brief Recoge, sin esperar, el gesto más antiguo de @ref colaGestos.
+ * @return `true` si había un gesto y se ha copiado en `e`.
+ */
+static inline bool gestos_recibir(struct evento_gesto *e)
+{
+  return colaGestos != NULL && xQueueReceive(colaGestos, e, 0) == pdPASS;
+}
+
+/**
+ * @brief Aplica un gesto a @ref estado_protesis y lo deja en @ref estadoPulso.
+ * @details Solo en @ref ESTADO_NORMAL; en los demás estados las fases las llevan la calibración
+ * o la propia tabla y el gesto solo se anota:
+ * - Pulso corto: alterna entre cerrar (@ref FASE_PASO_2) y abrir (@ref FASE_PASO_1).
+ * - Pulso largo: abrir, suelta lo que haya agarrado.
+ * - Pulso doble: pausa, los motores se paran donde estén.
+ */
+void gestos_aplicar(const struct evento_gesto *e)
+{
+  estadoPulso = e->tipo;
+  if (estado_protesis.estado_actual != ESTADO_NORMAL)
+  {
+    return;
+  }
+
+  switch (e->tipo)
+  {
+  case GESTO_PULSO_CORTO:
+    maquina_cambiarFase(&estado_protesis, estado_protesis.fase_actual == FASE_PASO_2 ? FASE_PASO_1 : FASE_PASO_2);
+    break;
+  case GESTO_PULSO_LARGO:
+    maquina_cambiarFase(&estado_protesis, FASE_PASO_1);
+    break;
+  case GESTO_PULSO_DOBLE:
+    maquina_cambiarFase(&estado_protesis, FASE_PAUSA);
+    break;
+  default:
+    break;
+  }
+}
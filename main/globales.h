@@ -6,7 +6,6 @@
  * - Configuración general de hardware y parámetros del sistema.
  * - Definiciones de pines para sensores, motor, y LEDs.
  * - Variables globales compartidas entre módulos.
- * - Funciones de registro para depuración y análisis.
  */
 
  #pragma once
@@ -14,6 +13,7 @@
  // ==========================
  //       Librerías
  // ==========================
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
@@ -28,11 +28,55 @@
  #define TIMER_FREQ 1000000 ///< Frecuencia base del temporizador por hardware en Hz (1 MHz = resolución de 1 µs).
  #define SAMPLING_FREQ 2000 ///< Frecuencia de muestreo de la señal EMG en Hz.
  #define CIRCULAR_ARRAY_SIZE 50 ///< Tamaño de los buffers circulares para almacenamiento de muestras EMG.
- #define POSICION_MAXIMA_MOTOR 4230 ///< Posición máxima permitida para el motor (unidad: pasos del encoder).
+ #define ENCODER_PCNT 1 ///< Decodificación del encoder: `1` = cuadratura x4 por hardware (PCNT), `0` = ISR software x2 sobre @ref encoderAPin.
+ #define ENCODER_FILTRO_GLITCH_NS 1000 ///< Pulsos del encoder más cortos que este valor (ns) se descartan por hardware (solo PCNT).
+ #define ENCODER_PASOS_POR_CICLO (ENCODER_PCNT ? 4 : 2) ///< Pasos contados por cada ciclo de cuadratura según el modo de decodificación.
+ #define POSICION_MAXIMA_MOTOR (2115 * ENCODER_PASOS_POR_CICLO) ///< Tope mecánico del motor (unidad: pasos del encoder). El cierre en uso es el parámetro `posicion_maxima` (ver @ref PARAMETROS_AJUSTABLES).
  #define POSICION_MINIMA_MOTOR 0    ///< Posición mínima permitida para el motor (unidad: pasos del encoder).
- #define VELOCIDAD_MOTOR 80 ///< Velocidad base del motor (% de PWM, 0 = parado, 100 = máxima velocidad).
+ #define VELOCIDAD_MOTOR 80 ///< Velocidad base del motor al arrancar (% de PWM, 0 = parado, 100 = máxima velocidad). Ajustable en marcha (`velocidad`).
+ #define VELOCIDAD_CALIBRACION_MOTOR 50 ///< Velocidad del motor en los estados de calibración al arrancar (% de PWM). Ajustable en marcha (`velocidad_calibracion`).
+ #define CONTROL_MOTOR_PERFIL 1 ///< Apertura y cierre: `1` = perfil trapezoidal en lazo cerrado (PI + feed-forward), `0` = todo o nada hasta el objetivo.
+ #define VELOCIDAD_MAXIMA_MOTOR 9000.0f ///< Velocidad del motor con el duty máximo (pasos/s). Base del feed-forward, a ajustar sobre el hardware.
+ #define ACELERACION_MOTOR 40000.0f ///< Aceleración máxima de los perfiles de movimiento (pasos/s²).
+ #define MOTOR_PID_KP 0.002f ///< Ganancia proporcional del lazo de posición (fracción del duty máximo por paso de error).
+ #define MOTOR_PID_KI 0.02f ///< Ganancia integral del lazo de posición (fracción del duty máximo por paso·s de error).
+ #define MOTOR_PID_KV 0.00002f ///< Ganancia sobre el error de velocidad respecto al perfil (fracción del duty máximo por paso/s), amortigua el seguimiento.
+ #define TOLERANCIA_POSICION_MOTOR 4 ///< Error de posición (pasos) con el que se da por alcanzado el objetivo de un perfil.
+ #define CORRIENTE_MOTOR_MV_POR_AMPERIO 500.0f ///< Ganancia de la salida de medida de corriente del driver (mV/A).
+ #define CORRIENTE_AGARRE_MOTOR 0.8f ///< Corriente (A) a partir de la cual un cierre sin avance se considera agarre.
+ #define VELOCIDAD_AGARRE_MOTOR 200.0f ///< Velocidad (pasos/s) por debajo de la cual el motor se considera detenido.
+ #define TIEMPO_ARRANQUE_AGARRE_MS 60 ///< Tiempo desde el inicio del cierre en que no se evalúa el agarre (pico de arranque).
+ #define TIEMPO_CONFIRMACION_AGARRE_MS 20 ///< Tiempo que debe mantenerse la condición de bloqueo para confirmar el agarre.
+ #define TIEMPO_CONFIRMACION_AGARRE_SIN_CORRIENTE_MS 80 ///< Confirmación del agarre cuando solo se dispone de la velocidad.
+ #define DUTY_SUJECION_MOTOR 20 ///< Duty de sujeción tras detectar el agarre (% de PWM).
  #define MICROSECONDS_TO_TICKS(us) ((us) / (1000000 / configTICK_RATE_HZ)) ///< Conversión de microsegundos a ticks del sistema FreeRTOS.
  #define NUMERO_CARACTERISTICAS 3 ///< Número de características EMG calculadas por cada ventana de datos.
+ #define CARACTERISTICAS_SIMD 1 ///< Cálculo de características: `1` = kernel vectorial PIE (solo ESP32-S3), `0` = referencia escalar.
+ #define FILTRO_EMG_PUNTO_FIJO 0 ///< Prefiltrado EMG: `1` = biquads en punto fijo (Q28), `0` = coma flotante (ESP-DSP si está disponible).
+#ifndef EMG_MUESTRA_FLOAT
+ #define EMG_MUESTRA_FLOAT 0 ///< Tipo de la señal filtrada del filtro a los umbrales (@ref muestra_emg_t): `0` = `int16_t` con sumas enteras, `1` = `float` de referencia. El host compila las dos.
+#endif
+ #define BENCHMARK_CARACTERISTICAS 0 ///< `1` = medir al arrancar los ciclos por ventana del cálculo de características.
+ #define INFERENCIA_SIMD 1 ///< Inferencia int8: `1` = kernel vectorial PIE (solo ESP32-S3), `0` = referencia escalar.
+ #define INFERENCIA_PRESUPUESTO_US 100 ///< Tiempo máximo por inferencia (µs), un 4 % de cada salto de ventana de 2,5 ms.
+ #define INFERENCIA_PRESUPUESTO_CICLOS (INFERENCIA_PRESUPUESTO_US * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ) ///< Ciclos de CPU máximos por inferencia a la frecuencia de `sdkconfig` (16000 a 160 MHz).
+ #define DETECCION_INFERENCIA 0 ///< Decisión de activación: `1` = salida de la red (@ref result), `0` = umbrales por característica.
+ #define UMBRAL_INFERENCIA 0.5f ///< Probabilidad de @ref result a partir de la cual se considera activación (con @ref DETECCION_INFERENCIA), al arrancar. Ajustable en marcha (`umbral_inferencia`).
+ #define BENCHMARK_INFERENCIA 0 ///< `1` = medir al arrancar los ciclos por inferencia frente a @ref INFERENCIA_PRESUPUESTO_CICLOS.
+ #define GESTO_PULSO_MINIMO_MS 50 ///< Activaciones más cortas (ms) se descartan como artefactos (ver gestos_emg.h).
+ #define GESTO_PULSO_LARGO_MS 600 ///< Duración (ms) a partir de la cual una activación es un pulso largo; se notifica al cumplirla.
+ #define GESTO_DOBLE_MS 300 ///< Separación máxima (ms) entre dos pulsos cortos para formar un pulso doble (`0` = sin pulso doble).
+ #define ESPECTRO_EMG 1 ///< `1` = características espectrales en @ref NUCLEO_ADQUISICION (ver espectro_emg.h) como entradas de la red, `0` = solo temporales.
+ #define PERFILADO 1 ///< `1` = sondas de ciclos por etapa con histogramas y comando `perf` (ver perfilado.h), `0` = sin sondas.
+ #define LATENCIA_EXTREMO 0 ///< `1` = medir la latencia de cada orden desde la muestra EMG que la produce hasta el PWM (ver latencia.h). Requiere @ref PERFILADO.
+ #define LATENCIA_GPIO 1 ///< Con @ref LATENCIA_EXTREMO: `1` = @ref latenciaPin alto desde la decisión hasta la escritura del PWM, para el osciloscopio.
+ #define PLAZOS_VIGILANCIA 1 ///< `1` = plazos por etapa del procesado, contadores de incumplimientos y degradación ante sobrecarga (ver plazos.h), `0` = sin vigilancia.
+ #define DEGRADAR_ESPECTRO 0x1 ///< Política de sobrecarga: dejar de enviar bloques a la etapa espectral (la red, si decide, recibe ceros en sus entradas espectrales).
+ #define DEGRADAR_SALTO 0x2 ///< Política de sobrecarga: decidir solo en uno de cada dos saltos de la ventana (salto efectivo de 2·@ref SALTO_VENTANA).
+ #define DEGRADAR_SEGURIDAD 0x4 ///< Política de sobrecarga: abrir y parar la prótesis (@ref ESTADO_SEGURIDAD) hasta recuperar los plazos.
+ #define PLAZOS_DEGRADACION (DEGRADAR_ESPECTRO | DEGRADAR_SALTO | DEGRADAR_SEGURIDAD) ///< Políticas permitidas, aplicadas en este orden al acumularse incumplimientos (`0` = solo contar).
+ #define PLAZOS_FALLOS_DEGRADAR 3 ///< Incumplimientos seguidos (bloques o periodos perdidos incluidos) que suben un nivel de degradación.
+ #define PLAZOS_BLOQUES_RECUPERAR 200 ///< Bloques seguidos a tiempo (5 s con bloques de 25 ms) que bajan un nivel de degradación.
  
  // ==========================
  //   Frecuencia de tareas
@@ -41,20 +85,50 @@
  /**
   * @brief Frecuencia de ejecución de las tareas posteriores al muestreo.
   * @details 
-  * - Determina cada cuántas muestras se activa el flag `completedBufferFlag`.
+  * - Determina cada cuántas muestras se entrega un bloque al procesado (ver @ref anillo_bloques.h).
   * @warning Debe ser un divisor de @ref CIRCULAR_ARRAY_SIZE para evitar desfases.
   */
  #define FREC_EJ_TAREAS_POST_TOMA_DATOS (CIRCULAR_ARRAY_SIZE / 1)
+
+ /**
+  * @brief Frecuencia del bucle de control en Hz.
+  * @details
+  * - Un temporizador por hardware (gptimer) despierta a la tarea de control con una notificación en cada periodo,
+  *   sin depender del tick de FreeRTOS (`CONFIG_FREERTOS_HZ` = 100 no permite periodos por debajo de 10 ms).
+  * - En cada periodo se consumen los bloques filtrados pendientes y se ejecuta `activacionMotores()`.
+  */
+ #define FREC_BUCLE_CONTROL 1000
+
+ #define NUCLEO_ADQUISICION 0 ///< Núcleo de la tarea de adquisición y filtrado (@ref task_core0).
+ #define NUCLEO_CONTROL 1 ///< Núcleo de la tarea de características, decisión y motores (@ref task_core1).
+ #define PRIORIDAD_ADQUISICION (configMAX_PRIORITIES - 2) ///< Prioridad de la tarea de adquisición y filtrado.
+ #define PRIORIDAD_CONTROL (configMAX_PRIORITIES - 2) ///< Prioridad de la tarea de control.
+
+ /**
+  * @brief Salto (en muestras) entre dos cálculos de características de la ventana deslizante.
+  * @details
+  * - La ventana de @ref CIRCULAR_ARRAY_SIZE muestras se actualiza de forma incremental (ver @ref ventana_deslizante.h),
+  *   así que el coste por salto es proporcional al salto y no al tamaño de la ventana.
+  * - Con @ref SAMPLING_FREQ = 2000 Hz, un salto de 5 muestras da una decisión cada 2,5 ms.
+  */
+ #define SALTO_VENTANA 5
  
  // ==========================
  //   Calibración
  // ==========================
  
  /**
-  * @brief Número total de arrays de características que se almacenan durante la calibración de umbrales.
-  * @details Se usa para calcular umbrales de activación y desactivación basados en la media.
+  * @brief Saltos de ventana máximos de cada fase de medida de la calibración de umbrales.
+  * @details La calibración es en línea (ver @ref calibracion_umbrales.h) y normalmente termina antes,
+  * en cuanto las medias convergen. Con un salto de 2,5 ms, 2400 saltos son 6 s.
   */
- #define NUMERO_TOTAL_ARRAYS_CALIBRACION_UMBRALES 300
+ #define CALIBRACION_VENTANAS_MAXIMAS 2400
+ #define CALIBRACION_VENTANAS_MINIMAS 400 ///< Saltos mínimos de cada fase de medida (1 s, unas 20 ventanas completas).
+ #define CALIBRACION_TOLERANCIA_RELATIVA 0.02f ///< Error estándar de la media, relativo a la media, con el que una fase se da por convergida.
+ #define CALIBRACION_PAUSA_MS 2000 ///< Duración de las pausas entre fases de la calibración de umbrales.
+ #define CALIBRACION_PERCENTIL_REPOSO 0.95f ///< Percentil de las características en reposo que se usa como umbral de desactivación.
+ #define CALIBRACION_DESVIACIONES_REPOSO 3.0f ///< Desviaciones típicas sobre la media de reposo que, como mínimo, tiene el umbral de desactivación.
+ #define CALIBRACION_FRACCION_ACTIVACION 0.5f ///< Posición del umbral de activación entre la media de reposo (0) y la de contracción (1).
  
  // ==========================
  //   LEDs indicadores
@@ -68,16 +142,17 @@
  // ==========================
  
  /**
-  * @brief Velocidad del motor ajustada según @ref VELOCIDAD_MOTOR.
-  * @details Conversión de porcentaje a valor PWM real (0–255).
+  * @brief Velocidad del motor ajustada según el parámetro `velocidad` (o `velocidad_calibracion`).
+  * @details Porcentaje convertido a duty del PWM (0–`MOTORES_DUTY_MAX`, ver motores.h). Lo calcula
+  * @ref activacionMotores al empezar cada ciclo.
   */
- float velocidad_motor_procesada = 2.55 * VELOCIDAD_MOTOR;
+ float velocidad_motor_procesada = 0;
  
  // ==========================
  //  Manejadores de tareas
  // ==========================
- TaskHandle_t task_core0 = NULL; ///< Tarea principal en core 0.
- TaskHandle_t task_core1 = NULL; ///< Tarea principal en core 1.
+ TaskHandle_t task_core0 = NULL; ///< Tarea de adquisición y filtrado (ver @ref NUCLEO_ADQUISICION).
+ TaskHandle_t task_core1 = NULL; ///< Tarea del bucle de control (ver @ref NUCLEO_CONTROL).
  
  // ==========================
  //   Definición de pines
@@ -91,43 +166,110 @@
  #define bluePin_2 21  ///< Pin PWM salida LED 2 azul.
  #define botonPin 10   ///< Pin de entrada para botón físico de seguridad.
  #define bateriaPin 4  ///< Pin ADC para medición de nivel de batería.
- #define EMGPin 15     ///< Pin ADC para lectura de señal EMG.
+ #define EMGPin 15     ///< Pin ADC para lectura de señal EMG (electrodo principal).
  #define encoderAPin 38 ///< Pin entrada canal A del encoder rotativo.
  #define encoderBPin 37 ///< Pin entrada canal B del encoder rotativo.
  #define motorEnabePWMPin 14 ///< Pin PWM para control de velocidad del motor.
  #define motorPhasePin 27    ///< Pin digital para control de dirección del motor.
  #define motorSleepPin 26    ///< Pin digital para control de estado (SLEEP/ON) del driver de motor.
+ #define corrienteMotorPin 6 ///< Pin ADC conectado a la salida de medida de corriente del driver de motor.
+ #define latenciaPin 47      ///< Pin de depuración de la medida de latencia (ver @ref LATENCIA_GPIO).
  
- // ==========================
- // Variables motor
- // ==========================
- bool motorArrived; ///< Flag: `true` si el motor está en posición objetivo o límite, `false` en movimiento.
- uint16_t posicionMotor; ///< Posición actual del motor (en pasos de encoder).
+ /**
+  * @brief Actuadores del banco de motores (ver banco_motores.h), en orden:
+  * `MOTOR(id, encoderA, encoderB, pwm, fase, sleep, canalLedc, minima, maxima)`.
+  * @details Todos siguen la misma orden de apertura o cierre. El primero es el motor principal:
+  * el que tiene la medida de corriente (@ref corrienteMotorPin), el que detecta el agarre y el que
+  * publica @ref posicionMotor y @ref velocidadMotor. Para añadir un dedo basta con una línea más.
+  */
+ #define MOTORES_BANCO(MOTOR) \
+   MOTOR(MOTOR_PRINCIPAL, encoderAPin, encoderBPin, motorEnabePWMPin, motorPhasePin, motorSleepPin, LEDC_CHANNEL_0, POSICION_MINIMA_MOTOR, POSICION_MAXIMA_MOTOR)
  
+ /**
+  * @brief Electrodos EMG muestreados (ver muestreo_emg.h), en orden: `CANAL(id, pin)`.
+  * @details El ADC los recorre en este orden en un único flujo DMA, cada uno a @ref SAMPLING_FREQ, así
+  * que todos deben pertenecer a la misma unidad ADC. El primero es el canal principal: el que usan
+  * los umbrales, su calibración y @ref MAVEMG, @ref VarianzaEMG y @ref WLEMG. La red de
+  * inferencia recibe las características de todos. Para añadir un electrodo basta con una línea más.
+  */
+ #define CANALES_EMG(CANAL) \
+   CANAL(CANAL_EMG_PRINCIPAL, EMGPin)
+
+ /**
+  * @brief Parámetros que se pueden cambiar en marcha sin recompilar (ver parametros.h), en orden:
+  * `PARAMETRO(campo, nombre, inicial, minimo, maximo, descripcion)`.
+  * @details `nombre` es el del comando `param`. Los umbrales iniciales no activan nunca: hasta la
+  * calibración (o hasta restaurarla de NVS) la prótesis no responde a la señal.
+  */
+ #define PARAMETROS_AJUSTABLES(PARAMETRO) \
+   PARAMETRO(umbralActMAV, "umbral_act_mav", 5000000.0f, 0.0f, 1e12f, "Umbral de activación MAV") \
+   PARAMETRO(umbralDesMAV, "umbral_des_mav", 0.0f, 0.0f, 1e12f, "Umbral de desactivación MAV") \
+   PARAMETRO(umbralActVar, "umbral_act_var", 5000000.0f, 0.0f, 1e12f, "Umbral de activación de la varianza") \
+   PARAMETRO(umbralDesVar, "umbral_des_var", 0.0f, 0.0f, 1e12f, "Umbral de desactivación de la varianza") \
+   PARAMETRO(umbralActWL, "umbral_act_wl", 5000000.0f, 0.0f, 1e12f, "Umbral de activación WL") \
+   PARAMETRO(umbralDesWL, "umbral_des_wl", 0.0f, 0.0f, 1e12f, "Umbral de desactivación WL") \
+   PARAMETRO(umbralInferencia, "umbral_inferencia", UMBRAL_INFERENCIA, 0.0f, 1.0f, "Probabilidad de activación de la red") \
+   PARAMETRO(velocidadMotor, "velocidad", VELOCIDAD_MOTOR, 0.0f, 100.0f, "Velocidad del motor (% de PWM)") \
+   PARAMETRO(velocidadCalibracionMotor, "velocidad_calibracion", VELOCIDAD_CALIBRACION_MOTOR, 0.0f, 100.0f, "Velocidad en calibración (% de PWM)") \
+   PARAMETRO(posicionMaximaMotor, "posicion_maxima", POSICION_MAXIMA_MOTOR, POSICION_MINIMA_MOTOR, POSICION_MAXIMA_MOTOR, "Cierre máximo (pasos del encoder)")
+
+ #define CANAL_EMG_ENUM(id, pin) id,
+
+ /**
+  * @enum Indice_Canal_EMG
+  * @brief Fila de cada canal de @ref CANALES_EMG en los bloques de muestras y en la matriz de características.
+  */
+ enum Indice_Canal_EMG
+ {
+   CANALES_EMG(CANAL_EMG_ENUM)
+   NUMERO_CANALES_EMG
+ };
+
+ _Static_assert(CANAL_EMG_PRINCIPAL == 0, "El canal principal debe ser la primera entrada de CANALES_EMG");
+
+ #define FILA_EMG(n) (((n) + 7u) & ~7u) ///< Longitud de la fila de un canal de `n` muestras, redondeada a 8 muestras (16 bytes de `int16_t`) para el kernel vectorial.
+
+ /**
+  * @brief Muestra de la señal EMG filtrada, de @ref filtro_procesar_bloque a las ventanas y las características.
+  * @details En las dos variantes la unidad es la cuenta del ADC centrada, así que los umbrales y el
+  * modelo valen para ambas sin reescalar:
+  * - `int16_t` (por defecto): valores de ±4095 en un contenedor Q15, con sumas de 32 bits y Σx² de
+  *   64 bits. Son exactas, caben 8 muestras por registro PIE y bloques y ventanas ocupan la mitad.
+  * - `float` (@ref EMG_MUESTRA_FLOAT): sin el redondeo de la salida del filtro y con sumas en
+  *   `double`. Es la referencia con la que compararla en el host.
+  */
+#if EMG_MUESTRA_FLOAT
+ typedef float muestra_emg_t;
+ typedef double acumulador_emg_t;            ///< Σ|x|, Σx y Σ|dx| de una ventana.
+ typedef double acumulador_cuadrados_emg_t;  ///< Σx² de una ventana.
+#else
+ typedef int16_t muestra_emg_t;
+ typedef int32_t acumulador_emg_t;           ///< Σ|x|, Σx y Σ|dx| de una ventana.
+ typedef int64_t acumulador_cuadrados_emg_t; ///< Σx² de una ventana.
+#endif
+
  // ==========================
- //   Sincronización
+ // Variables motor
  // ==========================
-SemaphoreHandle_t semaforoMuestreo; ///< Semáforo para sincronizar ISR de muestreo y procesamiento.
+ bool motorArrived; ///< Flag: `true` si todos los motores están en posición objetivo o límite, `false` en movimiento.
+ uint16_t posicionMotor; ///< Posición actual del motor principal (en pasos de encoder).
+ float corrienteMotor = 0; ///< Corriente del motor filtrada (A), medida mientras cierra (ver agarre_motor.h).
+ float velocidadMotor = 0; ///< Velocidad estimada del motor principal (pasos/s, positiva al cerrar), actualizada en cada ciclo de control.
  
  // ==========================
  // Buffers y datos EMG
  // ==========================
- float copiaDeteccion_buffer[CIRCULAR_ARRAY_SIZE]; ///< Copia temporal de la señal EMG para detección.
- float copiaDeteccion_diff[CIRCULAR_ARRAY_SIZE];   ///< Copia temporal de diferencias de tiempo entre muestras.
- uint16_t diff[CIRCULAR_ARRAY_SIZE];               ///< Diferencias de tiempo (µs) entre muestras.
- uint16_t buffer[CIRCULAR_ARRAY_SIZE];             ///< Buffer circular de muestras EMG crudas.
- float filteredEMG[CIRCULAR_ARRAY_SIZE];           ///< Señal EMG filtrada.
+ muestra_emg_t filteredEMG[NUMERO_CANALES_EMG][FILA_EMG(CIRCULAR_ARRAY_SIZE)] __attribute__((aligned(16))); ///< Ventana de señal EMG filtrada, una fila por canal (filas alineadas para el kernel vectorial). Solo para @ref caracteristicas_actualizar: el control consume los bloques en su hueco de @ref anilloFiltrado.
+ muestra_emg_t ultimaMuestraEMG = 0; ///< Primera muestra del canal principal del último bloque filtrado consumido por el control (la registra la traza).
  
- float result[1]; ///< Resultado de la última capa de la ia.
+ float result[1]; ///< Resultado de la última capa de la ia: probabilidad de activación (0–1), ver @ref inferencia_ejecutar.
  
  // ==========================
  // Variables globales de control
  // ==========================
- int i_muestreo = 0; ///< Índice global del buffer de muestreo.
  uint16_t resultDeteccion = 0; ///< Resultado binario (0/1) de la detección EMG.
- uint8_t estadoPulso = 0; ///< Estado del pulso detectado (0 = ninguno, 1 = corto, 2 = largo).
- uint16_t nivelBateria; ///< Nivel de batería medido.
- bool completedBufferFlag = false; ///< Flag que indica si el buffer está completo y listo para procesar.
+ uint8_t estadoPulso = 0; ///< Último gesto aplicado (0 = ninguno, 1 = corto, 2 = largo, 3 = doble), ver @ref Tipo_Gesto.
+ uint16_t nivelBateria; ///< Tensión medida en el pin de batería (mV), actualizada por la tarea de sensores (ver sensores.h).
  
  // ==========================
  // Características EMG
@@ -135,70 +277,14 @@ SemaphoreHandle_t semaforoMuestreo; ///< Semáforo para sincronizar ISR de muest
  float MAVEMG = 0; ///< Media del valor absoluto (MAV) de la señal EMG actual.
  float VarianzaEMG = 0; ///< Varianza de la señal EMG actual.
  float WLEMG = 0; ///< Longitud de onda (Waveform Length) de la señal EMG actual.
+ float frecuenciaMediaEMG = 0; ///< Frecuencia media (Hz) del espectro del canal principal (con @ref ESPECTRO_EMG). Baja con la fatiga.
+ float frecuenciaMedianaEMG = 0; ///< Frecuencia mediana (Hz) del espectro del canal principal (con @ref ESPECTRO_EMG).
  
- uint16_t MAVActivada = 0; ///< Flag activación MAV.
+ bool MAVActivada = 0; ///< Flag activación MAV.
  bool VarActivada = 0; ///< Flag activación Varianza.
  bool WLActivada = 0; ///< Flag activación WL.
- float umbralActMAV = 5000000.0; ///< Umbral de activación MAV.
- float umbralDesMAV = 0; ///< Umbral de desactivación MAV.
- float umbralActVar = 5000000.0; ///< Umbral de activación Varianza.
- float umbralDesVar = 0; ///< Umbral de desactivación Varianza.
- float umbralActWL = 5000000.0; ///< Umbral de activación WL.
- float umbralDesWL = 0; ///< Umbral de desactivación WL.
  
  // ==========================
  // Estado de la prótesis
  // ==========================
  struct Maquina_de_estados_protesis estado_protesis; ///< Máquina de estados general de la prótesis.
- 
- // ==========================
- // Estructuras de depuración
- // ==========================
- 
- /**
-  * @struct LogMessage
-  * @brief Estructura para almacenar datos de depuración y registro de tareas.
-  * @details Incluye información de core, tiempos, estado, fase, tarea, señal EMG y posición del motor.
-  */
- typedef struct {
-   bool core;                ///< Núcleo de ejecución: 0 o 1.
-   unsigned long tiempo;     ///< Tiempo desde arranque (µs).
-   uint8_t estado;           ///< Estado actual de la prótesis (ver @ref Estado_Protesis).
-   uint8_t fase;             ///< Fase actual (ver @ref Fase_Estado).
-   uint8_t tarea;            ///< ID de la tarea ejecutada.
-   float emgCruda;           ///< Última muestra EMG cruda.
-   uint8_t resDet;           ///< Resultado detección EMG (0/1).
-   uint16_t posMotor;        ///< Posición actual del motor.
- } LogMessage;
- 
- QueueHandle_t logQueue; ///< Cola para almacenar mensajes de tipo LogMessage.
- 
- /**
-  * @brief Envía un registro de tarea a la cola @ref logQueue.
-  * @param tareaID Identificador numérico de la tarea.
-  * @details Incluye en el mensaje: núcleo, tiempo, estado, fase, ID de tarea, valor EMG, resultado de detección y posición del motor.
-  */
- void logTarea(uint8_t tareaID) {
-   static bool inicializacion;
-   static unsigned long boot_time;
- 
-   if (!inicializacion){
-     boot_time = esp_timer_get_time();
-     inicializacion = true;
-   }
- 
-   unsigned long tiempo = esp_timer_get_time() - boot_time;
- 
-   LogMessage msg;
-   msg.core = xPortGetCoreID();
-   msg.tiempo = tiempo;
-   msg.estado = estado_protesis.estado_actual;
-   msg.fase = estado_protesis.fase_actual + 1;
-   msg.tarea = tareaID;
-   msg.emgCruda = filteredEMG[0];
-   msg.resDet = resultDeteccion;
-   msg.posMotor = posicionMotor;
- 
-   xQueueSend(logQueue, &msg, portMAX_DELAY);
- }
- 
\ No newline at end of file
@@ -0,0 +1,346 @@
+/**
+ * @file grabacion_emg.h
+ * @brief Grabación de sesiones EMG crudas en PSRAM y envío en bloques grandes por USB.
+ * @details
+ * Mientras hay una grabación en curso (@ref grabacion_empezar, comando `grabar`), la tarea de
+ * adquisición añade cada bloque crudo de @ref anilloEMG, tal como lo deja la interrupción del ADC
+ * (todas las filas de canal), a un anillo de registros en PSRAM con una sola copia y sin esperar.
+ * Cada registro lleva delante una @ref cabecera_grabacion con el instante del bloque, la
+ * diferencia con el anterior, el estado y la fase, la decisión y la posición del motor.
+ *
+ * La tarea de vaciado (@ref grabacion_tarea_vaciado), de baja prioridad y en
+ * @ref NUCLEO_ADQUISICION para no robar tiempo al bucle de control, escribe los registros por
+ * USB-Serial-JTAG directamente desde el anillo, en tramos contiguos de hasta
+ * @ref GRABACION_REGISTROS_ENVIO registros. Mientras graba, la traza (@ref traza.h) le cede el
+ * enlace (@ref trazaCedida) y sus registros se descartan y quedan contados.
+ *
+ * Si el host no lee a tiempo el anillo se llena y los bloques nuevos se descartan: quedan
+ * contados en `descartados` y se ven en el cable como un salto en `secuencia`. El host se
+ * sincroniza buscando @ref GRABACION_MARCA.
+ *
+ * La grabación se envía en continuo, así que su duración no depende del anillo. El anillo solo
+ * marca cuánto tiempo puede dejar de leer el host sin perder bloques: con PSRAM
+ * (@ref GRABACION_BYTES_PSRAM) son minutos; sin ella, @ref GRABACION_REGISTROS_INTERNA registros.
+ *
+ * @note El `sdkconfig` actual no habilita la PSRAM (`CONFIG_SPIRAM`), así que el anillo va a RAM
+ * interna: @ref GRABACION_REGISTROS_INTERNA bloques, 3,2 s con bloques de 25 ms (unos 18 KB con un
+ * canal, 60 KB con cuatro).
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_console.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "driver/usb_serial_jtag.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "globales.h"
+#include "anillo_bloques.h"
+#include "traza.h"
+
+#define GRABACION_BYTES_PSRAM (4u * 1024 * 1024) ///< Memoria del anillo en PSRAM.
+#define GRABACION_REGISTROS_INTERNA 128           ///< Registros del anillo en RAM interna, si no hay PSRAM. Potencia de 2.
+#define GRABACION_REGISTROS_ENVIO 32             ///< Registros contiguos que la tarea de vaciado envía de una vez, como máximo.
+#define GRABACION_PERIODO_VACIADO_MS 10          ///< Espera de la tarea de vaciado cuando no hay registros.
+#define GRABACION_PRIORIDAD 1                    ///< Prioridad de la tarea de vaciado, junto a la espectral y la traza.
+#define GRABACION_MARCA 0x52474D45u              ///< Primeros 4 bytes de cada registro ("EMGR" en little endian).
+
+/**
+ * @struct cabecera_grabacion
+ * @brief Cabecera de cada registro, seguida de @ref ANILLO_MUESTRAS_HUECO muestras crudas (`uint16_t`).
+ * @details Las muestras van una fila por canal de @ref CANALES_EMG, cada fila de `filaCanal`
+ * muestras de las que solo las `muestrasPorCanal` primeras son datos.
+ */
+struct cabecera_grabacion
+{
+  uint32_t marca;            ///< @ref GRABACION_MARCA.
+  uint32_t secuencia;        ///< Bloques adquiridos desde el inicio de la grabación, grabados o no.
+  int64_t instanteUs;        ///< Instante (µs) en que el bloque llegó a la tarea de adquisición.
+  uint32_t diferenciaUs;     ///< Tiempo desde el bloque anterior (0 en el primero).
+  uint16_t posicionMotor;    ///< @ref posicionMotor.
+  uint16_t muestrasPorCanal; ///< @ref ANILLO_MUESTRAS_POR_BLOQUE.
+  uint16_t filaCanal;        ///< @ref ANILLO_FILA_CANAL.
+  uint8_t canales;           ///< @ref NUMERO_CANALES_EMG.
+  uint8_t estadoFase;        ///< `estado << 4 | fase` de @ref estado_protesis.
+  uint8_t resultDeteccion;   ///< @ref resultDeteccion.
+  uint8_t estadoPulso;       ///< @ref estadoPulso.
+  uint16_t reservado;        ///< A cero.
+};
+
+_Static_assert(sizeof(struct cabecera_grabacion) == 32, "La cabecera de grabación debe ocupar 32 bytes");
+
+#define GRABACION_BYTES_REGISTRO (sizeof(struct cabecera_grabacion) + ANILLO_MUESTRAS_HUECO * sizeof(uint16_t)) ///< Tamaño de un registro.
+
+#define GRABACION_BYTES_INTERNA (GRABACION_REGISTROS_INTERNA * GRABACION_BYTES_REGISTRO) ///< Memoria del anillo en RAM interna.
+
+_Static_assert(GRABACION_BYTES_REGISTRO % 16 == 0, "Los registros deben quedar alineados a 16 bytes");
+_Static_assert((GRABACION_REGISTROS_INTERNA & (GRABACION_REGISTROS_INTERNA - 1)) == 0, "GRABACION_REGISTROS_INTERNA debe ser potencia de 2");
+
+/**
+ * @struct grabacion_emg
+ * @brief Anillo de registros: la tarea de adquisición produce y la de vaciado consume.
+ */
+struct grabacion_emg
+{
+  uint8_t *memoria;                  ///< Registros (PSRAM o RAM interna).
+  uint32_t capacidad;                ///< Registros del anillo. Potencia de 2.
+  bool enPsram;                      ///< `true` si @ref memoria está en PSRAM.
+  atomic_uint_least32_t cabeza;      ///< Registros escritos.
+  atomic_uint_least32_t cola;        ///< Registros enviados.
+  atomic_uint_least32_t descartados; ///< Bloques perdidos por encontrarse el anillo lleno.
+  atomic_bool activa;                ///< Hay una grabación en curso.
+  atomic_bool enlaceListo;           ///< La traza ha terminado su última escritura: se puede enviar.
+  uint32_t secuencia;                ///< Siguiente @ref cabecera_grabacion::secuencia (solo la tarea de adquisición).
+  int64_t ultimoInstanteUs;          ///< Instante del bloque anterior (solo la tarea de adquisición).
+};
+
+struct grabacion_emg grabacion;          ///< Anillo de la grabación en curso.
+static portMUX_TYPE cerrojoEnlace = portMUX_INITIALIZER_UNLOCKED; ///< Hace atómicos la comprobación de @ref grabacion_emg::activa y el cambio de @ref trazaCedida.
+TaskHandle_t tareaVaciadoGrabacion = NULL; ///< Tarea que envía la grabación por USB-Serial-JTAG.
+
+/**
+ * @brief Añade un bloque crudo a la grabación, si hay una en curso. No espera nunca.
+ * @param crudo Bloque de @ref anilloEMG (@ref ANILLO_MUESTRAS_HUECO muestras).
+ * @details Lo llama la tarea de adquisición antes de liberar el bloque.
+ */
+static inline void grabacion_anotar(const uint16_t *crudo)
+{
+  struct grabacion_emg *g = &grabacion;
+  if (!atomic_load_explicit(&g->activa, memory_order_acquire))
+  {
+    return;
+  }
+
+  int64_t ahora = esp_timer_get_time();
+  uint32_t secuencia = g->secuencia++;
+  uint32_t diferencia = g->ultimoInstanteUs ? (uint32_t)(ahora - g->ultimoInstanteUs) : 0;
+  g->ultimoInstanteUs = ahora;
+
+  uint32_t cabeza = atomic_load_explicit(&g->cabeza, memory_order_relaxed);
+  if (cabeza - atomic_load_explicit(&g->cola, memory_order_acquire) >= g->capacidad)
+  {
+    atomic_fetch_add_explicit(&g->descartados, 1, memory_order_relaxed);
+    return;
+  }
+
+  uint8_t *registro = &g->memoria[(cabeza & (g->capacidad - 1)) * GRABACION_BYTES_REGISTRO];
+  struct cabecera_grabacion *c = (struct cabecera_grabacion *)registro;
+  c->marca = GRABACION_MARCA;
+  c->secuencia = secuencia;
+  c->instanteUs = ahora;
+  c->diferenciaUs = diferencia;
+  c->posicionMotor = posicionMotor;
+  c->muestrasPorCanal = ANILLO_MUESTRAS_POR_BLOQUE;
+  c->filaCanal = ANILLO_FILA_CANAL;
+  c->canales = NUMERO_CANALES_EMG;
+  c->estadoFase = (uint8_t)((estado_protesis.estado_actual << 4) | (estado_protesis.fase_actual & 0x0F));
+  c->resultDeteccion = (uint8_t)resultDeteccion;
+  c->estadoPulso = estadoPulso;
+  c->reservado = 0;
+  memcpy(registro + sizeof(*c), crudo, ANILLO_MUESTRAS_HUECO * sizeof(uint16_t));
+  atomic_store_explicit(&g->cabeza, cabeza + 1, memory_order_release);
+}
+
+/**
+ * @brief Tarea de vaciado: envía por USB-Serial-JTAG los registros pendientes, directamente desde el anillo.
+ * @details Cada envío es un tramo contiguo del anillo (sin pasar por un búfer intermedio). Un
+ * envío parcial deja la posición dentro del registro y el siguiente continúa desde ahí. Sin
+ * grabación y con el anillo vacío devuelve el enlace a la traza y espera a la siguiente. Lo
+ * devuelve bajo @ref cerrojoEnlace y solo si sigue sin haber grabación, así que no deshace una
+ * cesión que @ref grabacion_empezar acabe de conceder. Tras devolverlo no envía hasta que
+ * @ref grabacion_emg::enlaceListo indique que la traza ha soltado el enlace.
+ */
+void grabacion_tarea_vaciado(void *parametros)
+{
+  struct grabacion_emg *g = &grabacion;
+  uint32_t enviadosRegistro = 0; // Bytes ya enviados del primer registro pendiente
+
+  while (1)
+  {
+    uint32_t cola = atomic_load_explicit(&g->cola, memory_order_relaxed);
+    uint32_t pendientes = atomic_load_explicit(&g->cabeza, memory_order_acquire) - cola;
+    if (pendientes == 0)
+    {
+      bool devuelto = false;
+      portENTER_CRITICAL(&cerrojoEnlace);
+      if (!atomic_load_explicit(&g->activa, memory_order_acquire))
+      {
+        atomic_store_explicit(&g->enlaceListo, false, memory_order_relaxed);
+        atomic_store_explicit(&trazaCedida, false, memory_order_release);
+        devuelto = true;
+      }
+      portEXIT_CRITICAL(&cerrojoEnlace);
+      if (devuelto)
+      {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      }
+      else
+      {
+        vTaskDelay(pdMS_TO_TICKS(GRABACION_PERIODO_VACIADO_MS));
+      }
+      continue;
+    }
+    if (!atomic_load_explicit(&g->enlaceListo, memory_order_acquire))
+    {
+      // Grabación nueva sobre un enlace recién devuelto: la traza aún puede estar escribiendo
+      vTaskDelay(pdMS_TO_TICKS(GRABACION_PERIODO_VACIADO_MS));
+      continue;
+    }
+
+    uint32_t indice = cola & (g->capacidad - 1);
+    uint32_t tramo = g->capacidad - indice;
+    if (tramo > pendientes)
+    {
+      tramo = pendientes;
+    }
+    if (tramo > GRABACION_REGISTROS_ENVIO)
+    {
+      tramo = GRABACION_REGISTROS_ENVIO;
+    }
+    const uint8_t *datos = &g->memoria[indice * GRABACION_BYTES_REGISTRO + enviadosRegistro];
+    int escritos = usb_serial_jtag_write_bytes(datos, tramo * GRABACION_BYTES_REGISTRO - enviadosRegistro,
+                                               pdMS_TO_TICKS(GRABACION_PERIODO_VACIADO_MS));
+    if (escritos <= 0)
+    {
+      continue;
+    }
+    enviadosRegistro += (uint32_t)escritos;
+    atomic_store_explicit(&g->cola, cola + enviadosRegistro / GRABACION_BYTES_REGISTRO, memory_order_release);
+    enviadosRegistro %= GRABACION_BYTES_REGISTRO;
+  }
+}
+
+/**
+ * @brief Reserva el anillo (en PSRAM si la hay) y crea la tarea de vaciado.
+ * @details La memoria se reserva una vez al arrancar, así que empezar y parar una grabación no
+ * reserva nada. Usa el driver de USB-Serial-JTAG que instala @ref traza_iniciar.
+ * @return `ESP_OK`, o `ESP_ERR_NO_MEM` si no hay memoria para el anillo o la tarea.
+ */
+esp_err_t grabacion_iniciar()
+{
+  struct grabacion_emg *g = &grabacion;
+  uint32_t bytes = GRABACION_BYTES_PSRAM;
+  g->memoria = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  g->enPsram = (g->memoria != NULL);
+  if (g->memoria == NULL)
+  {
+    bytes = GRABACION_BYTES_INTERNA;
+    g->memoria = heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  }
+  if (g->memoria == NULL || bytes < GRABACION_BYTES_REGISTRO)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+
+  // Mayor potencia de 2 de registros que cabe en la memoria reservada
+  g->capacidad = 1;
+  while (2 * g->capacidad * GRABACION_BYTES_REGISTRO <= bytes)
+  {
+    g->capacidad *= 2;
+  }
+
+  if (xTaskCreatePinnedToCore(grabacion_tarea_vaciado, "grabacion", 2048, NULL, GRABACION_PRIORIDAD, &tareaVaciadoGrabacion,
+                              NUCLEO_ADQUISICION) != pdPASS)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+/**
+ * @brief Empieza una grabación: la traza cede USB-Serial-JTAG y los bloques siguientes se graban.
+ * @details La comprobación, el arranque y la cesión van juntos bajo @ref cerrojoEnlace, frente a la
+ * devolución del enlace en @ref grabacion_tarea_vaciado. Los bloques se graban desde ese momento,
+ * pero no se envían hasta que @ref traza_ceder confirma que no queda ninguna escritura de traza.
+ * @return `ESP_OK`, `ESP_ERR_INVALID_STATE` si ya hay una en curso o aún se está enviando la
+ * anterior, o `ESP_ERR_NO_MEM` si @ref grabacion_iniciar no ha podido reservar el anillo.
+ */
+esp_err_t grabacion_empezar()
+{
+  struct grabacion_emg *g = &grabacion;
+  if (g->memoria == NULL || tareaVaciadoGrabacion == NULL)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+  portENTER_CRITICAL(&cerrojoEnlace);
+  if (atomic_load_explicit(&g->activa, memory_order_acquire) ||
+      atomic_load_explicit(&g->cabeza, memory_order_acquire) != atomic_load_explicit(&g->cola, memory_order_acquire))
+  {
+    portEXIT_CRITICAL(&cerrojoEnlace);
+    return ESP_ERR_INVALID_STATE;
+  }
+  g->secuencia = 0;
+  g->ultimoInstanteUs = 0;
+  atomic_store_explicit(&g->descartados, 0, memory_order_relaxed);
+  atomic_store(&trazaCedida, true);
+  atomic_store_explicit(&g->activa, true, memory_order_release);
+  portEXIT_CRITICAL(&cerrojoEnlace);
+
+  traza_ceder();
+  atomic_store_explicit(&g->enlaceListo, true, memory_order_release);
+  xTaskNotifyGive(tareaVaciadoGrabacion);
+  return ESP_OK;
+}
+
+/**
+ * @brief Termina la grabación en curso. Lo ya grabado se sigue enviando hasta vaciar el anillo.
+ */
+void grabacion_parar()
+{
+  atomic_store_explicit(&grabacion.activa, false, memory_order_release);
+}
+
+/**
+ * @brief Comando `grabar`: `grabar inicio`, `grabar fin` o, sin argumentos, el estado de la grabación.
+ */
+static int grabacion_comando(int argc, char **argv)
+{
+  struct grabacion_emg *g = &grabacion;
+  if (argc > 1 && strcmp(argv[1], "inicio") == 0)
+  {
+    esp_err_t err = grabacion_empezar();
+    if (err != ESP_OK)
+    {
+      printf("no se puede empezar: %s\n", esp_err_to_name(err));
+      return 1;
+    }
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "fin") == 0)
+  {
+    grabacion_parar();
+    return 0;
+  }
+  if (argc > 1)
+  {
+    printf("uso: grabar [inicio|fin]\n");
+    return 1;
+  }
+
+  uint32_t pendientes = atomic_load_explicit(&g->cabeza, memory_order_acquire) - atomic_load_explicit(&g->cola, memory_order_acquire);
+  printf("grabación %s: %lu registros de %u bytes pendientes de %lu (%s), %lu bloques descartados\n",
+         atomic_load_explicit(&g->activa, memory_order_acquire) ? "en curso" : "parada", (unsigned long)pendientes,
+         (unsigned)GRABACION_BYTES_REGISTRO, (unsigned long)g->capacidad, g->enPsram ? "PSRAM" : "RAM interna",
+         (unsigned long)atomic_load_explicit(&g->descartados, memory_order_relaxed));
+  return 0;
+}
+
+/**
+ * @brief Registra el comando `grabar` en la consola (ver @ref consola.h).
+ */
+esp_err_t grabacion_registrar_comando()
+{
+  const esp_console_cmd_t comando = {
+    .command = "grabar",
+    .help = "Graba los bloques EMG crudos y los envía por USB-Serial-JTAG (inicio | fin | sin argumentos: estado)",
+    .hint = "[inicio|fin]",
+    .func = grabacion_comando,
+  };
+  return esp_console_cmd_register(&comando);
+}
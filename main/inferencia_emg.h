@@ -0,0 +1,284 @@
+/**
+ * @file inferencia_emg.h
+ * @brief Motor de inferencia int8 sin memoria dinámica para la red de @ref modelo_emg.h.
+ * @details
+ * @ref inferencia_ejecutar cuantiza las características de todos los canales, recorre las capas densas de
+ * @ref MODELO_EMG_CAPAS y escribe la probabilidad de activación en @ref result. Los pesos son
+ * tablas `const` (quedan en flash) y todas las activaciones viven en @ref arenaInferencia, cuyo
+ * tamaño se fija en compilación: no se reserva memoria en tiempo de ejecución.
+ *
+ * El producto escalar de cada neurona tiene dos implementaciones:
+ * - @ref inferencia_producto_ref: referencia escalar en C.
+ * - `inferencia_producto_s8_s3`: kernel PIE del ESP32-S3 (ver inferencia_emg_s3.S), 16 productos
+ *   int8 por instrucción.
+ *
+ * Igual que en @ref caracteristicas_emg.h, el kernel vectorial se usa solo si @ref INFERENCIA_SIMD
+ * está activo y tras comprobar en @ref inferencia_iniciar que coincide con la referencia.
+ *
+ * Cada inferencia se cronometra con el contador de ciclos: @ref ciclosInferencia,
+ * @ref ciclosMaximosInferencia y las que superan @ref INFERENCIA_PRESUPUESTO_CICLOS en
+ * @ref inferenciasFueraPresupuesto.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "sdkconfig.h"
+#include "esp_cpu.h"
+#include "globales.h"
+#include "caracteristicas_emg.h"
+#include "espectro_emg.h"
+#include "modelo_emg.h"
+
+/**
+ * @struct capa_int8
+ * @brief Capa densa cuantizada. Los pesos se guardan por filas, una por neurona de salida.
+ */
+struct capa_int8
+{
+  const int8_t *pesos;    ///< [salidas][entradas], alineado a 16 bytes.
+  const int32_t *sesgos;  ///< [salidas], en la escala del acumulador.
+  uint16_t entradas;      ///< Entradas con relleno (múltiplo de 16).
+  uint16_t salidas;       ///< Neuronas de salida.
+  int32_t multiplicador;  ///< Recuantización: `(acc · multiplicador) >> desplazamiento`.
+  uint8_t desplazamiento; ///< Bits de la recuantización.
+  bool relu;              ///< `true` si la salida pasa por ReLU.
+};
+
+#define INFERENCIA_CAPA(p, s, e, n, m, d, r) {p, s, e, n, m, d, r},
+#define INFERENCIA_VALIDAR(p, s, e, n, m, d, r)                                                             \
+  _Static_assert((e) % 16 == 0 && (e) <= MODELO_EMG_MAX_NEURONAS && MODELO_EMG_RELLENO(n) <= MODELO_EMG_MAX_NEURONAS, \
+                 "Dimensiones de " #p " incompatibles con la arena");                                    \
+  _Static_assert(sizeof(p) == (e) * (n) && sizeof(s) == (n) * sizeof(int32_t), "Tamaño de " #p " o " #s " incorrecto");
+
+MODELO_EMG_CAPAS(INFERENCIA_VALIDAR)
+_Static_assert(MODELO_EMG_SALIDAS == sizeof(result) / sizeof(result[0]), "MODELO_EMG_SALIDAS no coincide con result[]");
+_Static_assert(MODELO_EMG_ENTRADAS >= NUMERO_CANALES_EMG * MODELO_EMG_ENTRADAS_CANAL, "La primera capa no admite todas las características");
+
+static const struct capa_int8 modeloCapas[MODELO_EMG_NUM_CAPAS] = {MODELO_EMG_CAPAS(INFERENCIA_CAPA)}; ///< Red en orden de ejecución.
+
+int8_t arenaInferencia[2][MODELO_EMG_MAX_NEURONAS] __attribute__((aligned(16))); ///< Activaciones: entrada y salida de la capa en curso, alternadas.
+int32_t acumuladoInferencia[MODELO_EMG_SALIDAS]; ///< Acumuladores de la última capa (logits cuantizados).
+
+bool inferenciaSimdValidado = false;          ///< `true` si el kernel vectorial ha superado la comprobación de arranque.
+uint32_t ciclosInferencia = 0;                ///< Ciclos de CPU de la última inferencia.
+uint32_t ciclosMaximosInferencia = 0;         ///< Máximo de ciclos por inferencia desde el arranque.
+uint32_t inferenciasFueraPresupuesto = 0;     ///< Inferencias que han superado @ref INFERENCIA_PRESUPUESTO_CICLOS.
+
+#if INFERENCIA_SIMD && CONFIG_IDF_TARGET_ESP32S3
+/**
+ * @brief Kernel PIE: Σ a[i]·b[i] sobre `bloques` grupos de 16 elementos. Ambos alineados a 16 bytes.
+ */
+extern int32_t inferencia_producto_s8_s3(const int8_t *a, const int8_t *b, uint32_t bloques);
+#endif
+
+/**
+ * @brief Implementación escalar de referencia del producto escalar int8.
+ */
+static inline int32_t inferencia_producto_ref(const int8_t *a, const int8_t *b, uint32_t n)
+{
+  int32_t acumulado = 0;
+  for (uint32_t i = 0; i < n; i++)
+  {
+    acumulado += (int32_t)a[i] * b[i];
+  }
+  return acumulado;
+}
+
+/**
+ * @brief Producto escalar de `n` elementos (múltiplo de 16) con la mejor implementación disponible.
+ */
+static inline int32_t inferencia_producto(const int8_t *a, const int8_t *b, uint32_t n)
+{
+#if INFERENCIA_SIMD && CONFIG_IDF_TARGET_ESP32S3
+  if (inferenciaSimdValidado)
+  {
+    return inferencia_producto_s8_s3(a, b, n / 16);
+  }
+#endif
+  return inferencia_producto_ref(a, b, n);
+}
+
+/**
+ * @brief Satura un valor al rango simétrico de `int8_t` (±127).
+ */
+static inline int8_t inferencia_saturar(int32_t v)
+{
+  if (v > 127)
+  {
+    return 127;
+  }
+  if (v < -127)
+  {
+    return -127;
+  }
+  return (int8_t)v;
+}
+
+/**
+ * @brief Cuantiza una característica ya multiplicada por su escala: redondeo y saturación a ±127.
+ */
+static inline int8_t inferencia_cuantizar(float q)
+{
+  return inferencia_saturar((int32_t)(q < 0 ? q - 0.5f : q + 0.5f));
+}
+
+/**
+ * @brief Ejecuta una capa oculta: `salida = sat((acc · mult) >> desp)`, con ReLU si procede.
+ * @details Las posiciones de relleno de `salida` se ponen a cero para la capa siguiente.
+ */
+static inline void inferencia_capa(const struct capa_int8 *c, const int8_t *entrada, int8_t *salida)
+{
+  int64_t redondeo = (c->desplazamiento > 0) ? (1LL << (c->desplazamiento - 1)) : 0;
+  for (uint32_t o = 0; o < c->salidas; o++)
+  {
+    int32_t acumulado = c->sesgos[o] + inferencia_producto(entrada, &c->pesos[o * c->entradas], c->entradas);
+    int32_t v = (int32_t)(((int64_t)acumulado * c->multiplicador + redondeo) >> c->desplazamiento);
+    salida[o] = inferencia_saturar((c->relu && v < 0) ? 0 : v);
+  }
+  for (uint32_t o = c->salidas; o < MODELO_EMG_RELLENO(c->salidas); o++)
+  {
+    salida[o] = 0;
+  }
+}
+
+/**
+ * @brief Ejecuta la red sobre las características de todos los canales y escribe @ref result.
+ * @param temporales Una fila de @ref NUMERO_CARACTERISTICAS valores por canal (ver
+ * @ref Indice_Canal_EMG e @ref Indice_Caracteristica).
+ * @param espectrales Una fila de @ref NUMERO_CARACTERISTICAS_ESPECTRO valores por canal (ver
+ * @ref Indice_Espectro). Sin @ref ESPECTRO_EMG no se usa.
+ * @details `result[o]` es la probabilidad (0–1) de la salida `o`. Actualiza las medidas de ciclos.
+ */
+void inferencia_ejecutar(const float temporales[NUMERO_CANALES_EMG][NUMERO_CARACTERISTICAS],
+                         const float espectrales[NUMERO_CANALES_EMG][NUMERO_CARACTERISTICAS_ESPECTRO])
+{
+  uint32_t inicio = esp_cpu_get_cycle_count();
+
+  int8_t *entrada = arenaInferencia[0];
+  int8_t *salida = arenaInferencia[1];
+  for (uint32_t c = 0; c < NUMERO_CANALES_EMG; c++)
+  {
+    int8_t *fila = &entrada[c * MODELO_EMG_ENTRADAS_CANAL];
+    for (uint32_t i = 0; i < NUMERO_CARACTERISTICAS; i++)
+    {
+      fila[i] = inferencia_cuantizar(temporales[c][i] * modeloEscalaEntrada[i]);
+    }
+#if ESPECTRO_EMG
+    for (uint32_t i = 0; i < NUMERO_CARACTERISTICAS_ESPECTRO; i++)
+    {
+      fila[NUMERO_CARACTERISTICAS + i] = inferencia_cuantizar(espectrales[c][i] * modeloEscalaEspectro[i]);
+    }
+#endif
+  }
+  for (uint32_t i = NUMERO_CANALES_EMG * MODELO_EMG_ENTRADAS_CANAL; i < MODELO_EMG_ENTRADAS; i++)
+  {
+    entrada[i] = 0;
+  }
+
+  for (uint32_t l = 0; l + 1 < MODELO_EMG_NUM_CAPAS; l++)
+  {
+    inferencia_capa(&modeloCapas[l], entrada, salida);
+    int8_t *t = entrada;
+    entrada = salida;
+    salida = t;
+  }
+
+  const struct capa_int8 *ultima = &modeloCapas[MODELO_EMG_NUM_CAPAS - 1];
+  for (uint32_t o = 0; o < MODELO_EMG_SALIDAS; o++)
+  {
+    acumuladoInferencia[o] = ultima->sesgos[o] + inferencia_producto(entrada, &ultima->pesos[o * ultima->entradas], ultima->entradas);
+    result[o] = 1.0f / (1.0f + expf(-(float)acumuladoInferencia[o] * MODELO_EMG_ESCALA_SALIDA));
+  }
+
+  uint32_t ciclos = esp_cpu_get_cycle_count() - inicio;
+  ciclosInferencia = ciclos;
+  if (ciclos > ciclosMaximosInferencia)
+  {
+    ciclosMaximosInferencia = ciclos;
+  }
+  if (ciclos > INFERENCIA_PRESUPUESTO_CICLOS)
+  {
+    inferenciasFueraPresupuesto++;
+  }
+}
+
+/**
+ * @brief Comprueba el kernel vectorial contra la referencia escalar y lo habilita si coinciden.
+ * @details Se prueban vectores con los extremos de int8 (incluido -128). Debe llamarse una vez al arrancar.
+ * @return `true` si se usará el kernel vectorial.
+ */
+bool inferencia_iniciar()
+{
+  inferenciaSimdValidado = false;
+#if INFERENCIA_SIMD && CONFIG_IDF_TARGET_ESP32S3
+  static int8_t a[256] __attribute__((aligned(16)));
+  static int8_t b[256] __attribute__((aligned(16)));
+  uint32_t semilla = 24680;
+  for (uint32_t i = 0; i < 256; i++)
+  {
+    semilla = semilla * 1664525u + 1013904223u;
+    a[i] = (int8_t)(semilla >> 24);
+    b[i] = (i < 16) ? -128 : (int8_t)(semilla >> 16);
+  }
+  a[0] = -128;
+
+  static const uint32_t longitudes[] = {16, 32, 48, 256};
+  bool iguales = true;
+  for (uint32_t i = 0; i < sizeof(longitudes) / sizeof(longitudes[0]); i++)
+  {
+    int32_t ref = inferencia_producto_ref(a, b, longitudes[i]);
+    iguales = iguales && inferencia_producto_s8_s3(a, b, longitudes[i] / 16) == ref;
+  }
+  inferenciaSimdValidado = iguales;
+#endif
+  return inferenciaSimdValidado;
+}
+
+/**
+ * @brief Microbenchmark: ciclos de CPU por inferencia, comparados con @ref INFERENCIA_PRESUPUESTO_CICLOS.
+ * @param repeticiones Número de inferencias medidas.
+ * @details Mide la implementación escalar y, si está validada, la vectorial. Reinicia
+ * @ref ciclosMaximosInferencia y @ref inferenciasFueraPresupuesto al terminar.
+ */
+void inferencia_benchmark(uint32_t repeticiones)
+{
+  if (repeticiones == 0)
+  {
+    return;
+  }
+  static muestra_emg_t ventana[CIRCULAR_ARRAY_SIZE] __attribute__((aligned(16)));
+  float caracteristicas[NUMERO_CANALES_EMG][NUMERO_CARACTERISTICAS];
+  static const float espectrales[NUMERO_CANALES_EMG][NUMERO_CARACTERISTICAS_ESPECTRO] = {{0}};
+  for (uint32_t c = 0; c < NUMERO_CANALES_EMG; c++)
+  {
+    caracteristicas_ventana_prueba(ventana, CIRCULAR_ARRAY_SIZE, 97531 + c);
+    caracteristicas_calcular(ventana, CIRCULAR_ARRAY_SIZE, caracteristicas[c]);
+  }
+
+  bool simd = inferenciaSimdValidado;
+  for (int pasada = 0; pasada < 2; pasada++)
+  {
+    inferenciaSimdValidado = (pasada == 1);
+    if (inferenciaSimdValidado && !simd)
+    {
+      printf("inferencia: kernel PIE no disponible\n");
+      break;
+    }
+    uint32_t inicio = esp_cpu_get_cycle_count();
+    for (uint32_t i = 0; i < repeticiones; i++)
+    {
+      inferencia_ejecutar(caracteristicas, espectrales);
+    }
+    uint32_t ciclos = (esp_cpu_get_cycle_count() - inicio) / repeticiones;
+    printf("inferencia: %s %lu ciclos (máx %lu), presupuesto %lu: %s\n", pasada ? "PIE" : "escalar",
+           (unsigned long)ciclos, (unsigned long)ciclosMaximosInferencia, (unsigned long)INFERENCIA_PRESUPUESTO_CICLOS,
+           (ciclosMaximosInferencia <= INFERENCIA_PRESUPUESTO_CICLOS) ? "OK" : "EXCEDIDO");
+    ciclosMaximosInferencia = 0;
+  }
+  inferenciaSimdValidado = simd;
+  inferenciasFueraPresupuesto = 0;
+}
@@ -0,0 +1,130 @@
+/**
+ * @file latencia.h
+ * @brief Medida de la latencia de extremo a extremo: de la muestra EMG que produce una orden al PWM del motor.
+ * @details
+ * Con @ref LATENCIA_EXTREMO a `1`, cada bloque lleva su instante de captura desde la interrupción
+ * del ADC (@ref tiempoCapturaEMG) por el filtrado, la ventana y la decisión, que fechan cada salto
+ * con el instante de su última muestra. Cuando un gesto cambia la fase de @ref estado_protesis, la
+ * tarea de control arma la medida con el instante de la muestra que lo ha completado
+ * (@ref latencia_armar). La primera escritura de un duty en el LEDC tras
+ * @ref interpretarMaquinaEstados y @ref activacionMotores (@ref banco_confirmar_duty) la cierra y
+ * suma la latencia al histograma @ref PERFIL_EMG_A_PWM del comando `perf`, en ciclos y en µs.
+ *
+ * La medida no incluye la duración propia del gesto (p. ej. @ref GESTO_PULSO_LARGO_MS), que es
+ * un parámetro y no un retardo del firmware, ni el medio periodo de PWM que tarda el LEDC en
+ * aplicar el duty nuevo. Una orden que no cambia ningún duty en @ref LATENCIA_ESPERA_MAXIMA_MS
+ * (p. ej. cerrar con la mano ya cerrada) se descarta y queda contada en `sinCambio`.
+ *
+ * Con @ref LATENCIA_GPIO, @ref latenciaPin sube al armar la medida y baja al escribir el PWM: en
+ * el osciloscopio, del cruce del umbral en la señal analógica al flanco de subida hay adquisición
+ * y decisión, y la anchura del pulso es el resto hasta el PWM.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "globales.h"
+#include "perfilado.h"
+
+#if LATENCIA_EXTREMO
+
+_Static_assert(PERFILADO, "LATENCIA_EXTREMO necesita PERFILADO para su histograma");
+
+#define LATENCIA_ESPERA_MAXIMA_MS 500 ///< Tiempo máximo desde la orden hasta el cambio de duty; más tarde la medida se descarta.
+
+/**
+ * @struct latencia_extremo
+ * @brief Medida en curso y contadores. Solo la usa la tarea de control.
+ */
+struct latencia_extremo
+{
+  bool armada;         ///< Hay una orden esperando su cambio de duty.
+  int64_t origenUs;    ///< Instante de la muestra que ha producido la orden.
+  uint32_t ultimaUs;   ///< Última latencia medida (µs).
+  uint32_t sinCambio;  ///< Órdenes descartadas por no cambiar ningún duty a tiempo.
+};
+
+struct latencia_extremo latenciaExtremo; ///< Estado de la medida de latencia.
+
+/**
+ * @brief Configura @ref latenciaPin como salida a nivel bajo (con @ref LATENCIA_GPIO).
+ */
+esp_err_t latencia_iniciar()
+{
+  if (!LATENCIA_GPIO)
+  {
+    return ESP_OK;
+  }
+  gpio_config_t io_conf = {0};
+  io_conf.intr_type = GPIO_INTR_DISABLE;
+  io_conf.mode = GPIO_MODE_OUTPUT;
+  io_conf.pin_bit_mask = (1ULL << latenciaPin);
+  esp_err_t err = gpio_config(&io_conf);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+  return gpio_set_level((gpio_num_t)latenciaPin, 0);
+}
+
+/**
+ * @brief Arma la medida con una orden nueva. Una medida armada y sin cerrar se sustituye.
+ * @param origenUs Instante (µs) de la muestra que ha producido la orden.
+ */
+static inline void latencia_armar(int64_t origenUs)
+{
+  latenciaExtremo.armada = true;
+  latenciaExtremo.origenUs = origenUs;
+  if (LATENCIA_GPIO)
+  {
+    gpio_set_level((gpio_num_t)latenciaPin, 1);
+  }
+}
+
+/**
+ * @brief Cierra la medida armada si en este ciclo ha cambiado algún duty, o la descarta si ha vencido.
+ * @param dutyCambiado `true` si el ciclo de control ha escrito algún duty en el LEDC.
+ */
+static inline void latencia_confirmar(bool dutyCambiado)
+{
+  struct latencia_extremo *l = &latenciaExtremo;
+  if (!l->armada)
+  {
+    return;
+  }
+  int64_t latencia = esp_timer_get_time() - l->origenUs;
+  if (!dutyCambiado)
+  {
+    if (latencia > LATENCIA_ESPERA_MAXIMA_MS * 1000)
+    {
+      l->armada = false;
+      l->sinCambio++;
+      if (LATENCIA_GPIO)
+      {
+        gpio_set_level((gpio_num_t)latenciaPin, 0);
+      }
+    }
+    return;
+  }
+
+  if (LATENCIA_GPIO)
+  {
+    gpio_set_level((gpio_num_t)latenciaPin, 0);
+  }
+  l->armada = false;
+  l->ultimaUs = latencia > 0 ? (uint32_t)latencia : 0;
+  perfil_registrar(PERFIL_EMG_A_PWM, l->ultimaUs * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+}
+
+#else
+
+static inline esp_err_t latencia_iniciar() { return ESP_OK; }
+static inline void latencia_armar(int64_t origenUs) {}
+static inline void latencia_confirmar(bool dutyCambiado) {}
+
+#endif
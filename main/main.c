@@ -1,9 +1,35 @@
 #include <stdio.h>
-#include "activacion_motores.h"
+#include "caracteristicas_emg.h"
+#include "consola.h"
+#include "grabacion_emg.h"
+#include "inferencia_emg.h"
+#include "parametros.h"
+#include "perfilado.h"
+#include "plazos.h"
+#include "persistencia.h"
+#include "tareas_nucleos.h"
+#include "traza.h"
 
 void app_main(void)
 {
-
-    semaforoMuestreo = xSemaphoreCreateBinary();
-    printf("\n\nSEMAFORO CREADO: %p\n", semaforoMuestreo);
+    traza_iniciar();
+    grabacion_iniciar();
+    caracteristicas_iniciar();
+#if BENCHMARK_CARACTERISTICAS
+    caracteristicas_benchmark(CIRCULAR_ARRAY_SIZE, 1000);
+#endif
+    inferencia_iniciar();
+#if BENCHMARK_INFERENCIA
+    inferencia_benchmark(1000);
+#endif
+    persistencia_iniciar();
+    consola_iniciar();
+#if PERFILADO
+    perfil_registrar_comando();
+#endif
+    grabacion_registrar_comando();
+    parametros_registrar_comando();
+    plazos_registrar_comando();
+    calibracion_motores_registrar_comando();
+    tareas_iniciar();
 }
\ No newline at end of file
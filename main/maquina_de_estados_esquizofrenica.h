@@ -32,41 +32,20 @@
  *   - @ref FASE_CAMBIO_ESTADO: Colocarse en @ref POSICION_0 y cambiar a @ref ESTADO_NORMAL.
  * 
  * @note Las fases no son necesariamente secuenciales; su numeración es solo para organizar.
+ * @note Los estados, las fases y sus acciones y transiciones se definen en @ref tabla_estados.h,
+ * común con la variante en C (@ref maquina_de_estados_protesis.h).
  */
 
 #pragma once
 
+#include "tabla_estados.h"
+
 //definición de los valores estándard de la prótesis (los umbrales) (genéricos de Internet)
 #define UMBRAL_CORRIENTE_DEFAULT    2.0f    // 2.0 Amperios
 #define UMBRAL_TEMPERATURA_DEFAULT  60.0f   // 60°C
-#define UMBRAL_VELOCIDAD_DEFAULT    100.0f  // unidades/segundo
+#define UMBRAL_VELOCIDAD_DEFAULT    12000.0f // pasos de encoder/segundo (por encima de VELOCIDAD_MAXIMA_MOTOR)
 #define UMBRAL_FUERZA_DEFAULT       50.0f   // 50 Newtons estimados (VARIABLE) (QUERÍAMOS MAYOR FUERZA EN CUPPER)
 
-/**
- * @enum Estado_Protesis
- * @brief Posibles estados de la prótesis.
- */
-enum Estado_Protesis 
-{
-    ESTADO_NORMAL,             ///< Funcionamiento normal de la prótesis.
-    ESTADO_DESCANSO,           ///< Modo para realizar una pausa controlada.
-    ESTADO_SEGURIDAD,          ///< Modo de seguridad (secuencia: apertura y parada de motores)
-    ESTADO_CALIBRADO_UMBRALES, ///< Modo de calibración de umbrales de activación/desactivación.
-    ESTADO_CALIBRADO_MOTORES   ///< Modo de calibración de límites mecánicos del motor.
-};
-
-/**
- * @enum Fase_Estado
- * @brief Fases asociadas a cada estado de la prótesis.
- */
-enum Fase_Estado
-{
-    FASE_PAUSA,         ///< Los motores se encuentran en reposo, no hacen nada, hasta que se cambie de fase y/o estado.
-    FASE_PASO_1,        ///< Realiza una acción según el estado actual.
-    FASE_PASO_2,        ///< Realiza una acción según el estado actual.
-    FASE_CAMBIO_ESTADO, ///< Configuración de posición y cambio de estado.
-};
-
 /**
  * @enum Causa_Seguridad
  * @brief Enumera las causas/condiciones por las cuales entraríamos en @ref ESTADO_SEGURIDAD.
@@ -164,16 +143,22 @@ struct Condiciones_Seguridad
     /**
     * @brief en esta vamos actualizando los valores en los que realizamos la comprobación y leyendo los valores actuales.
     * Es una función que llamamos más adelante definiento las variables.
+    * @details Lee la última instantánea publicada por la tarea de sensores (ver sensores.h, que debe
+    * incluirse antes): coste constante, sin conversiones ADC ni bloqueos.
     */
     void actualizacion () 
     {
-        //leer valores (**HARÍA FALTA COLOCAR AQUÍ UNA FUNCIÓN QUE LEA LOS VALORES**)
-        float corriente_actual = ;
-        float temp_actual = ;
-        float velocidad_actual = ;
-        float fuerza_actual = ;
-        bool señal_actual = ;
-        bool posicion_actual = ;
+        // Si el seqlock está ocupado en todos los intentos se mantiene la lectura anterior
+        static struct instantanea_sensores lectura = {};
+        sensores_leer(&lectura);
+        bool reciente = (esp_timer_get_time() - lectura.tiempo) < SENSORES_ANTIGUEDAD_MAXIMA_MS * 1000LL;
+
+        float corriente_actual = lectura.corriente;
+        float temp_actual = lectura.temperatura;
+        float velocidad_actual = (velocidadMotor < 0) ? -velocidadMotor : velocidadMotor; // ver motores_read_velocity()
+        float fuerza_actual = 0.0f; // todavía no hay sensor de fuerza
+        bool señal_actual = lectura.valida && reciente;
+        bool posicion_actual = lectura.encoderOk;
 
         corriente_motores = corriente_actual; 
         temperatura =  temp_actual ;      
@@ -397,24 +382,17 @@ struct Maquina_de_estados_protesis
 
         if (en_seguridad) 
         {
-            switch (fase_actual)
+            // Secuencia de seguridad según tablaEstados: abrir -> parar -> cambio de estado
+            const accion_estado *accion = tabla_accion(estado_actual, fase_actual);
+            if (accion->estado_siguiente == estado_actual)
             {
-                case FASE_PASO_1:
-                    fase_actual = FASE_PASO_2;
-                break;
-
-                case FASE_PASO_2:
-                    fase_actual = FASE_CAMBIO_ESTADO;
-                break;
-
-                case FASE_CAMBIO_ESTADO:
-                    if (problema_resuelto) 
-                    {
-                        en_seguridad = false;
-                        cambiarEstado (ESTADO_NORMAL);
-                    };
-                break;
+                fase_actual = (Fase_Estado)accion->fase_siguiente;
             }
+            else if (problema_resuelto) 
+            {
+                en_seguridad = false;
+                cambiarEstado ((Estado_Protesis)accion->estado_siguiente);
+            };
         }
          
      };
@@ -3,34 +3,14 @@
  * The original file contained C++ constructors and methods which are
  * invalid when included from .c sources. This header exposes a plain
  * C struct and small inline helpers to operate on it from C code.
+ * States, phases and the action/transition table are shared with the
+ * C++ variant through tabla_estados.h.
  */
 
 #pragma once
 
-/**
- * @enum Estado_Protesis
- * @brief Estados posibles de la prótesis.
- */
-enum Estado_Protesis
-{
-    ESTADO_NORMAL,
-    ESTADO_SEGURIDAD,
-    ESTADO_CALIBRADO_UMBRALES,
-    ESTADO_CALIBRADO_MOTORES
-};
-
-/**
- * @enum Fase_Estado
- * @brief Fases asociadas a cada estado de la prótesis.
- */
-enum Fase_Estado
-{
-    FASE_1,
-    FASE_2,
-    FASE_3,
-    FASE_4,
-    FASE_5
-};
+#include <stdbool.h>
+#include "tabla_estados.h"
 
 /**
  * @struct Maquina_de_estados_protesis
@@ -43,27 +23,69 @@ struct Maquina_de_estados_protesis
 };
 
 /**
- * @brief Inicializa una máquina de estados en estado normal y fase 1.
+ * @brief Inicializa una máquina de estados en estado normal y fase de pausa.
  */
 static inline void maquina_inicializar(struct Maquina_de_estados_protesis *m)
 {
     m->estado_actual = ESTADO_NORMAL;
-    m->fase_actual = FASE_1;
+    m->fase_actual = FASE_PAUSA;
 }
 
 /**
- * @brief Cambia el estado y resetea la fase a FASE_1.
+ * @brief Entrada de @ref tablaEstados del estado y la fase actuales.
+ */
+static inline const struct accion_estado *maquina_accion(const struct Maquina_de_estados_protesis *m)
+{
+    return tabla_accion(m->estado_actual, m->fase_actual);
+}
+
+/**
+ * @brief Cambia el estado y resetea la fase a FASE_PAUSA.
  */
 static inline void maquina_cambiarEstado(struct Maquina_de_estados_protesis *m, enum Estado_Protesis nuevo_estado)
 {
     m->estado_actual = nuevo_estado;
-    m->fase_actual = FASE_1;
+    m->fase_actual = FASE_PAUSA;
 }
 
 /**
- * @brief Cambia la fase actual.
+ * @brief Cambia la fase actual si la tabla lo permite desde la fase en curso.
+ * @return `false` si el salto no está permitido (la fase no cambia).
+ * @note Cuando la fase de origen se conoce al compilar, usar @ref MAQUINA_CAMBIAR_FASE.
  */
-static inline void maquina_cambiarFase(struct Maquina_de_estados_protesis *m, enum Fase_Estado nueva_fase)
+static inline bool maquina_cambiarFase(struct Maquina_de_estados_protesis *m, enum Fase_Estado nueva_fase)
 {
-    m->fase_actual = nueva_fase;
-}
\ No newline at end of file
+    bool permitida = (maquina_accion(m)->permitidas >> nueva_fase) & 1u;
+    if (permitida)
+    {
+        m->fase_actual = nueva_fase;
+    }
+    return permitida;
+}
+
+/**
+ * @brief Da por terminada la fase actual: pasa a la fase o al estado siguiente de la tabla.
+ */
+static inline void maquina_completar_fase(struct Maquina_de_estados_protesis *m)
+{
+    const struct accion_estado *a = maquina_accion(m);
+    if (a->estado_siguiente != m->estado_actual)
+    {
+        maquina_cambiarEstado(m, (enum Estado_Protesis)a->estado_siguiente);
+    }
+    else
+    {
+        m->fase_actual = (enum Fase_Estado)a->fase_siguiente;
+    }
+}
+
+/**
+ * @brief Salto de fase comprobado en compilación: no compila si la tabla no permite `desde` → `hacia` en `estado`.
+ * @details Debe usarse donde la fase actual se conoce (p. ej. dentro de su `case`).
+ */
+#define MAQUINA_CAMBIAR_FASE(m, estado, desde, hacia)                                                                   \
+    do                                                                                                                  \
+    {                                                                                                                   \
+        TABLA_ASSERT(MAQUINA_FASE_PERMITIDA(estado, desde, hacia), "Salto " #desde " -> " #hacia " no permitido en " #estado); \
+        (m)->fase_actual = (hacia);                                                                                     \
+    } while (0)
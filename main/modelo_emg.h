@@ -0,0 +1,73 @@
+/**
+ * @file modelo_emg.h
+ * @brief Pesos cuantizados (int8) del perceptrón multicapa de detección EMG.
+ * @details
+ * Red de @ref MODELO_EMG_NUM_CAPAS capas densas sobre las características de todos los canales,
+ * aplanadas por filas: cada canal aporta @ref MODELO_EMG_ENTRADAS_CANAL entradas, primero las
+ * temporales (@ref Indice_Caracteristica) y, con @ref ESPECTRO_EMG, las espectrales
+ * (@ref Indice_Espectro). @ref NUMERO_CANALES_EMG × @ref MODELO_EMG_ENTRADAS_CANAL →
+ * @ref MODELO_EMG_OCULTA (ReLU) → 1.
+ * La salida es un logit; @ref inferencia_ejecutar lo convierte en probabilidad de activación.
+ *
+ * Convenio de cuantización (simétrico, sin punto cero):
+ * - Entrada: `q = round(x · escala)`, saturado a ±127, con la escala de la característica en
+ *   @ref modeloEscalaEntrada o @ref modeloEscalaEspectro.
+ * - Capa: `acc = sesgo + Σ peso·entrada` en int32; las capas ocultas se recuantizan con
+ *   `(acc · multiplicador) >> desplazamiento` y la última se convierte a coma flotante con
+ *   @ref MODELO_EMG_ESCALA_SALIDA.
+ * - Cada fila de pesos tiene tantos elementos como entradas de la capa redondeadas a múltiplo de
+ *   16 (@ref MODELO_EMG_RELLENO); los de relleno deben ser 0.
+ *
+ * Los valores de este archivo son un modelo de ejemplo que reproduce un umbral suave sobre la MAV
+ * del canal principal: probabilidad 0,5 con MAV ≈ 120 cuentas filtradas, entre los umbrales de
+ * activación y desactivación de la reproducción en host, y ≈ 0,03 en reposo (MAV ≈ 8). Las
+ * escalas de entrada cubren el rango que produce la cadena con el ADC de 12 bits: en la señal de
+ * la reproducción, MAV hasta ≈ 350, varianza hasta ≈ 2·10⁵ y WL hasta ≈ 1,5·10⁴ en contracción.
+ * Para usar una red entrenada basta con sustituir las tablas manteniendo las dimensiones, o
+ * cambiar las dimensiones y las tablas a la vez.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "globales.h"
+#include "espectro_emg.h"
+
+#define MODELO_EMG_RELLENO(n) (((n) + 15u) & ~15u) ///< Redondeo a múltiplo de 16 (un registro vectorial de int8).
+
+#define MODELO_EMG_NUM_CAPAS 2                                       ///< Capas densas de la red.
+#define MODELO_EMG_ENTRADAS_CANAL (NUMERO_CARACTERISTICAS + (ESPECTRO_EMG ? NUMERO_CARACTERISTICAS_ESPECTRO : 0)) ///< Entradas de la red por cada canal.
+#define MODELO_EMG_ENTRADAS MODELO_EMG_RELLENO(NUMERO_CANALES_EMG * MODELO_EMG_ENTRADAS_CANAL) ///< Entradas de la primera capa (con relleno).
+#define MODELO_EMG_OCULTA 16                                         ///< Neuronas de la capa oculta (múltiplo de 16).
+#define MODELO_EMG_SALIDAS 1                                         ///< Salidas de la red (tamaño de @ref result).
+#define MODELO_EMG_MAX_NEURONAS (MODELO_EMG_ENTRADAS > MODELO_EMG_OCULTA ? MODELO_EMG_ENTRADAS : MODELO_EMG_OCULTA) ///< Mayor anchura de capa, con relleno. Dimensiona la arena.
+#define MODELO_EMG_ESCALA_SALIDA (1.0f / 1000.0f)                    ///< Paso de cuantización del logit de salida.
+
+/// Pasos de cuantización de cada característica, comunes a todos los canales (MAV hasta 512, varianza hasta 512², WL hasta 2·10⁴).
+static const float modeloEscalaEntrada[NUMERO_CARACTERISTICAS] = {127.0f / 512.0f, 127.0f / 262144.0f, 127.0f / 20000.0f};
+
+#define MODELO_EMG_ESCALA_BANDA(id, desde, hasta) [id] = 127.0f / 4194304.0f,
+/// Pasos de cuantización de cada característica espectral (frecuencias hasta 500 Hz, potencias hasta 2048²).
+static const float modeloEscalaEspectro[NUMERO_CARACTERISTICAS_ESPECTRO] = {
+  [ESPECTRO_FRECUENCIA_MEDIA] = 127.0f / 500.0f,
+  [ESPECTRO_FRECUENCIA_MEDIANA] = 127.0f / 500.0f,
+  ESPECTRO_BANDAS(MODELO_EMG_ESCALA_BANDA)
+};
+
+/// Capa 1: [@ref MODELO_EMG_OCULTA][@ref MODELO_EMG_ENTRADAS]. Solo la neurona 0 mira la MAV del canal principal y la copia (127·q >> 7 ≈ q).
+static const int8_t modeloPesosCapa1[MODELO_EMG_OCULTA * MODELO_EMG_ENTRADAS] __attribute__((aligned(16))) = {
+  127, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+static const int32_t modeloSesgosCapa1[MODELO_EMG_OCULTA] = {0};
+
+/// Capa 2: [@ref MODELO_EMG_SALIDAS][@ref MODELO_EMG_OCULTA]. Logit `0,127 · (q - 30)`: cero con la MAV cuantizada a 30 (≈ 120 cuentas).
+static const int8_t modeloPesosCapa2[MODELO_EMG_SALIDAS * MODELO_EMG_OCULTA] __attribute__((aligned(16))) = {127};
+static const int32_t modeloSesgosCapa2[MODELO_EMG_SALIDAS] = {-3810};
+
+/**
+ * @brief Capas de la red en orden: `CAPA(pesos, sesgos, entradas, salidas, multiplicador, desplazamiento, relu)`.
+ * @details `entradas` incluye el relleno. En la última capa `multiplicador` y `desplazamiento` no se usan.
+ */
+#define MODELO_EMG_CAPAS(CAPA)                                                                  \
+  CAPA(modeloPesosCapa1, modeloSesgosCapa1, MODELO_EMG_ENTRADAS, MODELO_EMG_OCULTA, 1, 7, true) \
+  CAPA(modeloPesosCapa2, modeloSesgosCapa2, MODELO_EMG_OCULTA, MODELO_EMG_SALIDAS, 1, 0, false)
@@ -9,13 +9,70 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <math.h>
+#include "esp_err.h"
 #include "driver/gpio.h"
 #include "driver/ledc.h"
+#include "driver/pulse_cnt.h"
+#include "driver/mcpwm_cap.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "hal/gpio_ll.h"
+#include "soc/gpio_struct.h"
 
 /* Direction helpers */
 #define ABRIR false
 #define CERRAR true
 
+/* PCNT counting range; the driver accumulates overflows past these limits */
+#define MOTORES_PCNT_HIGH_LIMIT 30000
+#define MOTORES_PCNT_LOW_LIMIT (-30000)
+
+/*
+ * LEDC frequency and duty resolution of the drive PWM. 20 kHz is above the
+ * audible range; the LEDC clock (80 MHz APB) limits frequency * 2^bits.
+ */
+#define MOTORES_PWM_FREQ_HZ 20000
+#define MOTORES_DUTY_BITS 10
+#define MOTORES_DUTY_MAX ((1 << MOTORES_DUTY_BITS) - 1)
+#define MOTORES_PWM_CLOCK_HZ 80000000
+/* A duty written to the LEDC only reaches the output at the next period: wait this long */
+#define MOTORES_PWM_PERIOD_US (1000000 / MOTORES_PWM_FREQ_HZ + 1)
+
+_Static_assert((uint64_t)MOTORES_PWM_FREQ_HZ << MOTORES_DUTY_BITS <= MOTORES_PWM_CLOCK_HZ, "MOTORES_PWM_FREQ_HZ too high for MOTORES_DUTY_BITS");
+
+/*
+ * Duty increases are ramped by the LEDC fade hardware, 0 to MOTORES_DUTY_MAX
+ * in about MOTORES_RAMP_US, so starts and reversals do not draw an inrush
+ * current spike. Decreases (stops, limits, the ISR cut) are never delayed.
+ * 0 applies every duty at once.
+ */
+#define MOTORES_RAMP_US 20000
+/* PWM cycles of a full-scale ramp, and the fade step (duty counts every MOTORES_RAMP_CYCLES cycles) that covers it */
+#define MOTORES_RAMP_TOTAL_CYCLES ((uint64_t)MOTORES_PWM_FREQ_HZ * MOTORES_RAMP_US / 1000000)
+#define MOTORES_RAMP_SCALE ((MOTORES_RAMP_TOTAL_CYCLES >= MOTORES_DUTY_MAX) ? 1 : (uint32_t)((MOTORES_DUTY_MAX + MOTORES_RAMP_TOTAL_CYCLES - 1) / MOTORES_RAMP_TOTAL_CYCLES))
+#define MOTORES_RAMP_CYCLES ((MOTORES_RAMP_TOTAL_CYCLES >= MOTORES_DUTY_MAX) ? (uint32_t)(MOTORES_RAMP_TOTAL_CYCLES / MOTORES_DUTY_MAX) : 1)
+/* Field widths of the fade: step count, cycles per step and step size (10 bits each on the ESP32-S3) */
+#define MOTORES_FADE_FIELD_MAX 1023
+
+_Static_assert(MOTORES_RAMP_US == 0 || MOTORES_RAMP_TOTAL_CYCLES > 0, "MOTORES_RAMP_US shorter than one PWM cycle");
+_Static_assert(MOTORES_RAMP_US == 0 || (MOTORES_DUTY_MAX / MOTORES_RAMP_SCALE <= MOTORES_FADE_FIELD_MAX && MOTORES_RAMP_CYCLES <= MOTORES_FADE_FIELD_MAX),
+               "MOTORES_RAMP_US does not fit the LEDC fade fields");
+
+/* Velocity estimation: below this many steps per update the edge period is used instead */
+#define MOTORES_VEL_MIN_COUNTS 8
+/* With no encoder edge for this long the motor is considered stopped (seconds) */
+#define MOTORES_VEL_TIMEOUT_S 0.1f
+
+/* Encoder decoding backends */
+enum motores_encoder_mode {
+    MOTORES_ENCODER_ISR,  /* software decoding, x2, driven by motores_step() */
+    MOTORES_ENCODER_PCNT  /* hardware quadrature decoding, x4, no per-edge ISR */
+};
+
 struct motores {
     gpio_num_t clk;
     gpio_num_t dt;
@@ -29,10 +86,60 @@ struct motores {
     bool last_state;
     uint16_t position;
 
+    enum motores_encoder_mode encoder_mode;
+    pcnt_unit_handle_t pcnt_unit;
+    int pcnt_offset; /* position = pcnt count + pcnt_offset */
+
     bool until;
     uint16_t objective;
 
+    /* Hardware target: set from interrupt context once the drive has been cut */
+    volatile bool target_armed;
+    volatile bool target_reached;
+    int pcnt_target;      /* objective in raw PCNT counts (objective - pcnt_offset) */
+    bool pcnt_target_set; /* pcnt_target is installed as a watch point */
+    uint32_t target_missed; /* motores_start_until() objectives left to polling: not armed, or armed and never cut */
+
+    ledc_timer_t pwm_timer; /* configured once with motores_setup_pwm_timer(), may be shared */
     ledc_channel_t pwm_channel;
+    uint32_t duty;         /* last duty requested with motores_set_duty() */
+    uint32_t duty_latched; /* duty written to the LEDC by motores_commit_duty() */
+    bool direction;        /* level requested with motores_set_direction() */
+    bool direction_latched; /* level driven on ph by motores_commit_duty(): a change restarts the ramp */
+
+    /* Velocity estimate, refreshed by motores_read_velocity() */
+    struct {
+        mcpwm_cap_timer_handle_t timer;
+        mcpwm_cap_channel_handle_t edge; /* latches the time of each rising edge of dt (encoder A) */
+        mcpwm_cap_channel_handle_t now;  /* soft-triggered to sample the capture timer */
+        uint32_t resolution_hz;          /* ticks per second of the time base in use */
+        int last_count;                  /* position count at the previous update */
+        uint32_t last_time;              /* time of the previous update */
+        uint32_t last_edge;              /* latched edge time seen at the previous update */
+        int direction;                   /* sign of the last count change */
+        float velocity;                  /* steps/s, positive towards max_pos */
+    } vel;
+
+    /* Closed-loop mode (motores_profile_*): PI + velocity feed-forward, see motores_profile_setup() */
+    struct {
+        float kp;           /* duty per step of position error */
+        float ki;           /* duty per step*s of integrated error */
+        float kff;          /* duty per step/s of reference velocity */
+        float kv;           /* duty per step/s of velocity error */
+        float dt;           /* control period in seconds */
+        uint16_t tolerance; /* steps of error accepted as arrived */
+    } pid;
+
+    /* Trapezoidal reference trajectory followed by the closed loop */
+    struct {
+        bool active;
+        uint16_t target;
+        float pos_ref;   /* steps */
+        float vel_ref;   /* steps/s */
+        float v_max;     /* steps/s */
+        float a_max;     /* steps/s^2 */
+        float integral;  /* steps*s */
+    } profile;
 };
 
 /* API */
@@ -48,6 +155,21 @@ static inline void motores_setup_rotary(struct motores *m)
     m->last_state = gpio_get_level(m->dt);
 }
 
+/*
+ * Configure the LEDC timer that clocks the drive PWM. One timer can serve
+ * every channel of a motor bank: call this once, before motores_init().
+ */
+static inline esp_err_t motores_setup_pwm_timer(ledc_timer_t timer, uint32_t freq_hz)
+{
+    ledc_timer_config_t ledc_timer = {0};
+    ledc_timer.speed_mode = LEDC_LOW_SPEED_MODE;
+    ledc_timer.duty_resolution = (ledc_timer_bit_t)MOTORES_DUTY_BITS;
+    ledc_timer.timer_num = timer;
+    ledc_timer.freq_hz = freq_hz;
+    ledc_timer.clk_cfg = LEDC_AUTO_CLK;
+    return ledc_timer_config(&ledc_timer);
+}
+
 static inline void motores_setup_motor(struct motores *m)
 {
     gpio_config_t io_conf = {0};
@@ -58,27 +180,21 @@ static inline void motores_setup_motor(struct motores *m)
     io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
     gpio_config(&io_conf);
 
+    gpio_set_level(m->ph, m->direction_latched);
     gpio_set_level(m->sleep, 1);
 
-    ledc_timer_config_t ledc_timer = {0};
-    ledc_timer.speed_mode = LEDC_LOW_SPEED_MODE;
-    ledc_timer.duty_resolution = LEDC_TIMER_8_BIT;
-    ledc_timer.timer_num = LEDC_TIMER_0;
-    ledc_timer.freq_hz = 5000;
-    ledc_timer.clk_cfg = LEDC_AUTO_CLK;
-    ledc_timer_config(&ledc_timer);
-
     ledc_channel_config_t ledc_channel = {0};
     ledc_channel.gpio_num = m->ena;
     ledc_channel.speed_mode = LEDC_LOW_SPEED_MODE;
     ledc_channel.channel = m->pwm_channel;
-    ledc_channel.timer_sel = LEDC_TIMER_0;
+    ledc_channel.timer_sel = m->pwm_timer;
     ledc_channel.duty = 0;
     ledc_channel.hpoint = 0;
     ledc_channel_config(&ledc_channel);
 }
 
-static inline void motores_init(struct motores *m, gpio_num_t clk_pin, gpio_num_t dt_pin, gpio_num_t en_pin, gpio_num_t ph_pin, gpio_num_t sleep_pin, uint16_t max_pos, uint16_t min_pos, ledc_channel_t pwm_channel)
+/* The PWM timer must already be configured with motores_setup_pwm_timer() */
+static inline void motores_init(struct motores *m, gpio_num_t clk_pin, gpio_num_t dt_pin, gpio_num_t en_pin, gpio_num_t ph_pin, gpio_num_t sleep_pin, uint16_t max_pos, uint16_t min_pos, ledc_timer_t pwm_timer, ledc_channel_t pwm_channel)
 {
     m->clk = clk_pin;
     m->dt = dt_pin;
@@ -88,18 +204,401 @@ static inline void motores_init(struct motores *m, gpio_num_t clk_pin, gpio_num_
     m->max_pos = max_pos;
     m->min_pos = min_pos;
     m->position = 0;
+    m->pwm_timer = pwm_timer;
     m->pwm_channel = pwm_channel;
+    m->duty = 0;
+    m->duty_latched = 0;
+    m->direction = false;
+    m->direction_latched = false;
     m->until = false;
     m->objective = 0;
+    m->target_armed = false;
+    m->target_reached = false;
+    m->pcnt_target = 0;
+    m->pcnt_target_set = false;
+    m->target_missed = 0;
     m->last_state = false;
+    m->encoder_mode = MOTORES_ENCODER_ISR;
+    m->pcnt_unit = NULL;
+    m->pcnt_offset = 0;
+    m->pid.kp = 0;
+    m->pid.ki = 0;
+    m->pid.kff = 0;
+    m->pid.kv = 0;
+    m->pid.dt = 0;
+    m->pid.tolerance = 0;
+    m->profile.active = false;
+    m->vel.timer = NULL;
+    m->vel.edge = NULL;
+    m->vel.now = NULL;
+    m->vel.resolution_hz = 1000000; /* esp_timer microseconds until motores_setup_velocity() */
+    m->vel.last_count = 0;
+    m->vel.last_time = (uint32_t)esp_timer_get_time();
+    m->vel.last_edge = 0;
+    m->vel.direction = 0;
+    m->vel.velocity = 0;
     motores_setup_rotary(m);
     motores_setup_motor(m);
 }
 
-static inline void motores_step(struct motores *m)
+/*
+ * Request a drive duty. Nothing reaches the LEDC until motores_commit_duty(),
+ * so a control tick that rewrites the duty several times (stop, then start
+ * again) costs at most one register update, none if it ends on the duty
+ * already latched, and a bank of motors commits all its channels at one
+ * point of the tick.
+ */
+static inline void motores_set_duty(struct motores *m, uint32_t duty)
+{
+    m->duty = duty;
+}
+
+/*
+ * Request a drive direction. Like the duty it is only applied by
+ * motores_commit_duty(), so the phase pin never flips under the old duty.
+ */
+static inline void motores_set_direction(struct motores *m, bool direction)
+{
+    m->direction = direction;
+}
+
+/*
+ * Latch the last requested duty, if it differs from the one already in the
+ * LEDC or the direction has changed since. Returns true when the LEDC was
+ * written.
+ *
+ * A rise is programmed as a hardware fade (ledc_set_fade() sets its start
+ * explicitly, so no fade ISR or driver lock is involved) starting from the
+ * duty the output has now: a new command during a ramp continues it at the
+ * same slope instead of jumping. The start is lowered by less than one step
+ * so the fade ends exactly on the requested duty.
+ *
+ * A reversal first drives zero duty and waits one PWM period, since the LEDC
+ * only takes a new duty at the start of a period, then flips the phase pin;
+ * the new duty ramps up from zero. The bridge never sees the old duty in the
+ * new direction.
+ */
+static inline bool motores_commit_duty(struct motores *m)
+{
+    bool reversed = m->direction != m->direction_latched;
+    if (m->duty == m->duty_latched && !reversed)
+        return false;
+    if (reversed)
+    {
+        if (m->duty_latched != 0)
+        {
+            ledc_set_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel, 0);
+            ledc_update_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel);
+            esp_rom_delay_us(MOTORES_PWM_PERIOD_US);
+        }
+        gpio_set_level(m->ph, m->direction);
+    }
+    m->duty_latched = m->duty;
+    m->direction_latched = m->direction;
+#if MOTORES_RAMP_US > 0
+    uint32_t from = reversed ? 0 : ledc_get_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel);
+    if (m->duty > from + MOTORES_RAMP_SCALE)
+    {
+        uint32_t steps = (m->duty - from + MOTORES_RAMP_SCALE - 1) / MOTORES_RAMP_SCALE;
+        if (steps * MOTORES_RAMP_SCALE > m->duty)
+            steps = m->duty / MOTORES_RAMP_SCALE;
+        ledc_set_fade(LEDC_LOW_SPEED_MODE, m->pwm_channel, m->duty - steps * MOTORES_RAMP_SCALE, LEDC_DUTY_DIR_INCREASE,
+                      steps, MOTORES_RAMP_CYCLES, MOTORES_RAMP_SCALE);
+        ledc_update_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel);
+        return true;
+    }
+#endif
+    ledc_set_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel, m->duty);
+    ledc_update_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel);
+    return true;
+}
+
+/*
+ * Cut the drive from interrupt context. Putting the driver to sleep disables
+ * its outputs immediately, without waiting for the next LEDC period and
+ * without calling the (flash resident) ledc driver. The task side completes
+ * the stop in motores_finish_target().
+ */
+static inline void IRAM_ATTR motores_cut_drive_isr(struct motores *m)
+{
+    gpio_ll_set_level(&GPIO, m->sleep, 0);
+    m->target_armed = false;
+    m->target_reached = true;
+}
+
+static bool IRAM_ATTR motores_pcnt_on_reach(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t *edata, void *user_ctx)
+{
+    struct motores *m = (struct motores *)user_ctx;
+    if (m->target_armed && m->pcnt_target_set && edata->watch_point_value == m->pcnt_target)
+        motores_cut_drive_isr(m);
+    return false;
+}
+
+/*
+ * Switch the encoder to hardware x4 quadrature decoding on a PCNT unit.
+ * Both channels count on the edges of one signal and use the other as
+ * direction level, so every edge of A and B is decoded without CPU work.
+ * Pulses shorter than glitch_ns are filtered out in hardware.
+ * motores_start_until() objectives are programmed as a PCNT watch point
+ * that cuts the drive from motores_pcnt_on_reach().
+ * On failure the instance stays in MOTORES_ENCODER_ISR mode so the caller
+ * can fall back to the GPIO interrupt + motores_step().
+ */
+static inline esp_err_t motores_setup_pcnt(struct motores *m, uint32_t glitch_ns)
+{
+    pcnt_unit_config_t unit_config = {0};
+    unit_config.high_limit = MOTORES_PCNT_HIGH_LIMIT;
+    unit_config.low_limit = MOTORES_PCNT_LOW_LIMIT;
+    unit_config.flags.accum_count = 1;
+    pcnt_unit_handle_t unit = NULL;
+    esp_err_t err = pcnt_new_unit(&unit_config, &unit);
+    if (err != ESP_OK)
+        return err;
+
+    pcnt_glitch_filter_config_t filter_config = {0};
+    filter_config.max_glitch_ns = glitch_ns;
+    pcnt_channel_handle_t chan_dt = NULL;
+    pcnt_channel_handle_t chan_clk = NULL;
+    pcnt_chan_config_t chan_dt_config = {0};
+    chan_dt_config.edge_gpio_num = m->dt;
+    chan_dt_config.level_gpio_num = m->clk;
+    pcnt_chan_config_t chan_clk_config = {0};
+    chan_clk_config.edge_gpio_num = m->clk;
+    chan_clk_config.level_gpio_num = m->dt;
+    pcnt_event_callbacks_t callbacks = {0};
+    callbacks.on_reach = motores_pcnt_on_reach;
+
+    /* Same sign convention as motores_step(): dt != clk after a dt edge counts up */
+    if ((err = pcnt_unit_set_glitch_filter(unit, &filter_config)) != ESP_OK ||
+        (err = pcnt_new_channel(unit, &chan_dt_config, &chan_dt)) != ESP_OK ||
+        (err = pcnt_new_channel(unit, &chan_clk_config, &chan_clk)) != ESP_OK ||
+        (err = pcnt_channel_set_edge_action(chan_dt, PCNT_CHANNEL_EDGE_ACTION_DECREASE, PCNT_CHANNEL_EDGE_ACTION_INCREASE)) != ESP_OK ||
+        (err = pcnt_channel_set_level_action(chan_dt, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE)) != ESP_OK ||
+        (err = pcnt_channel_set_edge_action(chan_clk, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_DECREASE)) != ESP_OK ||
+        (err = pcnt_channel_set_level_action(chan_clk, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE)) != ESP_OK ||
+        (err = pcnt_unit_add_watch_point(unit, MOTORES_PCNT_HIGH_LIMIT)) != ESP_OK ||
+        (err = pcnt_unit_add_watch_point(unit, MOTORES_PCNT_LOW_LIMIT)) != ESP_OK ||
+        (err = pcnt_unit_register_event_callbacks(unit, &callbacks, m)) != ESP_OK ||
+        (err = pcnt_unit_enable(unit)) != ESP_OK ||
+        (err = pcnt_unit_clear_count(unit)) != ESP_OK ||
+        (err = pcnt_unit_start(unit)) != ESP_OK)
+    {
+        pcnt_unit_stop(unit);
+        pcnt_unit_disable(unit);
+        if (chan_clk)
+            pcnt_del_channel(chan_clk);
+        if (chan_dt)
+            pcnt_del_channel(chan_dt);
+        pcnt_del_unit(unit);
+        return err;
+    }
+
+    m->pcnt_unit = unit;
+    m->pcnt_offset = m->position;
+    m->encoder_mode = MOTORES_ENCODER_PCNT;
+    return ESP_OK;
+}
+
+/*
+ * Time-stamp the rising edges of the encoder A signal with an MCPWM capture
+ * channel, for motores_read_velocity(). A second, GPIO-less channel is
+ * soft-triggered to sample "now" on the same timer. No capture interrupt is
+ * used: the latched values are polled at control rate. On failure the
+ * estimate falls back to count differencing on esp_timer time.
+ */
+static inline esp_err_t motores_setup_velocity(struct motores *m, uint32_t resolution_hz)
+{
+    mcpwm_capture_timer_config_t timer_config = {0};
+    timer_config.group_id = 0;
+    timer_config.clk_src = MCPWM_CAPTURE_CLK_SRC_DEFAULT;
+    timer_config.resolution_hz = resolution_hz;
+    mcpwm_cap_timer_handle_t timer = NULL;
+    esp_err_t err = mcpwm_new_capture_timer(&timer_config, &timer);
+    if (err != ESP_OK)
+        return err;
+
+    mcpwm_capture_channel_config_t edge_config = {0};
+    edge_config.gpio_num = m->dt;
+    edge_config.prescale = 1;
+    edge_config.flags.pos_edge = 1;
+    mcpwm_capture_channel_config_t now_config = {0};
+    now_config.gpio_num = -1;
+    now_config.prescale = 1;
+    mcpwm_cap_channel_handle_t edge = NULL;
+    mcpwm_cap_channel_handle_t now = NULL;
+    uint32_t resolution = 0;
+
+    if ((err = mcpwm_new_capture_channel(timer, &edge_config, &edge)) != ESP_OK ||
+        (err = mcpwm_new_capture_channel(timer, &now_config, &now)) != ESP_OK ||
+        (err = mcpwm_capture_channel_enable(edge)) != ESP_OK ||
+        (err = mcpwm_capture_channel_enable(now)) != ESP_OK ||
+        (err = mcpwm_capture_timer_enable(timer)) != ESP_OK ||
+        (err = mcpwm_capture_timer_start(timer)) != ESP_OK ||
+        (err = mcpwm_capture_timer_get_resolution(timer, &resolution)) != ESP_OK)
+    {
+        if (now)
+        {
+            mcpwm_capture_channel_disable(now);
+            mcpwm_del_capture_channel(now);
+        }
+        if (edge)
+        {
+            mcpwm_capture_channel_disable(edge);
+            mcpwm_del_capture_channel(edge);
+        }
+        mcpwm_capture_timer_disable(timer);
+        mcpwm_del_capture_timer(timer);
+        return err;
+    }
+
+    m->vel.timer = timer;
+    m->vel.edge = edge;
+    m->vel.now = now;
+    m->vel.resolution_hz = resolution;
+    mcpwm_capture_channel_trigger_soft_catch(now);
+    mcpwm_capture_get_latched_value(now, &m->vel.last_time);
+    m->vel.last_edge = m->vel.last_time;
+    return ESP_OK;
+}
+
+/*
+ * Time-stamp the encoder A edges of m on the capture timer of owner, already
+ * set up with motores_setup_velocity(). Only one capture channel is used per
+ * extra motor: the timer and the soft-triggered "now" channel are shared, so
+ * a capture group serves as many encoders as it has free channels. On
+ * failure m keeps the count differencing estimate.
+ */
+static inline esp_err_t motores_share_velocity(struct motores *m, const struct motores *owner)
+{
+    if (owner->vel.timer == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    mcpwm_capture_channel_config_t edge_config = {0};
+    edge_config.gpio_num = m->dt;
+    edge_config.prescale = 1;
+    edge_config.flags.pos_edge = 1;
+    mcpwm_cap_channel_handle_t edge = NULL;
+    esp_err_t err = mcpwm_new_capture_channel(owner->vel.timer, &edge_config, &edge);
+    if (err != ESP_OK)
+        return err;
+    if ((err = mcpwm_capture_channel_enable(edge)) != ESP_OK)
+    {
+        mcpwm_del_capture_channel(edge);
+        return err;
+    }
+
+    m->vel.timer = owner->vel.timer;
+    m->vel.edge = edge;
+    m->vel.now = owner->vel.now;
+    m->vel.resolution_hz = owner->vel.resolution_hz;
+    mcpwm_capture_channel_trigger_soft_catch(m->vel.now);
+    mcpwm_capture_get_latched_value(m->vel.now, &m->vel.last_time);
+    m->vel.last_edge = m->vel.last_time;
+    return ESP_OK;
+}
+
+/* Steps counted per full cycle of encoder A */
+static inline int motores_steps_per_cycle(const struct motores *m)
+{
+    return (m->encoder_mode == MOTORES_ENCODER_PCNT) ? 4 : 2;
+}
+
+/* Current time on the velocity time base (capture timer ticks, or esp_timer us) */
+static inline uint32_t motores_velocity_now(struct motores *m)
+{
+    uint32_t now = 0;
+    if (m->vel.now != NULL &&
+        mcpwm_capture_channel_trigger_soft_catch(m->vel.now) == ESP_OK &&
+        mcpwm_capture_get_latched_value(m->vel.now, &now) == ESP_OK)
+        return now;
+    return (uint32_t)esp_timer_get_time();
+}
+
+/*
+ * Unclamped position count: unlike motores_read_position() it keeps moving
+ * past the travel limits, so differences are true displacements.
+ */
+static inline int motores_raw_count(struct motores *m)
+{
+    if (m->encoder_mode == MOTORES_ENCODER_PCNT)
+    {
+        int count = 0;
+        pcnt_unit_get_count(m->pcnt_unit, &count);
+        return count + m->pcnt_offset;
+    }
+    return m->position;
+}
+
+/*
+ * Update and return the velocity estimate in steps/s (positive towards
+ * max_pos). Call once per control period. Two estimators are combined:
+ * - High speed (MOTORES_VEL_MIN_COUNTS or more steps since the last call, or
+ *   no capture channel): count difference over the measured elapsed time.
+ * - Low speed: period between the two most recent captured rising edges of
+ *   encoder A, i.e. one full quadrature cycle, which resolves speeds far
+ *   below one step per control period. While no new edge arrives the
+ *   estimate is bounded by one cycle over the time since the last edge and
+ *   drops to zero after MOTORES_VEL_TIMEOUT_S.
+ */
+static inline float motores_read_velocity(struct motores *m)
+{
+    /* Edge first, then now: the time since the last edge can never come out negative */
+    uint32_t edge = m->vel.last_edge;
+    if (m->vel.edge != NULL)
+        mcpwm_capture_get_latched_value(m->vel.edge, &edge);
+    int count = motores_raw_count(m);
+    uint32_t now = motores_velocity_now(m);
+    uint32_t elapsed_ticks = now - m->vel.last_time;
+    if (elapsed_ticks == 0)
+        return m->vel.velocity;
+
+    int delta = count - m->vel.last_count;
+    if (delta != 0)
+        m->vel.direction = (delta > 0) ? 1 : -1;
+    float resolution = (float)m->vel.resolution_hz;
+    int steps = motores_steps_per_cycle(m);
+
+    float velocity;
+    if (m->vel.edge == NULL || abs(delta) >= MOTORES_VEL_MIN_COUNTS)
+    {
+        velocity = delta * resolution / elapsed_ticks;
+    }
+    else if (edge != m->vel.last_edge)
+    {
+        /* New edge(s) this period: the previous latched edge bounds the cycle(s) counted */
+        int cycles = (abs(delta) + steps / 2) / steps;
+        if (cycles < 1)
+            cycles = 1;
+        velocity = m->vel.direction * (float)(cycles * steps) * resolution / (float)(edge - m->vel.last_edge);
+    }
+    else
+    {
+        float since = (float)(now - edge) / resolution;
+        float bound = steps / since;
+        if (since >= MOTORES_VEL_TIMEOUT_S)
+            velocity = 0;
+        else if (fabsf(m->vel.velocity) > bound)
+            velocity = m->vel.direction * bound;
+        else
+            velocity = m->vel.velocity;
+    }
+
+    m->vel.last_count = count;
+    m->vel.last_time = now;
+    m->vel.last_edge = edge;
+    m->vel.velocity = velocity;
+    return velocity;
+}
+
+/*
+ * Software x2 decoding, called from the encoder GPIO interrupt. It runs with
+ * the flash cache disabled (IRAM-safe ISR), so it lives in IRAM and reads the
+ * pins through the LL layer: gpio_get_level() is flash resident.
+ */
+static inline void IRAM_ATTR motores_step(struct motores *m)
 {
-    bool A = gpio_get_level(m->dt);
-    bool B = gpio_get_level(m->clk);
+    bool A = gpio_ll_get_level(&GPIO, m->dt);
+    bool B = gpio_ll_get_level(&GPIO, m->clk);
 
     if (A != m->last_state)
     {
@@ -119,60 +618,154 @@ static inline void motores_step(struct motores *m)
         }
     }
 
-    if (m->until && (m->position == m->objective))
-    {
-        m->until = false;
-        ledc_set_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel, 0);
-        ledc_update_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel);
-    }
+    if (m->target_armed && (m->position == m->objective))
+        motores_cut_drive_isr(m);
 
     m->last_state = A;
 }
 
 static inline uint16_t motores_read_position(struct motores *m)
 {
+    if (m->encoder_mode == MOTORES_ENCODER_PCNT)
+    {
+        int count = 0;
+        pcnt_unit_get_count(m->pcnt_unit, &count);
+        int position = count + m->pcnt_offset;
+        if (position < m->min_pos)
+            position = m->min_pos;
+        else if (position > m->max_pos)
+            position = m->max_pos;
+        m->position = (uint16_t)position;
+    }
     return m->position;
 }
 
 static inline void motores_set_position(struct motores *m, uint16_t position)
 {
+    if (m->encoder_mode == MOTORES_ENCODER_PCNT)
+    {
+        /* Restart the raw count at zero so watch points stay inside the PCNT limits */
+        pcnt_unit_clear_count(m->pcnt_unit);
+        m->pcnt_offset = position;
+    }
     m->position = position;
+    /* Keep the velocity estimate continuous across the new origin */
+    m->vel.last_count = position;
+    /* Any armed objective refers to the old position: re-arm on the next start */
+    m->target_armed = false;
+    m->until = false;
+    m->profile.active = false;
+}
+
+/* Serialises the count snapshot, watch point and clear of motores_arm_target() */
+static portMUX_TYPE motores_pcnt_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/*
+ * Arm the hardware stop for m->objective. In PCNT mode the objective becomes
+ * a watch point, and the hardware only compares a new watch point after the
+ * count is cleared. So, with interrupts masked, the watch point is placed on
+ * the objective relative to the count snapshot, the count is read again and
+ * cleared straight away, and the snapshot is folded into pcnt_offset. If the
+ * motor moved while the watch point was added, the watch point is dropped
+ * and the count is left alone (polling then stops the motor). This keeps
+ * the new frame exact. Only an edge between the second read and the clear
+ * is lost, a window of a few bus accesses, far shorter than the filtered
+ * encoder period.
+ */
+static inline void motores_arm_target(struct motores *m)
+{
+    m->target_armed = false;
+    m->target_reached = false;
+
+    if (m->encoder_mode == MOTORES_ENCODER_PCNT)
+    {
+        if (m->pcnt_target_set)
+            pcnt_unit_remove_watch_point(m->pcnt_unit, m->pcnt_target);
+        m->pcnt_target_set = false;
+
+        int count = 0;
+        int recount = 0;
+        bool armed = false;
+        portENTER_CRITICAL(&motores_pcnt_lock);
+        pcnt_unit_get_count(m->pcnt_unit, &count);
+        /* Raw target once the count restarts at zero */
+        m->pcnt_target = (int)m->objective - m->pcnt_offset - count;
+        if (m->pcnt_target != 0 && m->pcnt_target > MOTORES_PCNT_LOW_LIMIT && m->pcnt_target < MOTORES_PCNT_HIGH_LIMIT &&
+            pcnt_unit_add_watch_point(m->pcnt_unit, m->pcnt_target) == ESP_OK)
+        {
+            pcnt_unit_get_count(m->pcnt_unit, &recount);
+            if (recount == count)
+            {
+                pcnt_unit_clear_count(m->pcnt_unit);
+                m->pcnt_offset += count;
+                armed = true;
+            }
+            else
+            {
+                pcnt_unit_remove_watch_point(m->pcnt_unit, m->pcnt_target);
+            }
+        }
+        portEXIT_CRITICAL(&motores_pcnt_lock);
+        if (!armed)
+        {
+            /* Objective already reached, beyond the counter range, no free watch point or moved meanwhile: rely on polling */
+            if (m->pcnt_target != 0)
+                m->target_missed++;
+            return;
+        }
+        m->pcnt_target_set = true;
+    }
+
+    m->target_armed = true;
+}
+
+/*
+ * Complete a stop that was started from interrupt context: zero the duty
+ * and wake the driver again so it is ready for the next command.
+ */
+static inline void motores_finish_target(struct motores *m)
+{
+    m->target_reached = false;
+    m->until = false;
+    /* The duty must be zero before the driver wakes up: no waiting for the batch commit,
+       and one PWM period for the LEDC to take it, as on a reversal */
+    motores_set_duty(m, 0);
+    if (motores_commit_duty(m))
+        esp_rom_delay_us(MOTORES_PWM_PERIOD_US);
+    gpio_set_level(m->sleep, 1);
 }
 
 static inline bool motores_start_rotation(struct motores *m, bool direction, uint16_t velocity)
 {
     bool arrivedToLimit = false;
+    uint16_t position = motores_read_position(m);
 
     if (direction == ABRIR)
     {
-        if (m->position > m->min_pos)
+        if (position > m->min_pos)
         {
-            ledc_set_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel, velocity);
-            ledc_update_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel);
-            gpio_set_level(m->ph, direction);
+            motores_set_duty(m, velocity);
+            motores_set_direction(m, direction);
             arrivedToLimit = false;
         }
         else
         {
             arrivedToLimit = true;
-            ledc_set_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel, 0);
-            ledc_update_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel);
+            motores_set_duty(m, 0);
         }
     }
     else
     {
-        if (m->position < m->max_pos)
+        if (position < m->max_pos)
         {
-            ledc_set_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel, velocity);
-            ledc_update_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel);
-            gpio_set_level(m->ph, direction);
+            motores_set_duty(m, velocity);
+            motores_set_direction(m, direction);
             arrivedToLimit = false;
         }
         else
         {
             arrivedToLimit = true;
-            ledc_set_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel, 0);
-            ledc_update_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel);
+            motores_set_duty(m, 0);
         }
     }
     return arrivedToLimit;
@@ -182,13 +775,21 @@ static inline bool motores_start_until(struct motores *m, bool direction, uint16
 {
     bool arrivedToObjective = false;
     bool arrivedToLimit = false;
+
+    if (m->target_reached)
+        motores_finish_target(m);
+
+    uint16_t position = motores_read_position(m);
+    bool rearm = !m->until || (m->objective != objective);
     m->objective = objective;
     m->until = true;
 
     if (direction == ABRIR)
     {
-        if (m->position > m->objective)
+        if (position > m->objective)
         {
+            if (rearm)
+                motores_arm_target(m);
             arrivedToLimit = motores_start_rotation(m, direction, velocity);
             arrivedToObjective = false;
         }
@@ -196,14 +797,19 @@ static inline bool motores_start_until(struct motores *m, bool direction, uint16
         {
             arrivedToObjective = true;
             m->until = false;
-            ledc_set_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel, 0);
-            ledc_update_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel);
+            /* Still armed: polling got here before the hardware stop */
+            if (m->target_armed)
+                m->target_missed++;
+            m->target_armed = false;
+            motores_set_duty(m, 0);
         }
     }
     else
     {
-        if (m->position < m->objective)
+        if (position < m->objective)
         {
+            if (rearm)
+                motores_arm_target(m);
             arrivedToLimit = motores_start_rotation(m, direction, velocity);
             arrivedToObjective = false;
         }
@@ -211,8 +817,11 @@ static inline bool motores_start_until(struct motores *m, bool direction, uint16
         {
             arrivedToObjective = true;
             m->until = false;
-            ledc_set_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel, 0);
-            ledc_update_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel);
+            /* Still armed: polling got here before the hardware stop */
+            if (m->target_armed)
+                m->target_missed++;
+            m->target_armed = false;
+            motores_set_duty(m, 0);
         }
     }
     return (arrivedToObjective || arrivedToLimit);
@@ -220,8 +829,158 @@ static inline bool motores_start_until(struct motores *m, bool direction, uint16
 
 static inline void motores_stop_rotation(struct motores *m)
 {
+    m->profile.active = false;
     m->until = false;
-    ledc_set_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel, 0);
-    ledc_update_duty(LEDC_LOW_SPEED_MODE, m->pwm_channel);
+    m->target_armed = false;
+    if (m->target_reached)
+        motores_finish_target(m);
+    motores_set_duty(m, 0);
+}
+ 
+
+/*
+ * Configure the closed-loop mode. dt is the period at which
+ * motores_profile_update() will be called; the loop assumes it is fixed.
+ */
+static inline void motores_profile_setup(struct motores *m, float kp, float ki, float kff, float kv, float dt, uint16_t tolerance)
+{
+    m->pid.kp = kp;
+    m->pid.ki = ki;
+    m->pid.kff = kff;
+    m->pid.kv = kv;
+    m->pid.dt = dt;
+    m->pid.tolerance = tolerance;
+    m->profile.active = false;
+}
+
+/*
+ * Apply a signed command: positive closes (towards max_pos), negative opens.
+ * The drive is never pushed further into a travel limit.
+ */
+static inline void motores_apply_command(struct motores *m, float u, uint16_t position)
+{
+    bool direction = (u >= 0) ? CERRAR : ABRIR;
+    float magnitude = fabsf(u);
+    uint32_t duty = (magnitude >= MOTORES_DUTY_MAX) ? MOTORES_DUTY_MAX : (uint32_t)(magnitude + 0.5f);
+
+    if ((direction == CERRAR && position >= m->max_pos) || (direction == ABRIR && position <= m->min_pos))
+        duty = 0;
+
+    motores_set_direction(m, direction);
+    motores_set_duty(m, duty);
+}
+
+/*
+ * Request a move to target with speed limited to v_max (steps/s) and
+ * acceleration to a_max (steps/s^2). Repeating the same request is a no-op;
+ * a new target while moving keeps the current reference velocity, so the
+ * reference decelerates (and reverses if needed) without a jump.
+ */
+static inline void motores_profile_request(struct motores *m, uint16_t target, float v_max, float a_max)
+{
+    if (target > m->max_pos)
+        target = m->max_pos;
+    else if (target < m->min_pos)
+        target = m->min_pos;
+
+    /* The closed loop owns the drive: drop any bang-bang objective */
+    if (m->target_reached)
+        motores_finish_target(m);
+    m->until = false;
+    m->target_armed = false;
+
+    if (!m->profile.active)
+    {
+        uint16_t position = motores_read_position(m);
+        if (abs((int)target - (int)position) <= m->pid.tolerance)
+        {
+            /* Already there: nothing to track, keep the drive off */
+            m->profile.target = target;
+            motores_set_duty(m, 0);
+            return;
+        }
+        m->profile.pos_ref = position;
+        m->profile.vel_ref = 0;
+        m->profile.integral = 0;
+    }
+    else if (m->profile.target != target)
+    {
+        m->profile.integral = 0;
+    }
+    m->profile.target = target;
+    m->profile.v_max = v_max;
+    m->profile.a_max = a_max;
+    m->profile.active = true;
+}
+
+/*
+ * One fixed-rate step of the closed loop: advance the trapezoidal reference
+ * by pid.dt and drive the motor with PI on the position error plus
+ * feed-forward of the reference velocity and a velocity error term on the
+ * estimate from the last motores_read_velocity(). The reference follows
+ * v = min(v_max, sqrt(2 * a_max * remaining)) with |dv| <= a_max * dt, i.e.
+ * accelerate, cruise, then brake at a_max to stop exactly on the target.
+ * Returns true (with the drive off) once the reference has stopped on the
+ * target and the position is within pid.tolerance of it.
+ */
+static inline bool motores_profile_update(struct motores *m)
+{
+    if (!m->profile.active)
+        return true;
+
+    float dt = m->pid.dt;
+    float target = m->profile.target;
+    float remaining = target - m->profile.pos_ref;
+    float dv = m->profile.a_max * dt;
+    float v_des = sqrtf(2.0f * m->profile.a_max * fabsf(remaining));
+    if (v_des > m->profile.v_max)
+        v_des = m->profile.v_max;
+    if (remaining < 0)
+        v_des = -v_des;
+
+    if (v_des > m->profile.vel_ref + dv)
+        m->profile.vel_ref += dv;
+    else if (v_des < m->profile.vel_ref - dv)
+        m->profile.vel_ref -= dv;
+    else
+        m->profile.vel_ref = v_des;
+
+    m->profile.pos_ref += m->profile.vel_ref * dt;
+    if ((remaining >= 0 && m->profile.pos_ref >= target) || (remaining < 0 && m->profile.pos_ref <= target))
+    {
+        /* Never let the reference overshoot; it is done once it lands on the target */
+        m->profile.pos_ref = target;
+        m->profile.vel_ref = 0;
+    }
+
+    uint16_t position = motores_read_position(m);
+    float error = m->profile.pos_ref - position;
+    bool reference_done = (m->profile.pos_ref == target) && (m->profile.vel_ref == 0);
+
+    if (reference_done && fabsf(target - position) <= m->pid.tolerance)
+    {
+        m->profile.active = false;
+        motores_set_duty(m, 0);
+        return true;
+    }
+
+    float u = m->pid.kff * m->profile.vel_ref + m->pid.kp * error + m->pid.ki * m->profile.integral +
+              m->pid.kv * (m->profile.vel_ref - m->vel.velocity);
+
+    /* Anti-windup: only integrate while the output is not saturated in the error's direction */
+    if (fabsf(u) < MOTORES_DUTY_MAX || (u > 0) != (error > 0))
+        m->profile.integral += error * dt;
+
+    motores_apply_command(m, u, position);
+    return false;
+}
+
+/*
+ * Convenience for fixed-rate callers: request (or keep) the move towards
+ * target and run one control step. Returns true once arrived.
+ */
+static inline bool motores_move_to(struct motores *m, uint16_t target, float v_max, float a_max)
+{
+    motores_profile_request(m, target, v_max, a_max);
+    return motores_profile_update(m);
 }
- 
\ No newline at end of file
@@ -0,0 +1,196 @@
+/**
+ * @file muestreo_emg.h
+ * @brief Adquisición continua de la señal EMG mediante el ADC en modo DMA.
+ * @details
+ * El ADC recorre los canales de @ref CANALES_EMG, cada uno a @ref SAMPLING_FREQ marcado por
+ * hardware, en un único flujo DMA que entrega tramas de @ref ANILLO_MUESTRAS_POR_BLOQUE
+ * conversiones por canal, intercaladas en el orden del patrón. Cada trama completa genera una
+ * única interrupción que la separa por canales directamente en un hueco de @ref anilloEMG (una
+ * fila por canal) y notifica a la tarea de procesado, que lee los bloques en el propio anillo
+ * mientras el DMA llena los siguientes. El número de interrupciones y de notificaciones por
+ * segundo no depende del número de canales.
+ *
+ * Al estar el ritmo de muestreo fijado por hardware, el intervalo entre muestras es constante
+ * (1 / @ref SAMPLING_FREQ) y no es necesario guardar la diferencia de tiempo de cada muestra.
+ *
+ * @note @ref EMGPin (GPIO15) pertenece al ADC2. En el ESP32-S3 el modo continuo sobre ADC2 requiere
+ * `CONFIG_ADC_CONTINUOUS_FORCE_USE_ADC2_ON_C3_S3` (no compatible con el uso simultáneo de WiFi).
+ * Los demás electrodos deben estar en la misma unidad (GPIO11–20 en el ADC2).
+ */
+
+#pragma once
+
+#include "esp_attr.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_adc/adc_continuous.h"
+#include "globales.h"
+#include "anillo_bloques.h"
+#include "perfilado.h"
+
+#define MUESTREO_BYTES_POR_BLOQUE (ANILLO_MUESTRAS_POR_BLOQUE * NUMERO_CANALES_EMG * SOC_ADC_DIGI_RESULT_BYTES) ///< Tamaño en bytes de una trama DMA (un bloque de muestras de todos los canales).
+
+_Static_assert(NUMERO_CANALES_EMG <= SOC_ADC_PATT_LEN_MAX, "Hay más canales EMG que entradas en el patrón del ADC");
+
+// ==========================
+//   Bloques de muestras
+// ==========================
+struct anillo_bloques anilloEMG;         ///< Anillo SPSC de bloques de muestras EMG crudas.
+volatile uint32_t muestrasInvalidas = 0; ///< Conversiones descartadas (canal distinto del esperado en esa posición del patrón).
+int64_t tiempoCapturaEMG[ANILLO_NUM_BLOQUES]; ///< Instante (µs) en que el DMA completó cada hueco de @ref anilloEMG: el de su última muestra.
+
+adc_continuous_handle_t adcMuestreo = NULL;     ///< Manejador del ADC en modo continuo.
+TaskHandle_t tareaMuestreo = NULL;             ///< Tarea que recibe una notificación por bloque completado.
+adc_channel_t canalesEMG[NUMERO_CANALES_EMG];  ///< Canal ADC de cada electrodo de @ref CANALES_EMG.
+
+#define MUESTREO_PIN(id, pin) [id] = (pin),
+static const int pinesEMG[NUMERO_CANALES_EMG] = {CANALES_EMG(MUESTREO_PIN)}; ///< GPIO de cada electrodo (solo se lee al iniciar).
+
+/**
+ * @brief Callback del ADC al completar una trama DMA.
+ * @details
+ * Separa la trama por canales en el siguiente hueco libre de @ref anilloEMG, anota su instante de
+ * captura en @ref tiempoCapturaEMG y notifica a @ref tareaMuestreo. La conversión `i` de la trama es la muestra `i / NUMERO_CANALES_EMG` del canal
+ * `i % NUMERO_CANALES_EMG`, que es el orden del patrón. Las conversiones de otro canal se sustituyen
+ * por la última muestra válida de su fila para no romper el ritmo. Si el consumidor no ha liberado
+ * ningún hueco la trama se pierde y queda contada en el anillo.
+ */
+static bool IRAM_ATTR muestreo_trama_completa(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data)
+{
+  PERFIL_INICIO(PERFIL_MUESTREO);
+  static uint16_t ultimaMuestra[NUMERO_CANALES_EMG];
+  uint16_t *bloque = anillo_reservar(&anilloEMG);
+  if (bloque == NULL)
+  {
+    // También se mide la trama perdida: es justo el caso de sobrecarga
+    PERFIL_FIN(PERFIL_MUESTREO);
+    return false;
+  }
+  uint32_t n = edata->size / SOC_ADC_DIGI_RESULT_BYTES;
+
+  uint32_t i = 0;
+  for (uint32_t k = 0; k < ANILLO_MUESTRAS_POR_BLOQUE; k++)
+  {
+    for (uint32_t c = 0; c < NUMERO_CANALES_EMG; c++, i++)
+    {
+      if (i < n)
+      {
+        const adc_digi_output_data_t *dato = (const adc_digi_output_data_t *)&edata->conv_frame_buffer[i * SOC_ADC_DIGI_RESULT_BYTES];
+        if (dato->type2.channel == canalesEMG[c])
+        {
+          ultimaMuestra[c] = dato->type2.data;
+        }
+        else
+        {
+          muestrasInvalidas++;
+        }
+      }
+      ANILLO_CANAL(bloque, c)[k] = ultimaMuestra[c];
+    }
+  }
+  tiempoCapturaEMG[anillo_hueco(&anilloEMG, bloque)] = esp_timer_get_time();
+  anillo_publicar(&anilloEMG);
+
+  BaseType_t despertar = pdFALSE;
+  vTaskNotifyGiveFromISR(tareaMuestreo, &despertar);
+  PERFIL_FIN(PERFIL_MUESTREO);
+  return despertar == pdTRUE;
+}
+
+/**
+ * @brief Configura y arranca el muestreo continuo de los canales de @ref CANALES_EMG.
+ * @param tarea Tarea que procesará los bloques (recibe una notificación por bloque).
+ * @details El patrón tiene una entrada por canal y el ADC convierte a
+ * `SAMPLING_FREQ · NUMERO_CANALES_EMG`, de modo que cada canal queda muestreado a @ref SAMPLING_FREQ.
+ * @return `ESP_OK` si el ADC ha arrancado, `ESP_ERR_INVALID_ARG` si los electrodos no están todos en
+ * la misma unidad ADC, o el error del driver en caso contrario.
+ */
+esp_err_t muestreo_iniciar(TaskHandle_t tarea)
+{
+  adc_unit_t unidad = ADC_UNIT_1;
+  adc_digi_pattern_config_t patrones[NUMERO_CANALES_EMG] = {0};
+  for (int c = 0; c < NUMERO_CANALES_EMG; c++)
+  {
+    adc_unit_t unidadCanal;
+    esp_err_t err = adc_continuous_io_to_channel(pinesEMG[c], &unidadCanal, &canalesEMG[c]);
+    if (err != ESP_OK)
+    {
+      return err;
+    }
+    // Un único flujo DMA en modo de una unidad: no se pueden mezclar ADC1 y ADC2
+    if (c == 0)
+    {
+      unidad = unidadCanal;
+    }
+    else if (unidadCanal != unidad)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+    patrones[c].atten = ADC_ATTEN_DB_12;
+    patrones[c].channel = canalesEMG[c];
+    patrones[c].unit = unidad;
+    patrones[c].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+  }
+
+  tareaMuestreo = tarea;
+
+  adc_continuous_handle_cfg_t handle_cfg = {0};
+  handle_cfg.max_store_buf_size = 2 * MUESTREO_BYTES_POR_BLOQUE;
+  handle_cfg.conv_frame_size = MUESTREO_BYTES_POR_BLOQUE;
+  handle_cfg.flags.flush_pool = 1; // Los datos se consumen en el callback, el pool interno no se lee
+  esp_err_t err = adc_continuous_new_handle(&handle_cfg, &adcMuestreo);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+
+  adc_continuous_config_t dig_cfg = {0};
+  dig_cfg.sample_freq_hz = SAMPLING_FREQ * NUMERO_CANALES_EMG;
+  dig_cfg.conv_mode = (unidad == ADC_UNIT_1) ? ADC_CONV_SINGLE_UNIT_1 : ADC_CONV_SINGLE_UNIT_2;
+  dig_cfg.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+  dig_cfg.pattern_num = NUMERO_CANALES_EMG;
+  dig_cfg.adc_pattern = patrones;
+  err = adc_continuous_config(adcMuestreo, &dig_cfg);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+
+  adc_continuous_evt_cbs_t cbs = {0};
+  cbs.on_conv_done = muestreo_trama_completa;
+  err = adc_continuous_register_event_callbacks(adcMuestreo, &cbs, NULL);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+
+  return adc_continuous_start(adcMuestreo);
+}
+
+/**
+ * @brief Espera a que haya un bloque de muestras pendiente.
+ * @param espera Tiempo máximo de espera en ticks.
+ * @return Puntero, dentro de @ref anilloEMG, al bloque pendiente más antiguo (una fila de
+ * @ref ANILLO_MUESTRAS_POR_BLOQUE muestras por canal, ver @ref ANILLO_CANAL), o `NULL` si vence la espera.
+ * @warning El bloque sigue reservado para el consumidor hasta llamar a @ref muestreo_liberar_bloque.
+ */
+const uint16_t *muestreo_esperar_bloque(TickType_t espera)
+{
+  if (anillo_pendientes(&anilloEMG) == 0)
+  {
+    ulTaskNotifyTake(pdTRUE, espera);
+    if (anillo_pendientes(&anilloEMG) == 0)
+    {
+      return NULL;
+    }
+  }
+  return anillo_bloque(&anilloEMG, 0);
+}
+
+/**
+ * @brief Libera el bloque obtenido con @ref muestreo_esperar_bloque para que el DMA pueda reutilizarlo.
+ */
+void muestreo_liberar_bloque()
+{
+  anillo_liberar(&anilloEMG);
+}
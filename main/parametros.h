@@ -0,0 +1,270 @@
+/**
+ * @file parametros.h
+ * @brief Parámetros ajustables en marcha (umbrales, velocidades, cierre) sin recompilar ni bloquear el control.
+ * @details
+ * Los parámetros de @ref PARAMETROS_AJUSTABLES viven en un bloque @ref parametros_ajustables con
+ * dos copias. La tarea de control lee siempre la vigente a través de @ref parametrosControl, un
+ * puntero normal que solo cambia ella misma al empezar cada periodo (@ref parametros_confirmar):
+ * un periodo entero ve el mismo bloque, sin cerrojos ni accesos atómicos en el camino caliente.
+ *
+ * Para cambiar parámetros, un editor (el comando `param`, la calibración, la restauración de NVS):
+ * 1. Pide la copia libre con @ref parametros_editar, que la rellena con los valores vigentes.
+ * 2. Modifica los campos que quiera.
+ * 3. La deja pendiente con @ref parametros_publicar (o la descarta con @ref parametros_cancelar).
+ *
+ * El cambio se aplica entero al principio del siguiente periodo de control, cuando
+ * @ref parametros_confirmar intercambia los punteros. Hasta entonces no se puede editar otra vez:
+ * la copia que el control acaba de dejar solo queda libre después de ese periodo. Un único
+ * indicador (@ref parametrosOcupados) excluye entre sí a los editores y a los lectores de otras
+ * tareas (@ref parametros_copiar); nadie espera en él, quien lo encuentra ocupado lo intenta
+ * más tarde.
+ *
+ * @note Los coeficientes de los filtros y la configuración del muestreo no están aquí: se calculan
+ * para @ref SAMPLING_FREQ al compilar y cambiarlos obliga a reiniciar el ADC.
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_console.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "globales.h"
+
+#define PARAMETROS_ESPERA_MS 100 ///< Tiempo máximo que el comando `param` espera a que se confirme un cambio anterior.
+
+/**
+ * @struct parametros_ajustables
+ * @brief Un valor por cada entrada de @ref PARAMETROS_AJUSTABLES.
+ */
+struct parametros_ajustables
+{
+#define PARAMETRO_CAMPO(campo, nombre, inicial, minimo, maximo, descripcion) float campo;
+  PARAMETROS_AJUSTABLES(PARAMETRO_CAMPO)
+#undef PARAMETRO_CAMPO
+};
+
+/**
+ * @struct descriptor_parametro
+ * @brief Nombre, posición en @ref parametros_ajustables y rango de un parámetro.
+ */
+struct descriptor_parametro
+{
+  const char *nombre;      ///< Nombre en el comando `param`.
+  size_t desplazamiento;   ///< `offsetof` del campo.
+  float minimo;            ///< Valor mínimo admitido.
+  float maximo;            ///< Valor máximo admitido.
+  const char *descripcion; ///< Texto de ayuda.
+};
+
+static const struct descriptor_parametro descriptoresParametros[] = {
+#define PARAMETRO_DESCRIPTOR(campo, nombre, inicial, minimo, maximo, descripcion) \
+  {nombre, offsetof(struct parametros_ajustables, campo), minimo, maximo, descripcion},
+  PARAMETROS_AJUSTABLES(PARAMETRO_DESCRIPTOR)
+#undef PARAMETRO_DESCRIPTOR
+};
+
+#define NUMERO_PARAMETROS (sizeof(descriptoresParametros) / sizeof(descriptoresParametros[0])) ///< Entradas de @ref PARAMETROS_AJUSTABLES.
+
+_Static_assert(sizeof(struct parametros_ajustables) == NUMERO_PARAMETROS * sizeof(float), "parametros_ajustables debe ser un vector de float");
+
+struct parametros_ajustables bufferParametros[2] = {
+  {
+#define PARAMETRO_INICIAL(campo, nombre, inicial, minimo, maximo, descripcion) .campo = inicial,
+    PARAMETROS_AJUSTABLES(PARAMETRO_INICIAL)
+#undef PARAMETRO_INICIAL
+  },
+}; ///< Las dos copias del bloque. La primera arranca con los valores iniciales.
+
+const struct parametros_ajustables *parametrosControl = &bufferParametros[0];              ///< Copia que usa la tarea de control; solo la cambia @ref parametros_confirmar.
+_Atomic(struct parametros_ajustables *) parametrosVigentes = &bufferParametros[0];         ///< Copia vigente, para editores y lectores de otras tareas.
+_Atomic(struct parametros_ajustables *) parametrosPendientes = NULL;                       ///< Copia publicada a la espera del siguiente periodo de control (`NULL` si no hay).
+atomic_bool parametrosOcupados = false;                                                    ///< Hay un editor o un lector de otra tarea usando las copias.
+
+/**
+ * @brief Toma la copia libre para modificarla, con los valores vigentes.
+ * @return La copia, o `NULL` si hay otro editor o un cambio anterior sin confirmar todavía.
+ * Cada copia obtenida debe terminar en @ref parametros_publicar o @ref parametros_cancelar.
+ */
+struct parametros_ajustables *parametros_editar()
+{
+  if (atomic_exchange_explicit(&parametrosOcupados, true, memory_order_acquire))
+  {
+    return NULL;
+  }
+  if (atomic_load_explicit(&parametrosPendientes, memory_order_acquire) != NULL)
+  {
+    atomic_store_explicit(&parametrosOcupados, false, memory_order_release);
+    return NULL;
+  }
+  struct parametros_ajustables *vigentes = atomic_load_explicit(&parametrosVigentes, memory_order_acquire);
+  struct parametros_ajustables *libre = (vigentes == &bufferParametros[0]) ? &bufferParametros[1] : &bufferParametros[0];
+  *libre = *vigentes;
+  return libre;
+}
+
+/**
+ * @brief Deja la copia editada pendiente de que la confirme el siguiente periodo de control.
+ */
+void parametros_publicar(struct parametros_ajustables *p)
+{
+  atomic_store_explicit(&parametrosPendientes, p, memory_order_release);
+  atomic_store_explicit(&parametrosOcupados, false, memory_order_release);
+}
+
+/**
+ * @brief Descarta la copia editada sin publicarla.
+ */
+static inline void parametros_cancelar()
+{
+  atomic_store_explicit(&parametrosOcupados, false, memory_order_release);
+}
+
+/**
+ * @brief Aplica el cambio pendiente, si lo hay.
+ * @details La llama la tarea de control al principio de cada periodo, o cualquiera antes de que
+ * la tarea de control arranque.
+ */
+static inline void parametros_confirmar()
+{
+  struct parametros_ajustables *p = atomic_load_explicit(&parametrosPendientes, memory_order_acquire);
+  if (p == NULL)
+  {
+    return;
+  }
+  parametrosControl = p;
+  atomic_store_explicit(&parametrosVigentes, p, memory_order_release);
+  // Solo ahora puede un editor tomar la otra copia, que el control ya no lee
+  atomic_store_explicit(&parametrosPendientes, NULL, memory_order_release);
+}
+
+/**
+ * @brief Copia los parámetros vigentes desde una tarea que no es la de control.
+ * @return `false`, sin copiar nada, si un editor está usando las copias o hay un cambio sin
+ * confirmar: lo copiado sería más antiguo que lo ya publicado.
+ */
+bool parametros_copiar(struct parametros_ajustables *destino)
+{
+  if (atomic_exchange_explicit(&parametrosOcupados, true, memory_order_acquire))
+  {
+    return false;
+  }
+  if (atomic_load_explicit(&parametrosPendientes, memory_order_acquire) != NULL)
+  {
+    atomic_store_explicit(&parametrosOcupados, false, memory_order_release);
+    return false;
+  }
+  *destino = *atomic_load_explicit(&parametrosVigentes, memory_order_acquire);
+  atomic_store_explicit(&parametrosOcupados, false, memory_order_release);
+  return true;
+}
+
+/**
+ * @brief Busca un parámetro por su nombre en el comando `param`.
+ * @return Su descriptor, o `NULL` si no existe.
+ */
+static const struct descriptor_parametro *parametros_buscar(const char *nombre)
+{
+  for (size_t i = 0; i < NUMERO_PARAMETROS; i++)
+  {
+    if (strcmp(descriptoresParametros[i].nombre, nombre) == 0)
+    {
+      return &descriptoresParametros[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Comando `param`: sin argumentos lista los parámetros; con pares `nombre valor` los cambia.
+ * @details Todos los pares se validan antes de tocar nada y se publican juntos, así que el control
+ * los ve cambiar en el mismo periodo. Si hay otro cambio sin confirmar espera como mucho
+ * @ref PARAMETROS_ESPERA_MS.
+ */
+static int parametros_comando(int argc, char **argv)
+{
+  if (argc == 1)
+  {
+    struct parametros_ajustables actuales;
+    while (!parametros_copiar(&actuales))
+    {
+      vTaskDelay(1);
+    }
+    for (size_t i = 0; i < NUMERO_PARAMETROS; i++)
+    {
+      const struct descriptor_parametro *d = &descriptoresParametros[i];
+      printf("%-22s %14.6g  [%g, %g]  %s\n", d->nombre, *(const float *)((const char *)&actuales + d->desplazamiento),
+             d->minimo, d->maximo, d->descripcion);
+    }
+    return 0;
+  }
+  if (argc % 2 == 0)
+  {
+    printf("uso: param [nombre valor]...\n");
+    return 1;
+  }
+
+  float valores[NUMERO_PARAMETROS];
+  const struct descriptor_parametro *cambios[NUMERO_PARAMETROS];
+  int numCambios = 0;
+  for (int i = 1; i < argc; i += 2)
+  {
+    const struct descriptor_parametro *d = parametros_buscar(argv[i]);
+    if (d == NULL)
+    {
+      printf("parámetro desconocido: %s\n", argv[i]);
+      return 1;
+    }
+    char *fin;
+    float valor = strtof(argv[i + 1], &fin);
+    if (fin == argv[i + 1] || *fin != '\0' || !(valor >= d->minimo && valor <= d->maximo))
+    {
+      printf("%s: valor fuera de [%g, %g]: %s\n", d->nombre, d->minimo, d->maximo, argv[i + 1]);
+      return 1;
+    }
+    if (numCambios == (int)NUMERO_PARAMETROS)
+    {
+      printf("demasiados cambios\n");
+      return 1;
+    }
+    cambios[numCambios] = d;
+    valores[numCambios++] = valor;
+  }
+
+  struct parametros_ajustables *p;
+  for (TickType_t espera = 0; (p = parametros_editar()) == NULL; espera++)
+  {
+    if (espera >= pdMS_TO_TICKS(PARAMETROS_ESPERA_MS))
+    {
+      printf("parámetros ocupados, inténtalo de nuevo\n");
+      return 1;
+    }
+    vTaskDelay(1);
+  }
+  for (int i = 0; i < numCambios; i++)
+  {
+    *(float *)((char *)p + cambios[i]->desplazamiento) = valores[i];
+  }
+  parametros_publicar(p);
+  return 0;
+}
+
+/**
+ * @brief Registra el comando `param` en la consola (ver @ref consola.h).
+ */
+esp_err_t parametros_registrar_comando()
+{
+  const esp_console_cmd_t comando = {
+    .command = "param",
+    .help = "Muestra los parámetros ajustables o cambia los indicados, aplicados juntos en el siguiente periodo de control",
+    .hint = "[nombre valor]...",
+    .func = parametros_comando,
+  };
+  return esp_console_cmd_register(&comando);
+}
@@ -0,0 +1,257 @@
+/**
+ * @file perfilado.h
+ * @brief Sondas de ciclos por etapa con histogramas de latencia y el comando de consola `perf`.
+ * @details
+ * Cada etapa de @ref PERFIL_ETAPAS se mide con el contador de ciclos de la CPU
+ * (`esp_cpu_get_cycle_count()`): @ref PERFIL_INICIO y @ref PERFIL_FIN alrededor del código, o
+ * @ref PERFIL_PERIODO para el intervalo entre dos pasadas por el mismo punto. Con
+ * @ref PERFILADO a `0` las sondas no generan código.
+ *
+ * Cada medida se suma a un histograma de cubetas fijas, logarítmicas con
+ * @ref PERFIL_SUBCUBETAS subdivisiones por octava: los percentiles se dan por el extremo superior
+ * de su cubeta, con un error relativo menor de 1/@ref PERFIL_SUBCUBETAS. El mínimo, el máximo y
+ * la media son exactos.
+ *
+ * Cada etapa tiene un único productor (una tarea o una interrupción), así que las sondas no usan
+ * secciones críticas. El comando `perf` lee los histogramas sin detener a los productores (la
+ * instantánea puede mezclar medidas de dos periodos consecutivos) y pide su reinicio, que hace el
+ * propio productor en su siguiente medida.
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_console.h"
+#include "esp_cpu.h"
+#include "esp_err.h"
+#include "globales.h"
+
+/**
+ * @brief Etapas medidas, en orden: `ETAPA(id, nombre)`.
+ * @details Las etapas se solapan: @ref PERFIL_CARACTERISTICAS incluye las decisiones del bloque y
+ * @ref PERFIL_CONTROL todo el trabajo de un periodo del bucle de control. @ref PERFIL_EMG_A_PWM no
+ * es una etapa de código sino la latencia de extremo a extremo de @ref latencia.h, pasada a ciclos.
+ */
+#define PERFIL_ETAPAS(ETAPA)                \
+  ETAPA(PERFIL_MUESTREO, "muestreo_isr")    \
+  ETAPA(PERFIL_FILTRO, "filtro")            \
+  ETAPA(PERFIL_CARACTERISTICAS, "ventana")  \
+  ETAPA(PERFIL_ESPECTRO, "espectro")        \
+  ETAPA(PERFIL_DECISION, "decision")        \
+  ETAPA(PERFIL_MOTORES, "motores")          \
+  ETAPA(PERFIL_CONTROL, "control")          \
+  ETAPA(PERFIL_PERIODO_CONTROL, "periodo")  \
+  ETAPA(PERFIL_ENCODER_ISR, "encoder_isr")  \
+  ETAPA(PERFIL_EMG_A_PWM, "emg_a_pwm")
+
+#define PERFIL_ENUM(id, nombre) id,
+
+/**
+ * @enum Etapa_Perfil
+ * @brief Índice de cada etapa de @ref PERFIL_ETAPAS.
+ */
+enum Etapa_Perfil
+{
+  PERFIL_ETAPAS(PERFIL_ENUM)
+  NUMERO_ETAPAS_PERFIL
+};
+
+#if PERFILADO
+
+#define PERFIL_BITS_SUBCUBETA 3                                   ///< log2 de las subdivisiones por octava.
+#define PERFIL_SUBCUBETAS (1u << PERFIL_BITS_SUBCUBETA)              ///< Subdivisiones de cada octava.
+#define PERFIL_CUBETAS ((33 - PERFIL_BITS_SUBCUBETA) * PERFIL_SUBCUBETAS) ///< Cubetas para todo el rango de 32 bits.
+
+/**
+ * @struct histograma_perfil
+ * @brief Medidas en ciclos de una etapa.
+ */
+struct histograma_perfil
+{
+  atomic_bool reiniciar;            ///< Reinicio pedido por `perf`, pendiente de hacer por el productor.
+  uint32_t medidas;                 ///< Número de medidas.
+  uint32_t minimo;                  ///< Menor medida (ciclos).
+  uint32_t maximo;                  ///< Mayor medida (ciclos).
+  uint64_t suma;                    ///< Suma de las medidas, para la media.
+  uint32_t cubetas[PERFIL_CUBETAS]; ///< Medidas por cubeta (ver @ref perfil_cubeta).
+};
+
+struct histograma_perfil perfilHistogramas[NUMERO_ETAPAS_PERFIL]; ///< Un histograma por etapa.
+uint32_t perfilUltimoPaso[NUMERO_ETAPAS_PERFIL];                  ///< Ciclos de la última pasada (solo @ref PERFIL_PERIODO).
+
+#define PERFIL_NOMBRE(id, nombre) nombre,
+static const char *const perfilNombres[NUMERO_ETAPAS_PERFIL] = {PERFIL_ETAPAS(PERFIL_NOMBRE)}; ///< Nombres para `perf`.
+
+/**
+ * @brief Cubeta de una medida: exacta por debajo de @ref PERFIL_SUBCUBETAS y logarítmica por encima.
+ */
+static inline uint32_t IRAM_ATTR perfil_cubeta(uint32_t ciclos)
+{
+  if (ciclos < PERFIL_SUBCUBETAS)
+  {
+    return ciclos;
+  }
+  uint32_t octava = 31 - __builtin_clz(ciclos);
+  uint32_t sub = (ciclos >> (octava - PERFIL_BITS_SUBCUBETA)) & (PERFIL_SUBCUBETAS - 1);
+  return (octava - PERFIL_BITS_SUBCUBETA + 1) * PERFIL_SUBCUBETAS + sub;
+}
+
+/**
+ * @brief Mayor medida que cae en una cubeta.
+ */
+static inline uint32_t perfil_limite_cubeta(uint32_t cubeta)
+{
+  if (cubeta < PERFIL_SUBCUBETAS)
+  {
+    return cubeta;
+  }
+  uint32_t octava = cubeta / PERFIL_SUBCUBETAS + PERFIL_BITS_SUBCUBETA - 1;
+  uint32_t sub = cubeta % PERFIL_SUBCUBETAS;
+  uint64_t inferior = (uint64_t)(PERFIL_SUBCUBETAS + sub) << (octava - PERFIL_BITS_SUBCUBETA);
+  return (uint32_t)(inferior + (1ull << (octava - PERFIL_BITS_SUBCUBETA)) - 1);
+}
+
+/**
+ * @brief Suma una medida al histograma de una etapa. Puede llamarse desde una interrupción.
+ * @param etapa Etapa medida.
+ * @param ciclos Duración en ciclos de CPU.
+ */
+static inline void IRAM_ATTR perfil_registrar(enum Etapa_Perfil etapa, uint32_t ciclos)
+{
+  struct histograma_perfil *h = &perfilHistogramas[etapa];
+  if (h->medidas == 0 || atomic_load_explicit(&h->reiniciar, memory_order_acquire))
+  {
+    for (uint32_t i = 0; i < PERFIL_CUBETAS; i++)
+    {
+      h->cubetas[i] = 0;
+    }
+    h->medidas = 0;
+    h->minimo = UINT32_MAX;
+    h->maximo = 0;
+    h->suma = 0;
+    atomic_store_explicit(&h->reiniciar, false, memory_order_release);
+  }
+  h->medidas++;
+  h->suma += ciclos;
+  if (ciclos < h->minimo)
+  {
+    h->minimo = ciclos;
+  }
+  if (ciclos > h->maximo)
+  {
+    h->maximo = ciclos;
+  }
+  h->cubetas[perfil_cubeta(ciclos)]++;
+}
+
+/// Abre la medida de `etapa` en el bloque actual.
+#define PERFIL_INICIO(etapa) uint32_t perfilInicio_##etapa = esp_cpu_get_cycle_count()
+/// Cierra la medida abierta con @ref PERFIL_INICIO en el mismo bloque.
+#define PERFIL_FIN(etapa) perfil_registrar(etapa, esp_cpu_get_cycle_count() - perfilInicio_##etapa)
+/// Mide los ciclos desde la pasada anterior por este punto (la primera pasada no cuenta).
+#define PERFIL_PERIODO(etapa)                                     \
+  do                                                              \
+  {                                                               \
+    uint32_t perfilAhora = esp_cpu_get_cycle_count();             \
+    if (perfilUltimoPaso[etapa] != 0)                             \
+    {                                                             \
+      perfil_registrar(etapa, perfilAhora - perfilUltimoPaso[etapa]); \
+    }                                                             \
+    perfilUltimoPaso[etapa] = perfilAhora | 1u;                   \
+  } while (0)
+
+/**
+ * @brief Percentil `p` (0–1) de un histograma, acotado por el mínimo y el máximo exactos.
+ */
+static uint32_t perfil_percentil(const struct histograma_perfil *h, float p)
+{
+  uint32_t objetivo = (uint32_t)(p * h->medidas + 0.5f);
+  if (objetivo < 1)
+  {
+    objetivo = 1;
+  }
+  uint32_t acumulado = 0;
+  for (uint32_t i = 0; i < PERFIL_CUBETAS; i++)
+  {
+    acumulado += h->cubetas[i];
+    if (acumulado >= objetivo)
+    {
+      uint32_t limite = perfil_limite_cubeta(i);
+      return (limite > h->maximo) ? h->maximo : ((limite < h->minimo) ? h->minimo : limite);
+    }
+  }
+  return h->maximo;
+}
+
+/**
+ * @brief Imprime los histogramas de todas las etapas y pide su reinicio.
+ * @details Las columnas en µs usan `CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ`.
+ */
+void perfil_volcar()
+{
+  static struct histograma_perfil copia;
+  const float mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+
+  printf("%-12s %8s %9s %9s %9s %9s %9s  (ciclos; µs a %u MHz)\n", "etapa", "n", "min", "media", "p50", "p99", "max",
+         (unsigned)CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+  for (int e = 0; e < NUMERO_ETAPAS_PERFIL; e++)
+  {
+    struct histograma_perfil *h = &perfilHistogramas[e];
+    bool pendiente = atomic_load_explicit(&h->reiniciar, memory_order_acquire);
+    memcpy(&copia, h, sizeof(copia));
+    atomic_store_explicit(&h->reiniciar, true, memory_order_release);
+
+    if (pendiente || copia.medidas == 0)
+    {
+      printf("%-12s %8u\n", perfilNombres[e], 0u);
+      continue;
+    }
+    uint32_t media = (uint32_t)(copia.suma / copia.medidas);
+    uint32_t p50 = perfil_percentil(&copia, 0.50f);
+    uint32_t p99 = perfil_percentil(&copia, 0.99f);
+    printf("%-12s %8lu %9lu %9lu %9lu %9lu %9lu\n", perfilNombres[e], (unsigned long)copia.medidas,
+           (unsigned long)copia.minimo, (unsigned long)media, (unsigned long)p50, (unsigned long)p99,
+           (unsigned long)copia.maximo);
+    printf("%-12s %8s %9.1f %9.1f %9.1f %9.1f %9.1f\n", "", "", copia.minimo / mhz, media / mhz, p50 / mhz,
+           p99 / mhz, copia.maximo / mhz);
+  }
+  printf("presupuesto del periodo de control: %lu ciclos (%.1f µs)\n",
+         (unsigned long)(CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000000ull / FREC_BUCLE_CONTROL), 1e6f / FREC_BUCLE_CONTROL);
+}
+
+/**
+ * @brief Comando `perf`: vuelca y reinicia los histogramas.
+ */
+static int perfil_comando(int argc, char **argv)
+{
+  perfil_volcar();
+  return 0;
+}
+
+/**
+ * @brief Registra el comando `perf` en la consola (ver @ref consola.h).
+ */
+esp_err_t perfil_registrar_comando()
+{
+  const esp_console_cmd_t comando = {
+    .command = "perf",
+    .help = "Muestra min/media/p50/p99/max de cada etapa desde el último perf y reinicia los histogramas",
+    .hint = NULL,
+    .func = perfil_comando,
+  };
+  return esp_console_cmd_register(&comando);
+}
+
+#else
+
+#define PERFIL_INICIO(etapa) ((void)0)
+#define PERFIL_FIN(etapa) ((void)0)
+#define PERFIL_PERIODO(etapa) ((void)0)
+
+#endif
@@ -0,0 +1,427 @@
+/**
+ * @file persistencia.h
+ * @brief Conservación de la calibración y de la posición de los motores entre arranques.
+ * @details
+ * Dos niveles, según lo que dura cada dato y cuánto cambia:
+ * - NVS (sobrevive al apagado): umbrales de @ref calibracion_umbrales.h, si los motores están
+ *   calibrados y la posición de cada motor del banco en la última parada (el cero de su encoder
+ *   en el siguiente arranque). Se guarda un único bloque @ref datos_persistentes con versión, tamaño y CRC.
+ * - Memoria RTC sin inicializar (sobrevive a reinicios software, pánicos, watchdog y sueño
+ *   ligero): las posiciones de los motores en cada ciclo de control y el estado de los biquads del
+ *   prefiltrado en cada bloque, cada uno con su CRC.
+ *
+ * Al arrancar, @ref persistencia_estado_arranque elige el estado inicial: @ref ESTADO_CALIBRADO_UMBRALES
+ * si no hay umbrales válidos y @ref ESTADO_NORMAL en caso contrario. Nunca arranca en
+ * @ref ESTADO_CALIBRADO_MOTORES: sin posición válida los motores parten de la restaurada (o de
+ * cero) y la calibración de motores la inicia un operador con el comando `motores`
+ * (@ref calibracion_motores_comando).
+ *
+ * Las escrituras en NVS las hace una tarea de baja prioridad (@ref persistencia_tarea), nunca el
+ * bucle de control. Para limitar el desgaste de la flash, las posiciones solo se escriben con los
+ * motores parados, si alguna ha cambiado más de @ref PERSISTENCIA_TOLERANCIA_POSICION pasos y como mucho
+ * una vez cada @ref PERSISTENCIA_INTERVALO_MINIMO_MS. Los cambios de calibración se escriben enseguida.
+ *
+ * @note Tras un apagado se supone que la mano no se ha movido: la reductora no es reversible.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_err.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "globales.h"
+#include "parametros.h"
+#include "motores.h"
+#include "banco_motores.h"
+#include "filtro_emg.h"
+
+#define PERSISTENCIA_VERSION 2                  ///< Versión del formato de @ref datos_persistentes. Cambiarla invalida lo guardado.
+#define PERSISTENCIA_ESPACIO "protesis"         ///< Espacio de nombres NVS.
+#define PERSISTENCIA_CLAVE "calibracion"        ///< Clave NVS del bloque de datos.
+#define PERSISTENCIA_MAGIA_RTC 0x50525443u      ///< Marca de los bloques en memoria RTC.
+#define PERSISTENCIA_PERIODO_MS 500             ///< Periodo con el que la tarea comprueba si hay algo que guardar.
+#define PERSISTENCIA_INTERVALO_MINIMO_MS 10000  ///< Tiempo mínimo entre dos escrituras de la posición en NVS.
+#define PERSISTENCIA_TOLERANCIA_POSICION (4 * TOLERANCIA_POSICION_MOTOR) ///< Cambio de posición (pasos) que justifica una escritura.
+#define PERSISTENCIA_PRIORIDAD 1                ///< Prioridad de la tarea de persistencia (justo por encima de idle).
+
+/**
+ * @enum Indice_Umbral
+ * @brief Posición de cada umbral en @ref datos_persistentes.
+ */
+enum Indice_Umbral
+{
+  UMBRAL_ACT_MAV,
+  UMBRAL_DES_MAV,
+  UMBRAL_ACT_VAR,
+  UMBRAL_DES_VAR,
+  UMBRAL_ACT_WL,
+  UMBRAL_DES_WL,
+  NUMERO_UMBRALES
+};
+
+/**
+ * @struct datos_persistentes
+ * @brief Bloque guardado en NVS.
+ */
+struct datos_persistentes
+{
+  uint16_t version;                 ///< @ref PERSISTENCIA_VERSION.
+  uint16_t tamano;                  ///< `sizeof(struct datos_persistentes)`.
+  uint8_t umbralesValidos;          ///< `1` si `umbrales` procede de una calibración.
+  uint8_t motoresCalibrados;        ///< `1` si `posicionesMotores` son posiciones calibradas.
+  uint16_t posicionesMotores[NUMERO_MOTORES]; ///< Posición de cada motor del banco en la última parada.
+  float umbrales[NUMERO_UMBRALES];  ///< Umbrales en el orden de @ref Indice_Umbral.
+  uint32_t crc;                     ///< CRC32 de todos los campos anteriores.
+};
+
+/**
+ * @struct rtc_posicion
+ * @brief Posiciones de los motores en memoria RTC, escritas en cada ciclo de control.
+ */
+struct rtc_posicion
+{
+  uint32_t magia;                        ///< @ref PERSISTENCIA_MAGIA_RTC.
+  uint16_t posiciones[NUMERO_MOTORES];   ///< Posición de cada motor del banco.
+  uint16_t valida;                       ///< `1` si las posiciones estaban calibradas.
+  uint32_t crc;      ///< CRC32 de los campos anteriores.
+};
+
+/**
+ * @struct rtc_filtro
+ * @brief Estado de los biquads en memoria RTC, escrito en cada bloque.
+ */
+struct rtc_filtro
+{
+  uint32_t magia;                        ///< @ref PERSISTENCIA_MAGIA_RTC.
+  uint8_t estado[sizeof(filtroEstado)];  ///< Copia de @ref filtroEstado.
+  uint32_t crc;                          ///< CRC32 de los campos anteriores.
+};
+
+RTC_NOINIT_ATTR struct rtc_posicion rtcPosicion; ///< Posiciones de los motores, conservadas en reinicios software.
+RTC_NOINIT_ATTR struct rtc_filtro rtcFiltro;     ///< Estado del prefiltrado, conservado en reinicios software.
+
+struct datos_persistentes datosPersistentes;     ///< Último bloque leído o escrito en NVS.
+bool nvsDisponible = false;                      ///< `true` si la partición NVS se ha podido inicializar.
+volatile bool umbralesCalibrados = false;        ///< `true` si los umbrales vienen de una calibración (propia o restaurada).
+volatile bool motoresCalibrados = false;         ///< `true` si las posiciones de los motores están referidas a una calibración.
+TaskHandle_t tareaPersistencia = NULL;           ///< Tarea que escribe en NVS.
+
+/**
+ * @brief CRC32 de los `n` primeros bytes de un bloque.
+ */
+static inline uint32_t persistencia_crc(const void *datos, size_t n)
+{
+  return esp_rom_crc32_le(0, (const uint8_t *)datos, (uint32_t)n);
+}
+
+/**
+ * @brief Copia los umbrales vigentes (@ref parametros.h) en el orden de @ref Indice_Umbral.
+ * @return `false` si los parámetros estaban ocupados o con un cambio sin confirmar.
+ */
+static bool persistencia_leer_umbrales(float umbrales[NUMERO_UMBRALES])
+{
+  struct parametros_ajustables p;
+  if (!parametros_copiar(&p))
+  {
+    return false;
+  }
+  umbrales[UMBRAL_ACT_MAV] = p.umbralActMAV;
+  umbrales[UMBRAL_DES_MAV] = p.umbralDesMAV;
+  umbrales[UMBRAL_ACT_VAR] = p.umbralActVar;
+  umbrales[UMBRAL_DES_VAR] = p.umbralDesVar;
+  umbrales[UMBRAL_ACT_WL] = p.umbralActWL;
+  umbrales[UMBRAL_DES_WL] = p.umbralDesWL;
+  return true;
+}
+
+/**
+ * @brief Publica en @ref parametros.h los umbrales de un bloque y los confirma.
+ * @details Solo al arrancar, antes de la tarea de control.
+ */
+static void persistencia_aplicar_umbrales(const float umbrales[NUMERO_UMBRALES])
+{
+  struct parametros_ajustables *p = parametros_editar();
+  if (p == NULL)
+  {
+    return;
+  }
+  p->umbralActMAV = umbrales[UMBRAL_ACT_MAV];
+  p->umbralDesMAV = umbrales[UMBRAL_DES_MAV];
+  p->umbralActVar = umbrales[UMBRAL_ACT_VAR];
+  p->umbralDesVar = umbrales[UMBRAL_DES_VAR];
+  p->umbralActWL = umbrales[UMBRAL_ACT_WL];
+  p->umbralDesWL = umbrales[UMBRAL_DES_WL];
+  parametros_publicar(p);
+  parametros_confirmar();
+}
+
+/**
+ * @brief Escribe un bloque en NVS, completando versión, tamaño y CRC.
+ * @return `ESP_OK` si el bloque ha quedado confirmado en la flash.
+ */
+static esp_err_t persistencia_escribir(struct datos_persistentes *d)
+{
+  if (!nvsDisponible)
+  {
+    return ESP_ERR_INVALID_STATE;
+  }
+  d->version = PERSISTENCIA_VERSION;
+  d->tamano = sizeof(*d);
+  d->crc = persistencia_crc(d, offsetof(struct datos_persistentes, crc));
+
+  nvs_handle_t nvs;
+  esp_err_t err = nvs_open(PERSISTENCIA_ESPACIO, NVS_READWRITE, &nvs);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+  err = nvs_set_blob(nvs, PERSISTENCIA_CLAVE, d, sizeof(*d));
+  if (err == ESP_OK)
+  {
+    err = nvs_commit(nvs);
+  }
+  nvs_close(nvs);
+  return err;
+}
+
+/**
+ * @brief Lee el bloque de NVS y comprueba versión, tamaño y CRC.
+ * @return `ESP_OK`, `ESP_ERR_NOT_FOUND`, `ESP_ERR_INVALID_VERSION`, `ESP_ERR_INVALID_CRC` u otro error de NVS.
+ */
+static esp_err_t persistencia_leer(struct datos_persistentes *d)
+{
+  nvs_handle_t nvs;
+  esp_err_t err = nvs_open(PERSISTENCIA_ESPACIO, NVS_READONLY, &nvs);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+  size_t n = sizeof(*d);
+  err = nvs_get_blob(nvs, PERSISTENCIA_CLAVE, d, &n);
+  nvs_close(nvs);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+  if (n != sizeof(*d) || d->version != PERSISTENCIA_VERSION || d->tamano != sizeof(*d))
+  {
+    return ESP_ERR_INVALID_VERSION;
+  }
+  if (d->crc != persistencia_crc(d, offsetof(struct datos_persistentes, crc)))
+  {
+    return ESP_ERR_INVALID_CRC;
+  }
+  return ESP_OK;
+}
+
+/**
+ * @brief Indica si las posiciones guardadas en memoria RTC son válidas.
+ */
+static inline bool persistencia_rtc_posicion_valida()
+{
+  return rtcPosicion.magia == PERSISTENCIA_MAGIA_RTC && rtcPosicion.valida &&
+         rtcPosicion.crc == persistencia_crc(&rtcPosicion, offsetof(struct rtc_posicion, crc));
+}
+
+/**
+ * @brief Guarda las posiciones de los motores en memoria RTC. Se llama en cada ciclo de control.
+ * @param posiciones Posición actual de cada motor del banco.
+ * @param valida `false` mientras las posiciones no estén referidas a una calibración.
+ */
+static inline void persistencia_guardar_posicion_rtc(const uint16_t posiciones[NUMERO_MOTORES], bool valida)
+{
+  rtcPosicion.magia = PERSISTENCIA_MAGIA_RTC;
+  memcpy(rtcPosicion.posiciones, posiciones, sizeof(rtcPosicion.posiciones));
+  rtcPosicion.valida = valida ? 1 : 0;
+  rtcPosicion.crc = persistencia_crc(&rtcPosicion, offsetof(struct rtc_posicion, crc));
+}
+
+/**
+ * @brief Guarda el estado de los biquads en memoria RTC. Se llama tras filtrar cada bloque.
+ */
+static inline void persistencia_guardar_filtro()
+{
+  rtcFiltro.magia = PERSISTENCIA_MAGIA_RTC;
+  memcpy(rtcFiltro.estado, filtroEstado, sizeof(filtroEstado));
+  rtcFiltro.crc = persistencia_crc(&rtcFiltro, offsetof(struct rtc_filtro, crc));
+}
+
+/**
+ * @brief Restaura el estado de los biquads desde memoria RTC.
+ * @return `true` si se ha restaurado; si no, el llamador debe usar @ref filtro_reiniciar.
+ */
+bool persistencia_restaurar_filtro()
+{
+  if (rtcFiltro.magia != PERSISTENCIA_MAGIA_RTC || rtcFiltro.crc != persistencia_crc(&rtcFiltro, offsetof(struct rtc_filtro, crc)))
+  {
+    return false;
+  }
+  memcpy(filtroEstado, rtcFiltro.estado, sizeof(filtroEstado));
+  return true;
+}
+
+/**
+ * @brief Restaura las posiciones de los motores: las de memoria RTC si son válidas y, si no, las de NVS.
+ * @details Debe llamarse tras inicializar el banco (@ref banco_iniciar). Sin posiciones válidas no
+ * se toca ningún motor.
+ */
+void persistencia_restaurar_posicion()
+{
+  const uint16_t *posiciones;
+  if (persistencia_rtc_posicion_valida())
+  {
+    posiciones = rtcPosicion.posiciones;
+  }
+  else if (datosPersistentes.motoresCalibrados)
+  {
+    posiciones = datosPersistentes.posicionesMotores;
+  }
+  else
+  {
+    return;
+  }
+  for (int i = 0; i < NUMERO_MOTORES; i++)
+  {
+    motores_set_position(&bancoMotores[i], posiciones[i]);
+    posicionesMotores[i] = motores_read_position(&bancoMotores[i]);
+  }
+  posicionMotor = posicionesMotores[MOTOR_PRINCIPAL];
+}
+
+/**
+ * @brief Estado con el que debe arrancar la máquina de estados según los datos restaurados.
+ * @details Sin umbrales guardados arranca en @ref ESTADO_CALIBRADO_UMBRALES, que avanza sola. La
+ * calibración de motores necesita a alguien que mueva la mano, así que nunca se arranca en ella:
+ * se inicia desde la consola (@ref calibracion_motores_comando).
+ */
+enum Estado_Protesis persistencia_estado_arranque()
+{
+  if (!umbralesCalibrados)
+  {
+    return ESTADO_CALIBRADO_UMBRALES;
+  }
+  return ESTADO_NORMAL;
+}
+
+/**
+ * @brief Pide a la tarea de persistencia que compruebe enseguida si hay cambios que guardar.
+ * @details Se llama al terminar una calibración.
+ */
+static inline void persistencia_solicitar_guardado()
+{
+  if (tareaPersistencia != NULL)
+  {
+    xTaskNotifyGive(tareaPersistencia);
+  }
+}
+
+/**
+ * @brief Tarea de persistencia: compara el estado actual con lo guardado y escribe en NVS si procede.
+ */
+void persistencia_tarea(void *parametros)
+{
+  int64_t ultimaEscritura = esp_timer_get_time();
+
+  while (1)
+  {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PERSISTENCIA_PERIODO_MS));
+
+    struct datos_persistentes d = {0};
+    d.umbralesValidos = umbralesCalibrados ? 1 : 0;
+    d.motoresCalibrados = (motoresCalibrados && estado_protesis.estado_actual != ESTADO_CALIBRADO_MOTORES) ? 1 : 0;
+    int diferencia = 0;
+    bool parado = true;
+    for (int i = 0; i < NUMERO_MOTORES; i++)
+    {
+      d.posicionesMotores[i] = d.motoresCalibrados ? posicionesMotores[i] : 0;
+      int cambio = (int)d.posicionesMotores[i] - (int)datosPersistentes.posicionesMotores[i];
+      if (((cambio < 0) ? -cambio : cambio) > diferencia)
+      {
+        diferencia = (cambio < 0) ? -cambio : cambio;
+      }
+      float velocidad = bancoMotores[i].vel.velocity;
+      parado = parado && ((velocidad < 0) ? -velocidad : velocidad) < VELOCIDAD_AGARRE_MOTOR;
+    }
+    if (!persistencia_leer_umbrales(d.umbrales))
+    {
+      // Un cambio de parámetros a medias: se vuelve a mirar en cuanto se confirme
+      vTaskDelay(1);
+      xTaskNotifyGive(tareaPersistencia);
+      continue;
+    }
+
+    bool calibracionCambiada = d.umbralesValidos != datosPersistentes.umbralesValidos ||
+                               d.motoresCalibrados != datosPersistentes.motoresCalibrados ||
+                               memcmp(d.umbrales, datosPersistentes.umbrales, sizeof(d.umbrales)) != 0;
+
+    int64_t ahora = esp_timer_get_time();
+    bool posicionCambiada = d.motoresCalibrados && parado && diferencia > PERSISTENCIA_TOLERANCIA_POSICION &&
+                            ahora - ultimaEscritura >= PERSISTENCIA_INTERVALO_MINIMO_MS * 1000LL;
+
+    if (!calibracionCambiada && !posicionCambiada)
+    {
+      continue;
+    }
+    if (!calibracionCambiada)
+    {
+      // Solo ha cambiado la posición: conservar el resto del bloque tal cual
+      memcpy(d.umbrales, datosPersistentes.umbrales, sizeof(d.umbrales));
+    }
+    if (persistencia_escribir(&d) == ESP_OK)
+    {
+      datosPersistentes = d;
+      ultimaEscritura = ahora;
+    }
+  }
+}
+
+/**
+ * @brief Inicializa NVS, restaura la calibración guardada y arranca la tarea de persistencia.
+ * @details Debe llamarse antes de @ref tareas_iniciar. Si la partición está llena o es de otra
+ * versión de NVS se borra. Sin datos válidos los umbrales quedan en sus valores por defecto.
+ * @return `ESP_OK` si NVS está disponible y la tarea en marcha, o el error correspondiente.
+ */
+esp_err_t persistencia_iniciar()
+{
+  esp_err_t err = nvs_flash_init();
+  if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND)
+  {
+    nvs_flash_erase();
+    err = nvs_flash_init();
+  }
+  nvsDisponible = (err == ESP_OK);
+
+  struct datos_persistentes d;
+  if (nvsDisponible && persistencia_leer(&d) == ESP_OK)
+  {
+    datosPersistentes = d;
+    if (d.umbralesValidos)
+    {
+      persistencia_aplicar_umbrales(d.umbrales);
+    }
+  }
+  else
+  {
+    memset(&datosPersistentes, 0, sizeof(datosPersistentes));
+    persistencia_leer_umbrales(datosPersistentes.umbrales);
+  }
+  umbralesCalibrados = datosPersistentes.umbralesValidos;
+  motoresCalibrados = datosPersistentes.motoresCalibrados || persistencia_rtc_posicion_valida();
+
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+  if (xTaskCreatePinnedToCore(persistencia_tarea, "persistencia", 3072, NULL, PERSISTENCIA_PRIORIDAD, &tareaPersistencia, NUCLEO_ADQUISICION) != pdPASS)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
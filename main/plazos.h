@@ -0,0 +1,300 @@
+/**
+ * @file plazos.h
+ * @brief Vigilancia de plazos del procesado y degradación ordenada ante sobrecarga.
+ * @details
+ * Con @ref PLAZOS_VIGILANCIA a `1`, cada etapa de @ref PLAZOS_ETAPAS anota con @ref plazos_anotar
+ * cuánto ha tardado frente a su plazo: ejecuciones, incumplimientos y la peor holgura (plazo menos
+ * duración, negativa si se ha pasado). Los plazos salen del periodo de bloque
+ * (@ref PLAZOS_PERIODO_BLOQUE_US): si la adquisición tarda más de un bloque, o un bloque no ha
+ * pasado la decisión antes de que llegue el siguiente al control, el procesado va por detrás del
+ * ADC y acabará perdiendo bloques en los anillos.
+ *
+ * Una vez por periodo, la tarea de control llama a @ref plazos_revisar con el total de bloques y
+ * periodos perdidos (desbordamientos de los anillos y periodos del temporizador sin atender).
+ * Cada incumplimiento o pérdida suma a una racha de fallos, que se corta con el primer bloque a
+ * tiempo. Al llegar a @ref PLAZOS_FALLOS_DEGRADAR fallos seguidos se sube un nivel de
+ * @ref Nivel_Degradacion, saltando los que @ref PLAZOS_DEGRADACION no permite. Tras
+ * @ref PLAZOS_BLOQUES_RECUPERAR bloques seguidos a tiempo se baja un nivel. Los efectos se acumulan:
+ * - @ref NIVEL_SIN_ESPECTRO: la adquisición deja de alimentar la etapa espectral y la red, si
+ *   decide, recibe ceros en sus entradas espectrales.
+ * - @ref NIVEL_SALTO_DOBLE: la decisión se toma en uno de cada dos saltos de la ventana.
+ * - @ref NIVEL_SEGURIDAD: desde @ref ESTADO_NORMAL la prótesis pasa a @ref ESTADO_SEGURIDAD, abre
+ *   y se para. Vuelve a @ref ESTADO_NORMAL al bajar de este nivel.
+ *
+ * El comando `plazos` muestra los contadores, la racha actual y el nivel.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_console.h"
+#include "esp_err.h"
+#include "globales.h"
+#include "anillo_bloques.h"
+#include "maquina_de_estados_protesis.h"
+
+/**
+ * @enum Nivel_Degradacion
+ * @brief Nivel de degradación, de menos a más. Cada nivel útil tiene su bit en @ref PLAZOS_DEGRADACION.
+ */
+enum Nivel_Degradacion
+{
+  NIVEL_COMPLETO,     ///< Procesado completo.
+  NIVEL_SIN_ESPECTRO, ///< Sin etapa espectral (@ref DEGRADAR_ESPECTRO).
+  NIVEL_SALTO_DOBLE,  ///< Decisión cada dos saltos (@ref DEGRADAR_SALTO).
+  NIVEL_SEGURIDAD,    ///< Prótesis abierta y parada (@ref DEGRADAR_SEGURIDAD).
+  NUMERO_NIVELES
+};
+
+#if PLAZOS_VIGILANCIA
+
+#define PLAZOS_PERIODO_BLOQUE_US (ANILLO_MUESTRAS_POR_BLOQUE * 1000000LL / SAMPLING_FREQ) ///< Tiempo entre dos bloques del ADC (µs).
+
+/**
+ * @brief Etapas vigiladas, en orden: `PLAZO(id, nombre, plazo en µs)`.
+ * @details
+ * - Adquisición: de la captura del bloque (@ref tiempoCapturaEMG) a su publicación ya filtrado.
+ * - Procesado: de la captura a la última decisión del bloque en la tarea de control.
+ * - Control: duración de un periodo del bucle de control.
+ */
+#define PLAZOS_ETAPAS(PLAZO)                                              \
+  PLAZO(PLAZO_ADQUISICION, "adquisicion", PLAZOS_PERIODO_BLOQUE_US)       \
+  PLAZO(PLAZO_PROCESADO, "procesado", 2 * PLAZOS_PERIODO_BLOQUE_US)       \
+  PLAZO(PLAZO_CONTROL, "control", 1000000LL / FREC_BUCLE_CONTROL)
+
+/**
+ * @enum Etapa_Plazo
+ * @brief Índice de cada etapa de @ref PLAZOS_ETAPAS.
+ */
+enum Etapa_Plazo
+{
+#define PLAZO_ID(id, nombre, plazo) id,
+  PLAZOS_ETAPAS(PLAZO_ID)
+#undef PLAZO_ID
+  NUMERO_PLAZOS
+};
+
+/**
+ * @struct plazo_etapa
+ * @brief Contadores de una etapa. Cada etapa la anota una sola tarea.
+ */
+struct plazo_etapa
+{
+  const char *nombre;             ///< Nombre en el comando `plazos`.
+  int32_t plazoUs;                ///< Plazo (µs).
+  volatile uint32_t ejecuciones;  ///< Veces que se ha anotado.
+  volatile uint32_t incumplidos;  ///< Veces que ha superado el plazo.
+  volatile int32_t peorHolguraUs; ///< Menor holgura observada (µs); negativa si algún plazo se ha superado.
+};
+
+/**
+ * @struct vigilancia_plazos
+ * @brief Estado de la política de degradación. Solo lo escribe la tarea de control.
+ */
+struct vigilancia_plazos
+{
+  uint32_t fallosAnteriores;      ///< Incumplimientos y pérdidas sumados en la revisión anterior.
+  uint32_t aTiempoAnteriores;     ///< Bloques procesados a tiempo en la revisión anterior.
+  uint32_t racha;                 ///< Fallos seguidos sin un bloque a tiempo por medio.
+  uint32_t bloquesLimpios;        ///< Bloques a tiempo seguidos desde el último fallo o cambio de nivel.
+  uint32_t cambiosNivel;          ///< Cambios de nivel desde el arranque.
+  bool seguridadPropia;           ///< @ref ESTADO_SEGURIDAD lo ha provocado la vigilancia.
+};
+
+struct plazo_etapa plazosEtapas[NUMERO_PLAZOS] = {
+#define PLAZO_ETAPA(id, nombre, plazo) [id] = {nombre, (int32_t)(plazo), 0, 0, (int32_t)(plazo)},
+  PLAZOS_ETAPAS(PLAZO_ETAPA)
+#undef PLAZO_ETAPA
+}; ///< Contadores de cada etapa.
+
+struct vigilancia_plazos vigilanciaPlazos;     ///< Estado de la degradación.
+volatile uint8_t nivelDegradacion = NIVEL_COMPLETO; ///< @ref Nivel_Degradacion en vigor. Lo escribe la tarea de control y lo leen las demás.
+
+/**
+ * @brief Anota una ejecución de una etapa.
+ * @param etapa Etapa de @ref PLAZOS_ETAPAS.
+ * @param inicioUs Inicio de la medida (µs, reloj de `esp_timer`).
+ * @param finUs Fin de la medida.
+ * @return `true` si ha cumplido su plazo.
+ */
+static inline bool plazos_anotar(enum Etapa_Plazo etapa, int64_t inicioUs, int64_t finUs)
+{
+  struct plazo_etapa *e = &plazosEtapas[etapa];
+  int32_t holgura = e->plazoUs - (int32_t)(finUs - inicioUs);
+  e->ejecuciones++;
+  if (holgura < e->peorHolguraUs)
+  {
+    e->peorHolguraUs = holgura;
+  }
+  if (holgura < 0)
+  {
+    e->incumplidos++;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Indica si está en vigor el efecto de un nivel de degradación.
+ * @details Lo está si el nivel actual es igual o superior y la política está permitida en
+ * @ref PLAZOS_DEGRADACION.
+ */
+static inline bool plazos_degradado(enum Nivel_Degradacion nivel)
+{
+  return nivelDegradacion >= nivel && ((PLAZOS_DEGRADACION >> (nivel - 1)) & 1u);
+}
+
+/**
+ * @brief Nivel permitido por @ref PLAZOS_DEGRADACION más cercano en un sentido, o el actual si no hay.
+ */
+static int plazos_nivel_siguiente(int nivel, int sentido)
+{
+  for (int n = nivel + sentido; n > NIVEL_COMPLETO && n < NUMERO_NIVELES; n += sentido)
+  {
+    if ((PLAZOS_DEGRADACION >> (n - 1)) & 1u)
+    {
+      return n;
+    }
+  }
+  return (sentido < 0) ? NIVEL_COMPLETO : nivel;
+}
+
+/**
+ * @brief Lleva la máquina de estados a o desde @ref ESTADO_SEGURIDAD según el nivel.
+ * @details Solo entra desde @ref ESTADO_NORMAL y solo deshace la entrada que ha provocado ella:
+ * la calibración en curso no se interrumpe, y un @ref ESTADO_SEGURIDAD de otro origen no se toca.
+ */
+static void plazos_aplicar_seguridad(struct Maquina_de_estados_protesis *m, bool abierta)
+{
+  struct vigilancia_plazos *v = &vigilanciaPlazos;
+  bool seguridad = plazos_degradado(NIVEL_SEGURIDAD);
+
+  if (seguridad && !v->seguridadPropia && m->estado_actual == ESTADO_NORMAL)
+  {
+    maquina_cambiarEstado(m, ESTADO_SEGURIDAD);
+    MAQUINA_CAMBIAR_FASE(m, ESTADO_SEGURIDAD, FASE_PAUSA, FASE_PASO_1);
+    v->seguridadPropia = true;
+    return;
+  }
+  if (!v->seguridadPropia)
+  {
+    return;
+  }
+  if (m->estado_actual != ESTADO_SEGURIDAD)
+  {
+    v->seguridadPropia = false;
+  }
+  else if (m->fase_actual == FASE_PASO_1 && abierta)
+  {
+    maquina_completar_fase(m);
+  }
+  else if (m->fase_actual == FASE_PASO_2 && !seguridad)
+  {
+    MAQUINA_CAMBIAR_FASE(m, ESTADO_SEGURIDAD, FASE_PASO_2, FASE_CAMBIO_ESTADO);
+    maquina_completar_fase(m);
+    v->seguridadPropia = false;
+  }
+}
+
+/**
+ * @brief Revisa los contadores y ajusta el nivel de degradación. Una vez por periodo de control.
+ * @param perdidos Total, desde el arranque, de bloques y periodos perdidos (monótono).
+ * @param m Máquina de estados de la prótesis.
+ * @param abierta `true` si los motores han llegado a su objetivo en este periodo (@ref motorArrived).
+ * @details Los bloques procesados a tiempo se cuentan con las anotaciones de @ref PLAZO_PROCESADO
+ * que han cumplido.
+ */
+void plazos_revisar(uint32_t perdidos, struct Maquina_de_estados_protesis *m, bool abierta)
+{
+  struct vigilancia_plazos *v = &vigilanciaPlazos;
+  uint32_t fallos = perdidos;
+  for (int i = 0; i < NUMERO_PLAZOS; i++)
+  {
+    fallos += plazosEtapas[i].incumplidos;
+  }
+  const struct plazo_etapa *procesado = &plazosEtapas[PLAZO_PROCESADO];
+  uint32_t aTiempo = procesado->ejecuciones - procesado->incumplidos;
+
+  uint32_t nuevosFallos = fallos - v->fallosAnteriores;
+  uint32_t nuevosATiempo = aTiempo - v->aTiempoAnteriores;
+  v->fallosAnteriores = fallos;
+  v->aTiempoAnteriores = aTiempo;
+
+  int nivel = nivelDegradacion;
+  if (nuevosFallos > 0)
+  {
+    v->racha += nuevosFallos;
+    v->bloquesLimpios = 0;
+    if (v->racha >= PLAZOS_FALLOS_DEGRADAR)
+    {
+      nivel = plazos_nivel_siguiente(nivel, 1);
+      v->racha = 0;
+    }
+  }
+  else if (nuevosATiempo > 0)
+  {
+    v->racha = 0;
+    v->bloquesLimpios += nuevosATiempo;
+    if (v->bloquesLimpios >= PLAZOS_BLOQUES_RECUPERAR && nivel != NIVEL_COMPLETO)
+    {
+      nivel = plazos_nivel_siguiente(nivel, -1);
+      v->bloquesLimpios = 0;
+    }
+  }
+  if (nivel != nivelDegradacion)
+  {
+    nivelDegradacion = (uint8_t)nivel;
+    v->cambiosNivel++;
+  }
+  plazos_aplicar_seguridad(m, abierta);
+}
+
+/**
+ * @brief Comando `plazos`: contadores de cada etapa y estado de la degradación.
+ */
+static int plazos_comando(int argc, char **argv)
+{
+  static const char *const nombresNiveles[NUMERO_NIVELES] = {"completo", "sin espectro", "salto doble", "seguridad"};
+  for (int i = 0; i < NUMERO_PLAZOS; i++)
+  {
+    const struct plazo_etapa *e = &plazosEtapas[i];
+    printf("%-12s plazo %6ld us  peor holgura %7ld us  %lu incumplidos de %lu\n", e->nombre, (long)e->plazoUs,
+           (long)e->peorHolguraUs, (unsigned long)e->incumplidos, (unsigned long)e->ejecuciones);
+  }
+  const struct vigilancia_plazos *v = &vigilanciaPlazos;
+  printf("nivel %s (%lu cambios), racha de %lu fallos, %lu bloques a tiempo seguidos\n", nombresNiveles[nivelDegradacion],
+         (unsigned long)v->cambiosNivel, (unsigned long)v->racha, (unsigned long)v->bloquesLimpios);
+  return 0;
+}
+
+/**
+ * @brief Registra el comando `plazos` en la consola (ver @ref consola.h).
+ */
+esp_err_t plazos_registrar_comando()
+{
+  const esp_console_cmd_t comando = {
+    .command = "plazos",
+    .help = "Muestra plazo, peor holgura e incumplimientos de cada etapa y el nivel de degradación por sobrecarga",
+    .hint = NULL,
+    .func = plazos_comando,
+  };
+  return esp_console_cmd_register(&comando);
+}
+
+#else
+
+enum Etapa_Plazo
+{
+  PLAZO_ADQUISICION,
+  PLAZO_PROCESADO,
+  PLAZO_CONTROL
+};
+
+static inline bool plazos_anotar(enum Etapa_Plazo etapa, int64_t inicioUs, int64_t finUs) { return true; }
+static inline bool plazos_degradado(enum Nivel_Degradacion nivel) { return false; }
+static inline void plazos_revisar(uint32_t perdidos, struct Maquina_de_estados_protesis *m, bool abierta) {}
+static inline esp_err_t plazos_registrar_comando() { return ESP_OK; }
+
+#endif
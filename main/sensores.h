@@ -0,0 +1,332 @@
+/**
+ * @file sensores.h
+ * @brief Adquisición por lotes de los sensores de seguridad y publicación mediante seqlock.
+ * @details
+ * Una tarea de baja prioridad (@ref sensores_tarea) lee cada @ref SENSORES_PERIODO_MS, en un
+ * único lote, la batería (ADC1 en modo oneshot), la temperatura del chip (sensor interno) y el
+ * estado del encoder. La corriente del motor, que necesita la detección de agarre
+ * (@ref agarre_motor.h), se convierte más a menudo, cada @ref SENSORES_PERIODO_CORRIENTE_MS (un tick
+ * con `CONFIG_FREERTOS_HZ` = 100, el mínimo con el que la tarea sigue bloqueándose). Cada vuelta
+ * publica una @ref instantanea_sensores protegida por un seqlock:
+ * - El escritor (solo la tarea de sensores) pone la secuencia en impar, copia los datos y la
+ *   vuelve a poner en par.
+ * - El lector copia los datos entre dos lecturas de la secuencia y los acepta si ambas coinciden
+ *   y son pares. No bloquea ni toma el ADC: como mucho reintenta @ref SENSORES_REINTENTOS_LECTURA
+ *   veces y, si no lo consigue, se queda con su copia anterior. El coste es constante.
+ *
+ * Los lectores del otro núcleo se ejecutan a la vez que el escritor y pueden copiar los datos a
+ * mitad de una publicación. No hace falta excluirlos: una copia es coherente solo si la secuencia
+ * era par al empezar y no ha cambiado al terminar; si no, se descarta y se reintenta.
+ *
+ * Este módulo es el único que usa la unidad ADC1 en modo oneshot (@ref adcSensores): nadie más
+ * hace conversiones bloqueantes, y menos desde el bucle de control.
+ *
+ * @note La temperatura es la del sensor interno del ESP32-S3; no hay sonda en el driver del motor.
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "driver/temperature_sensor.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "globales.h"
+#include "motores.h"
+
+#define SENSORES_PERIODO_MS 20        ///< Periodo del lote de lecturas de los sensores de seguridad.
+#define SENSORES_PERIODO_CORRIENTE_MS 10 ///< Periodo de la conversión de la corriente del motor (y de cada publicación). Al menos un tick.
+#define SENSORES_PRIORIDAD 2          ///< Prioridad de la tarea de sensores (baja).
+#define SENSORES_REINTENTOS_LECTURA 4 ///< Intentos de lectura del seqlock antes de usar la copia anterior.
+#define SENSORES_ANTIGUEDAD_MAXIMA_MS (5 * SENSORES_PERIODO_MS) ///< Una instantánea más antigua indica que la tarea de sensores no responde.
+#define SENSORES_MV_FONDO_ESCALA 3100 ///< Tensión aproximada (mV) del fondo de escala del ADC con 12 dB, si no hay calibración.
+#define SENSORES_DIVISOR_BATERIA 2.0f ///< Relación del divisor resistivo de la batería (V batería / V pin).
+#define SENSORES_TIEMPO_FALLO_ENCODER_MS 300 ///< Tiempo con el motor accionado y sin pasos de encoder para declarar fallo.
+#define SENSORES_DUTY_FALLO_ENCODER (MOTORES_DUTY_MAX / 2) ///< Duty a partir del cual se espera ver pasos del encoder.
+#define SENSORES_VUELTAS_LOTE (SENSORES_PERIODO_MS / SENSORES_PERIODO_CORRIENTE_MS) ///< Publicaciones por cada lote completo.
+
+_Static_assert(SENSORES_PERIODO_MS % SENSORES_PERIODO_CORRIENTE_MS == 0, "SENSORES_PERIODO_CORRIENTE_MS debe dividir a SENSORES_PERIODO_MS");
+_Static_assert(pdMS_TO_TICKS(SENSORES_PERIODO_CORRIENTE_MS) > 0, "SENSORES_PERIODO_CORRIENTE_MS debe durar al menos un tick de FreeRTOS");
+
+/**
+ * @struct instantanea_sensores
+ * @brief Valores de un lote de lecturas de los sensores de seguridad.
+ */
+struct instantanea_sensores
+{
+  float bateria;        ///< Tensión de batería (V).
+  float corriente;      ///< Corriente del motor (A), convertida cada @ref SENSORES_PERIODO_CORRIENTE_MS.
+  float temperatura;    ///< Temperatura del chip (°C).
+  bool encoderOk;       ///< `false` si el motor está accionado y el encoder no cuenta.
+  bool corrienteValida; ///< `true` si la última conversión de la corriente ha funcionado.
+  bool valida;          ///< `true` si todas las lecturas del lote han funcionado.
+  uint32_t numero;      ///< Número de publicación (crece en cada una, también en las de solo corriente).
+  int64_t tiempo;       ///< Instante de la lectura (µs desde el arranque).
+};
+
+/**
+ * @struct seqlock_sensores
+ * @brief Instantánea publicada con contador de secuencia (un escritor, varios lectores).
+ */
+struct seqlock_sensores
+{
+  atomic_uint_least32_t secuencia;    ///< Impar mientras se escribe.
+  struct instantanea_sensores datos;  ///< Última instantánea publicada.
+};
+
+struct seqlock_sensores sensoresPublicados; ///< Última instantánea de los sensores de seguridad.
+TaskHandle_t tareaSensores = NULL;          ///< Tarea de adquisición de los sensores.
+
+adc_oneshot_unit_handle_t adcSensores = NULL; ///< Unidad ADC1 en modo oneshot compartida por los sensores.
+temperature_sensor_handle_t sensorTemperatura = NULL; ///< Sensor de temperatura interno.
+adc_channel_t canalBateria;                   ///< Canal ADC asociado a @ref bateriaPin.
+adc_cali_handle_t caliBateria = NULL;         ///< Calibración del canal de batería (`NULL` si no hay).
+adc_channel_t canalCorriente;                 ///< Canal ADC asociado a @ref corrienteMotorPin.
+adc_cali_handle_t caliCorriente = NULL;       ///< Calibración del canal de corriente (`NULL` si no hay).
+bool bateriaDisponible = false;               ///< `true` si el canal de batería está configurado.
+bool corrienteDisponible = false;             ///< `true` si el canal de corriente está configurado.
+
+// ==========================
+//   ADC compartido
+// ==========================
+
+/**
+ * @brief Configura un pin de ADC1 en la unidad compartida @ref adcSensores (la crea si hace falta).
+ * @param pin GPIO analógico.
+ * @param canal Canal asociado al pin.
+ * @param cali Calibración del canal, o `NULL` si el esquema no está disponible.
+ * @return `ESP_OK`, `ESP_ERR_NOT_SUPPORTED` si el pin no es de ADC1, o el error del driver.
+ */
+esp_err_t sensores_configurar_canal(int pin, adc_channel_t *canal, adc_cali_handle_t *cali)
+{
+  adc_unit_t unidad;
+  esp_err_t err = adc_oneshot_io_to_channel(pin, &unidad, canal);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+  if (unidad != ADC_UNIT_1)
+  {
+    return ESP_ERR_NOT_SUPPORTED; // ADC2 está ocupado por la adquisición EMG en modo continuo
+  }
+
+  if (adcSensores == NULL)
+  {
+    adc_oneshot_unit_init_cfg_t unidad_cfg = {0};
+    unidad_cfg.unit_id = ADC_UNIT_1;
+    err = adc_oneshot_new_unit(&unidad_cfg, &adcSensores);
+    if (err != ESP_OK)
+    {
+      adcSensores = NULL;
+      return err;
+    }
+  }
+
+  adc_oneshot_chan_cfg_t canal_cfg = {0};
+  canal_cfg.atten = ADC_ATTEN_DB_12;
+  canal_cfg.bitwidth = ADC_BITWIDTH_DEFAULT;
+  err = adc_oneshot_config_channel(adcSensores, *canal, &canal_cfg);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+
+  *cali = NULL;
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+  adc_cali_curve_fitting_config_t cali_cfg = {0};
+  cali_cfg.unit_id = ADC_UNIT_1;
+  cali_cfg.chan = *canal;
+  cali_cfg.atten = ADC_ATTEN_DB_12;
+  cali_cfg.bitwidth = ADC_BITWIDTH_DEFAULT;
+  if (adc_cali_create_scheme_curve_fitting(&cali_cfg, cali) != ESP_OK)
+  {
+    *cali = NULL;
+  }
+#endif
+  return ESP_OK;
+}
+
+/**
+ * @brief Convierte un canal de @ref adcSensores y devuelve su tensión.
+ * @return Tensión en mV, o -1 si la conversión no se ha podido hacer (ADC ocupado o sin configurar).
+ */
+int sensores_leer_mv(adc_channel_t canal, adc_cali_handle_t cali)
+{
+  int crudo = 0;
+  if (adcSensores == NULL || adc_oneshot_read(adcSensores, canal, &crudo) != ESP_OK)
+  {
+    return -1;
+  }
+
+  int mv = 0;
+  if (cali == NULL || adc_cali_raw_to_voltage(cali, crudo, &mv) != ESP_OK)
+  {
+    mv = crudo * SENSORES_MV_FONDO_ESCALA / 4095;
+  }
+  return mv;
+}
+
+/**
+ * @brief Configura los canales de batería y de corriente del motor.
+ * @details Se llama al iniciar el motor, antes que @ref agarre_motor.h y la tarea de sensores.
+ */
+void sensores_iniciar_adc()
+{
+  bateriaDisponible = sensores_configurar_canal(bateriaPin, &canalBateria, &caliBateria) == ESP_OK;
+  corrienteDisponible = sensores_configurar_canal(corrienteMotorPin, &canalCorriente, &caliCorriente) == ESP_OK;
+}
+
+// ==========================
+//   Seqlock
+// ==========================
+
+/**
+ * @brief Publica una instantánea nueva (solo la tarea de sensores).
+ */
+static inline void sensores_publicar(const struct instantanea_sensores *s)
+{
+  uint32_t secuencia = atomic_load_explicit(&sensoresPublicados.secuencia, memory_order_relaxed);
+  atomic_store_explicit(&sensoresPublicados.secuencia, secuencia + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  sensoresPublicados.datos = *s;
+  atomic_store_explicit(&sensoresPublicados.secuencia, secuencia + 2, memory_order_release);
+}
+
+/**
+ * @brief Lee la última instantánea en tiempo constante y sin bloquear.
+ * @param s Copia de destino. Si no se consigue una lectura coherente conserva su contenido.
+ * @retval true  Si `s` contiene una instantánea coherente nueva.
+ * @retval false Si el escritor estaba publicando en todos los intentos.
+ */
+static inline bool sensores_leer(struct instantanea_sensores *s)
+{
+  for (int intento = 0; intento < SENSORES_REINTENTOS_LECTURA; intento++)
+  {
+    uint32_t antes = atomic_load_explicit(&sensoresPublicados.secuencia, memory_order_acquire);
+    if (antes & 1)
+    {
+      continue;
+    }
+    struct instantanea_sensores copia = sensoresPublicados.datos;
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&sensoresPublicados.secuencia, memory_order_relaxed) == antes)
+    {
+      *s = copia;
+      return true;
+    }
+  }
+  return false;
+}
+
+// ==========================
+//   Tarea de sensores
+// ==========================
+
+/**
+ * @brief Comprueba que el encoder cuenta mientras el motor está accionado.
+ * @param m Motor vigilado.
+ * @param ahora Instante actual (µs).
+ * @details Falla si el duty supera @ref SENSORES_DUTY_FALLO_ENCODER durante
+ * @ref SENSORES_TIEMPO_FALLO_ENCODER_MS sin ningún paso, lejos de los límites de recorrido.
+ */
+static bool sensores_encoder_ok(struct motores *m, int64_t ahora)
+{
+  static int64_t inicioSinPasos = 0;
+  static int cuentaAnterior = 0;
+
+  int cuenta = motores_raw_count(m);
+  bool accionado = m->duty >= SENSORES_DUTY_FALLO_ENCODER && m->position > m->min_pos && m->position < m->max_pos;
+  if (!accionado || cuenta != cuentaAnterior)
+  {
+    inicioSinPasos = 0;
+    cuentaAnterior = cuenta;
+    return true;
+  }
+  if (inicioSinPasos == 0)
+  {
+    inicioSinPasos = ahora;
+  }
+  return (ahora - inicioSinPasos) < SENSORES_TIEMPO_FALLO_ENCODER_MS * 1000LL;
+}
+
+/**
+ * @brief Tarea de sensores: la corriente cada @ref SENSORES_PERIODO_CORRIENTE_MS y el resto del
+ * lote cada @ref SENSORES_PERIODO_MS.
+ * @param parametros Motor vigilado (`struct motores *`).
+ * @details Actualiza también @ref nivelBateria (mV en el pin de batería).
+ */
+void sensores_tarea(void *parametros)
+{
+  struct motores *m = (struct motores *)parametros;
+  struct instantanea_sensores s = {0};
+  TickType_t ultimoDespertar = xTaskGetTickCount();
+  bool loteValido = false;
+
+  for (uint32_t vuelta = 0;; vuelta = (vuelta + 1) % SENSORES_VUELTAS_LOTE)
+  {
+    s.tiempo = esp_timer_get_time();
+
+    if (vuelta == 0)
+    {
+      loteValido = true;
+      int mvBateria = bateriaDisponible ? sensores_leer_mv(canalBateria, caliBateria) : -1;
+      if (mvBateria >= 0)
+      {
+        nivelBateria = (uint16_t)mvBateria;
+        s.bateria = mvBateria * SENSORES_DIVISOR_BATERIA / 1000.0f;
+      }
+      else
+      {
+        loteValido = false;
+      }
+
+      if (sensorTemperatura == NULL || temperature_sensor_get_celsius(sensorTemperatura, &s.temperatura) != ESP_OK)
+      {
+        loteValido = false;
+      }
+    }
+
+    int mvCorriente = corrienteDisponible ? sensores_leer_mv(canalCorriente, caliCorriente) : -1;
+    s.corrienteValida = mvCorriente >= 0;
+    if (s.corrienteValida)
+    {
+      s.corriente = mvCorriente / CORRIENTE_MOTOR_MV_POR_AMPERIO;
+    }
+
+    s.valida = loteValido && s.corrienteValida;
+    s.encoderOk = sensores_encoder_ok(m, s.tiempo);
+    s.numero++;
+    sensores_publicar(&s);
+
+    xTaskDelayUntil(&ultimoDespertar, pdMS_TO_TICKS(SENSORES_PERIODO_CORRIENTE_MS));
+  }
+}
+
+/**
+ * @brief Configura los sensores de seguridad y arranca su tarea.
+ * @param m Motor vigilado.
+ * @return `ESP_OK` si la tarea está en marcha. Un sensor que no se pueda configurar no impide el
+ * arranque: sus lecturas marcan la instantánea como no válida.
+ * @note Los canales del ADC se configuran antes, con @ref sensores_iniciar_adc.
+ */
+esp_err_t sensores_iniciar(struct motores *m)
+{
+  temperature_sensor_config_t temp_cfg = TEMPERATURE_SENSOR_CONFIG_DEFAULT(-10, 80);
+  if (temperature_sensor_install(&temp_cfg, &sensorTemperatura) != ESP_OK ||
+      temperature_sensor_enable(sensorTemperatura) != ESP_OK)
+  {
+    sensorTemperatura = NULL;
+  }
+
+  if (xTaskCreatePinnedToCore(sensores_tarea, "sensores", 3072, m, SENSORES_PRIORIDAD, &tareaSensores, NUCLEO_ADQUISICION) != pdPASS)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
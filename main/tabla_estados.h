@@ -0,0 +1,164 @@
+/**
+ * @file tabla_estados.h
+ * @brief Estados, fases y tabla de acciones y transiciones de la prótesis, común a C y C++.
+ * @details
+ * Una sola tabla, @ref tablaEstados, en orden `[estado][fase]` y guardada en flash, define para
+ * cada combinación:
+ * - El movimiento del motor (@ref Movimiento_Motor) y si se usa la velocidad de calibración.
+ * - La referencia de posición que se impone al encoder (@ref Referencia_Posicion).
+ * - La fase o el estado al que se pasa cuando la fase termina (@ref maquina_completar_fase).
+ * - Las fases a las que se puede saltar desde ella (`permitidas`).
+ *
+ * La tabla se escribe una vez en @ref TABLA_ESTADOS y de ahí se generan los datos y las
+ * comprobaciones en compilación: orden completo `[estado][fase]`, fase siguiente permitida y
+ * constantes `PERMITIDAS_<estado>_<fase>` con las que @ref MAQUINA_CAMBIAR_FASE rechaza en
+ * compilación un salto no permitido.
+ *
+ * Resumen por estado (ver la tabla para el detalle):
+ * - @ref ESTADO_NORMAL: `FASE_PAUSA` reposo, `FASE_PASO_1` abrir, `FASE_PASO_2` cerrar.
+ * - @ref ESTADO_DESCANSO: `FASE_PASO_1` parada, `FASE_PASO_2` apertura y vuelta a normal.
+ * - @ref ESTADO_SEGURIDAD: `FASE_PASO_1` abrir, `FASE_PASO_2` parar, `FASE_CAMBIO_ESTADO` volver a normal.
+ * - @ref ESTADO_CALIBRADO_UMBRALES: `FASE_PASO_1` contracción, `FASE_PASO_2` reposo (ver calibracion_umbrales.h).
+ * - @ref ESTADO_CALIBRADO_MOTORES: `FASE_PASO_1` abrir y `FASE_PASO_2` cerrar en manual con la
+ *   posición fija en el punto medio; `FASE_CAMBIO_ESTADO` fija la posición 0 y vuelve a normal.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+#define TABLA_ASSERT static_assert
+#else
+#define TABLA_ASSERT _Static_assert
+#endif
+
+/**
+ * @enum Estado_Protesis
+ * @brief Estados posibles de la prótesis.
+ */
+enum Estado_Protesis
+{
+  ESTADO_NORMAL,             ///< Funcionamiento normal de la prótesis.
+  ESTADO_DESCANSO,           ///< Pausa controlada.
+  ESTADO_SEGURIDAD,          ///< Modo de seguridad (apertura y parada de motores).
+  ESTADO_CALIBRADO_UMBRALES, ///< Calibración de umbrales de activación/desactivación.
+  ESTADO_CALIBRADO_MOTORES,  ///< Calibración de límites mecánicos del motor.
+  NUMERO_ESTADOS
+};
+
+/**
+ * @enum Fase_Estado
+ * @brief Fases de cada estado. Su significado depende del estado (ver @ref TABLA_ESTADOS).
+ */
+enum Fase_Estado
+{
+  FASE_PAUSA,         ///< Motores en reposo hasta que cambie la fase o el estado.
+  FASE_PASO_1,        ///< Primera acción del estado.
+  FASE_PASO_2,        ///< Segunda acción del estado.
+  FASE_CAMBIO_ESTADO, ///< Configuración de posición y cambio de estado.
+  NUMERO_FASES
+};
+
+/**
+ * @enum Movimiento_Motor
+ * @brief Orden al motor. El bit 0 es @ref motorAbrir y el bit 1 @ref motorCerrar.
+ */
+enum Movimiento_Motor
+{
+  MOVIMIENTO_PARADO = 0,
+  MOVIMIENTO_ABRIR = 1,
+  MOVIMIENTO_CERRAR = 2
+};
+
+/**
+ * @enum Referencia_Posicion
+ * @brief Posición que se impone al encoder en cada ciclo de control.
+ */
+enum Referencia_Posicion
+{
+  REFERENCIA_LIBRE,      ///< La posición la da el encoder.
+  REFERENCIA_INTERMEDIA, ///< Punto medio del recorrido: permite mover en manual hacia ambos lados.
+  REFERENCIA_CERO        ///< Se fija la posición 0 (mano abierta) y la fase termina.
+};
+
+#define BIT_FASE(f) (1u << (f)) ///< Máscara de una fase para el campo `permitidas`.
+
+/**
+ * @brief Tabla de la máquina de estados, en orden `[estado][fase]`:
+ * `ENTRADA(estado, fase, movimiento, lento, referencia, fase siguiente, estado siguiente, permitidas)`.
+ * @details `lento` = 1 usa la velocidad de calibración (`velocidad_calibracion`, @ref parametros.h). Si el estado siguiente es distinto
+ * del propio, al terminar la fase se cambia de estado y la fase siguiente no se usa.
+ */
+#define TABLA_ESTADOS(ENTRADA)                                                                                                                                             \
+  ENTRADA(ESTADO_NORMAL, FASE_PAUSA, MOVIMIENTO_PARADO, 0, REFERENCIA_LIBRE, FASE_PAUSA, ESTADO_NORMAL, BIT_FASE(FASE_PASO_1) | BIT_FASE(FASE_PASO_2))                     \
+  ENTRADA(ESTADO_NORMAL, FASE_PASO_1, MOVIMIENTO_ABRIR, 0, REFERENCIA_LIBRE, FASE_PAUSA, ESTADO_NORMAL, BIT_FASE(FASE_PAUSA) | BIT_FASE(FASE_PASO_2))                      \
+  ENTRADA(ESTADO_NORMAL, FASE_PASO_2, MOVIMIENTO_CERRAR, 0, REFERENCIA_LIBRE, FASE_PAUSA, ESTADO_NORMAL, BIT_FASE(FASE_PAUSA) | BIT_FASE(FASE_PASO_1))                     \
+  ENTRADA(ESTADO_NORMAL, FASE_CAMBIO_ESTADO, MOVIMIENTO_PARADO, 0, REFERENCIA_LIBRE, FASE_PAUSA, ESTADO_NORMAL, BIT_FASE(FASE_PAUSA))                                      \
+  ENTRADA(ESTADO_DESCANSO, FASE_PAUSA, MOVIMIENTO_PARADO, 0, REFERENCIA_LIBRE, FASE_PASO_1, ESTADO_DESCANSO, BIT_FASE(FASE_PASO_1))                                        \
+  ENTRADA(ESTADO_DESCANSO, FASE_PASO_1, MOVIMIENTO_PARADO, 0, REFERENCIA_LIBRE, FASE_PASO_2, ESTADO_DESCANSO, BIT_FASE(FASE_PASO_2))                                       \
+  ENTRADA(ESTADO_DESCANSO, FASE_PASO_2, MOVIMIENTO_ABRIR, 0, REFERENCIA_LIBRE, FASE_PAUSA, ESTADO_NORMAL, 0)                                                               \
+  ENTRADA(ESTADO_DESCANSO, FASE_CAMBIO_ESTADO, MOVIMIENTO_PARADO, 0, REFERENCIA_LIBRE, FASE_PAUSA, ESTADO_NORMAL, 0)                                                       \
+  ENTRADA(ESTADO_SEGURIDAD, FASE_PAUSA, MOVIMIENTO_PARADO, 0, REFERENCIA_LIBRE, FASE_CAMBIO_ESTADO, ESTADO_SEGURIDAD, BIT_FASE(FASE_PASO_1) | BIT_FASE(FASE_PASO_2) | BIT_FASE(FASE_CAMBIO_ESTADO)) \
+  ENTRADA(ESTADO_SEGURIDAD, FASE_PASO_1, MOVIMIENTO_ABRIR, 0, REFERENCIA_LIBRE, FASE_PASO_2, ESTADO_SEGURIDAD, BIT_FASE(FASE_PASO_2))                                      \
+  ENTRADA(ESTADO_SEGURIDAD, FASE_PASO_2, MOVIMIENTO_PARADO, 0, REFERENCIA_LIBRE, FASE_CAMBIO_ESTADO, ESTADO_SEGURIDAD, BIT_FASE(FASE_CAMBIO_ESTADO))                       \
+  ENTRADA(ESTADO_SEGURIDAD, FASE_CAMBIO_ESTADO, MOVIMIENTO_PARADO, 0, REFERENCIA_LIBRE, FASE_PAUSA, ESTADO_NORMAL, BIT_FASE(FASE_PAUSA))                                   \
+  ENTRADA(ESTADO_CALIBRADO_UMBRALES, FASE_PAUSA, MOVIMIENTO_PARADO, 1, REFERENCIA_LIBRE, FASE_PASO_1, ESTADO_CALIBRADO_UMBRALES, BIT_FASE(FASE_PASO_1) | BIT_FASE(FASE_PASO_2)) \
+  ENTRADA(ESTADO_CALIBRADO_UMBRALES, FASE_PASO_1, MOVIMIENTO_PARADO, 1, REFERENCIA_LIBRE, FASE_PAUSA, ESTADO_CALIBRADO_UMBRALES, BIT_FASE(FASE_PAUSA))                     \
+  ENTRADA(ESTADO_CALIBRADO_UMBRALES, FASE_PASO_2, MOVIMIENTO_PARADO, 1, REFERENCIA_LIBRE, FASE_PAUSA, ESTADO_NORMAL, BIT_FASE(FASE_PAUSA))                                 \
+  ENTRADA(ESTADO_CALIBRADO_UMBRALES, FASE_CAMBIO_ESTADO, MOVIMIENTO_PARADO, 1, REFERENCIA_LIBRE, FASE_PAUSA, ESTADO_NORMAL, BIT_FASE(FASE_PAUSA))                          \
+  ENTRADA(ESTADO_CALIBRADO_MOTORES, FASE_PAUSA, MOVIMIENTO_PARADO, 1, REFERENCIA_INTERMEDIA, FASE_CAMBIO_ESTADO, ESTADO_CALIBRADO_MOTORES, BIT_FASE(FASE_PASO_1) | BIT_FASE(FASE_PASO_2) | BIT_FASE(FASE_CAMBIO_ESTADO)) \
+  ENTRADA(ESTADO_CALIBRADO_MOTORES, FASE_PASO_1, MOVIMIENTO_ABRIR, 1, REFERENCIA_INTERMEDIA, FASE_PAUSA, ESTADO_CALIBRADO_MOTORES, BIT_FASE(FASE_PAUSA) | BIT_FASE(FASE_PASO_2) | BIT_FASE(FASE_CAMBIO_ESTADO)) \
+  ENTRADA(ESTADO_CALIBRADO_MOTORES, FASE_PASO_2, MOVIMIENTO_CERRAR, 1, REFERENCIA_INTERMEDIA, FASE_PAUSA, ESTADO_CALIBRADO_MOTORES, BIT_FASE(FASE_PAUSA) | BIT_FASE(FASE_PASO_1) | BIT_FASE(FASE_CAMBIO_ESTADO)) \
+  ENTRADA(ESTADO_CALIBRADO_MOTORES, FASE_CAMBIO_ESTADO, MOVIMIENTO_PARADO, 1, REFERENCIA_CERO, FASE_PAUSA, ESTADO_NORMAL, BIT_FASE(FASE_PAUSA))
+
+/**
+ * @struct accion_estado
+ * @brief Entrada de @ref tablaEstados.
+ */
+struct accion_estado
+{
+  uint8_t movimiento;       ///< @ref Movimiento_Motor.
+  uint8_t lento;            ///< `1` = velocidad de calibración.
+  uint8_t referencia;       ///< @ref Referencia_Posicion.
+  uint8_t fase_siguiente;   ///< Fase al terminar la actual (si no se cambia de estado).
+  uint8_t estado_siguiente; ///< Estado al terminar la fase actual.
+  uint8_t permitidas;       ///< Máscara (@ref BIT_FASE) de las fases a las que se puede saltar.
+};
+
+// Comprobaciones en compilación de la tabla
+#define TABLA_ORDEN(e, f, mov, lento, ref, fs, es, perm) ORDEN_##e##_##f,
+#define TABLA_PERMITIDAS(e, f, mov, lento, ref, fs, es, perm) PERMITIDAS_##e##_##f = (perm),
+#define TABLA_VALIDAR(e, f, mov, lento, ref, fs, es, perm)                                                      \
+  TABLA_ASSERT(ORDEN_##e##_##f == (e) * NUMERO_FASES + (f), "TABLA_ESTADOS: " #e "/" #f " fuera de orden");  \
+  TABLA_ASSERT((es) != (e) || (fs) == (f) || (((perm) >> (fs)) & 1u), "TABLA_ESTADOS: " #e "/" #f ": fase siguiente no permitida"); \
+  TABLA_ASSERT((perm) < BIT_FASE(NUMERO_FASES), "TABLA_ESTADOS: " #e "/" #f ": fase permitida inexistente");
+#define TABLA_ACCION(e, f, mov, lento, ref, fs, es, perm) {(mov), (lento), (ref), (fs), (es), (perm)},
+
+enum Orden_Tabla_Estados
+{
+  TABLA_ESTADOS(TABLA_ORDEN)
+  TABLA_NUMERO_ENTRADAS
+};
+enum Permitidas_Tabla_Estados
+{
+  TABLA_ESTADOS(TABLA_PERMITIDAS)
+};
+TABLA_ASSERT(TABLA_NUMERO_ENTRADAS == NUMERO_ESTADOS * NUMERO_FASES, "TABLA_ESTADOS debe cubrir todos los pares [estado][fase]");
+TABLA_ESTADOS(TABLA_VALIDAR)
+
+/// Acciones y transiciones en orden `[estado][fase]` (índice `estado * NUMERO_FASES + fase`), en flash.
+static const struct accion_estado tablaEstados[NUMERO_ESTADOS * NUMERO_FASES] = {TABLA_ESTADOS(TABLA_ACCION)};
+
+/**
+ * @brief Entrada de @ref tablaEstados de un estado y una fase. Acceso directo, sin saltos.
+ */
+static inline const struct accion_estado *tabla_accion(enum Estado_Protesis e, enum Fase_Estado f)
+{
+  return &tablaEstados[(unsigned)e * NUMERO_FASES + (unsigned)f];
+}
+
+/**
+ * @brief `1` si desde la fase `desde` del estado `e` se puede saltar a `hacia`. Es una expresión constante.
+ */
+#define MAQUINA_FASE_PERMITIDA(e, desde, hacia) ((PERMITIDAS_##e##_##desde >> (hacia)) & 1u)
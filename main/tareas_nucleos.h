@@ -0,0 +1,370 @@
+/**
+ * @file tareas_nucleos.h
+ * @brief Reparto del procesado en dos núcleos y bucle de control marcado por un temporizador hardware.
+ * @details
+ * - Núcleo @ref NUCLEO_ADQUISICION (@ref task_core0): recibe cada bloque del ADC
+ *   (@ref muestreo_emg.h), filtra todos sus canales (@ref filtro_emg.h) y lo publica en
+ *   @ref anilloFiltrado con la misma disposición (una fila por canal). Con @ref ESPECTRO_EMG pasa
+ *   además una copia a la tarea espectral (@ref espectro_emg.h), de menor prioridad en este núcleo.
+ *   Con una grabación en curso el bloque crudo se añade también a @ref grabacion_emg.h.
+ * - Núcleo @ref NUCLEO_CONTROL (@ref task_core1): despertado por un gptimer a
+ *   @ref FREC_BUCLE_CONTROL, consume los bloques filtrados pendientes (características con
+ *   @ref ventana_deslizante.h, inferencia con @ref inferencia_emg.h, decisión y gestos con
+ *   @ref gestos_emg.h), aplica los gestos reconocidos a la máquina de estados y ejecuta
+ *   @ref activacionMotores.
+ *
+ * Ninguna de las dos tareas usa `vTaskDelay`: la de adquisición la despierta el DMA y la de
+ * control el temporizador, de modo que la latencia desde que un bloque está filtrado hasta la
+ * orden al motor queda acotada por un periodo del bucle de control más su tiempo de ejecución.
+ * Esa latencia se mide en cada bloque (@ref latenciaControlUs, @ref latenciaControlMaximaUs) y
+ * los periodos que el bucle no llega a atender se cuentan en @ref periodosControlPerdidos.
+ * Cada bloque lleva además su instante de captura (@ref tiempoCapturaFiltrado), con el que se
+ * fechan los saltos de la ventana y, con @ref LATENCIA_EXTREMO, se mide la latencia desde la
+ * muestra que produce una orden hasta el PWM (@ref latencia.h). Con @ref PLAZOS_VIGILANCIA cada
+ * etapa se compara con su plazo y la sobrecarga degrada el procesado por niveles (@ref plazos.h).
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "driver/gptimer.h"
+#include "globales.h"
+#include "parametros.h"
+#include "anillo_bloques.h"
+#include "muestreo_emg.h"
+#include "filtro_emg.h"
+#include "ventana_deslizante.h"
+#include "espectro_emg.h"
+#include "inferencia_emg.h"
+#include "calibracion_umbrales.h"
+#include "gestos_emg.h"
+#include "grabacion_emg.h"
+#include "latencia.h"
+#include "plazos.h"
+#include "activacion_motores.h"
+#include "sensores.h"
+#include "persistencia.h"
+#include "perfilado.h"
+
+_Static_assert(TIMER_FREQ % FREC_BUCLE_CONTROL == 0, "FREC_BUCLE_CONTROL debe dividir a TIMER_FREQ");
+
+// ==========================
+//   Traspaso entre núcleos
+// ==========================
+struct anillo_bloques anilloFiltrado;              ///< Bloques filtrados (@ref muestra_emg_t) del núcleo de adquisición al de control.
+int64_t tiempoBloqueFiltrado[ANILLO_NUM_BLOQUES];  ///< Instante (µs) en que se publicó cada hueco de @ref anilloFiltrado.
+int64_t tiempoCapturaFiltrado[ANILLO_NUM_BLOQUES]; ///< Instante (µs) de captura de cada hueco de @ref anilloFiltrado (@ref tiempoCapturaEMG de su bloque crudo).
+int64_t tiempoBloqueDecision = 0;                  ///< Instante (µs) de captura de la última muestra del bloque que recorre la ventana en el núcleo de control.
+
+gptimer_handle_t temporizadorControl = NULL;       ///< Temporizador que marca el bucle de control.
+volatile uint32_t periodosControlPerdidos = 0;     ///< Periodos del temporizador que el bucle de control no ha atendido a tiempo.
+volatile uint32_t latenciaControlUs = 0;           ///< Latencia del último bloque, de filtrado a orden al motor (µs).
+volatile uint32_t latenciaControlMaximaUs = 0;     ///< Latencia máxima observada desde el arranque (µs).
+struct resultado_espectro espectroControl;         ///< Última copia del resultado espectral en el núcleo de control.
+
+/**
+ * @brief Inferencia y decisión, llamadas en cada salto de la ventana deslizante.
+ * @details Cada característica del canal principal se activa al superar su umbral de activación y
+ * se desactiva al bajar de su umbral de desactivación. Con @ref DETECCION_INFERENCIA la red se
+ * ejecuta sobre la matriz de todos los canales, con el último resultado espectral que haya
+ * (@ref espectro_leer, sin esperar), y deja su salida en @ref result; sin ella no se ejecuta,
+ * porque nadie usaría su salida.
+ * @ref resultDeteccion vale 1 si alguna característica está activa o, con
+ * @ref DETECCION_INFERENCIA, si la probabilidad de la red supera `umbral_inferencia`. Umbrales del
+ * bloque @ref parametrosControl, fijos durante todo el periodo. En
+ * @ref ESTADO_CALIBRADO_UMBRALES las características del canal principal alimentan además
+ * @ref calibracion_actualizar. La decisión pasa al decodificador de gestos con el instante de la
+ * muestra que completa el salto, contado hacia atrás desde @ref tiempoBloqueDecision. Con
+ * @ref NIVEL_SALTO_DOBLE solo se decide en uno de cada dos saltos y con @ref NIVEL_SIN_ESPECTRO la
+ * red recibe ceros en las entradas espectrales.
+ */
+static void tareas_decidir(const float caracteristicas[NUMERO_CANALES_EMG][NUMERO_CARACTERISTICAS], uint32_t muestra)
+{
+  static uint32_t saltosDecision = 0;
+  if (plazos_degradado(NIVEL_SALTO_DOBLE) && (saltosDecision++ & 1u))
+  {
+    return;
+  }
+  PERFIL_INICIO(PERFIL_DECISION);
+  const float *principal = caracteristicas[CANAL_EMG_PRINCIPAL];
+  float mav = principal[CARACTERISTICA_MAV];
+  float var = principal[CARACTERISTICA_VARIANZA];
+  float wl = principal[CARACTERISTICA_WL];
+  const struct parametros_ajustables *ajustes = parametrosControl;
+
+  calibracion_actualizar(principal);
+
+  MAVActivada = MAVActivada ? (mav >= ajustes->umbralDesMAV) : (mav > ajustes->umbralActMAV);
+  VarActivada = VarActivada ? (var >= ajustes->umbralDesVar) : (var > ajustes->umbralActVar);
+  WLActivada = WLActivada ? (wl >= ajustes->umbralDesWL) : (wl > ajustes->umbralActWL);
+#if ESPECTRO_EMG
+  if (plazos_degradado(NIVEL_SIN_ESPECTRO))
+  {
+    memset(&espectroControl, 0, sizeof(espectroControl));
+  }
+  else if (espectro_leer(&espectroControl))
+  {
+    frecuenciaMediaEMG = espectroControl.caracteristicas[CANAL_EMG_PRINCIPAL][ESPECTRO_FRECUENCIA_MEDIA];
+    frecuenciaMedianaEMG = espectroControl.caracteristicas[CANAL_EMG_PRINCIPAL][ESPECTRO_FRECUENCIA_MEDIANA];
+  }
+#endif
+#if DETECCION_INFERENCIA
+  inferencia_ejecutar(caracteristicas, espectroControl.caracteristicas);
+  resultDeteccion = (result[0] > ajustes->umbralInferencia) ? 1 : 0;
+#else
+  resultDeteccion = (MAVActivada || VarActivada || WLActivada) ? 1 : 0;
+#endif
+  gestos_actualizar(resultDeteccion != 0,
+                    tiempoBloqueDecision - (int64_t)(ANILLO_MUESTRAS_POR_BLOQUE - 1 - muestra) * 1000000 / SAMPLING_FREQ);
+  PERFIL_FIN(PERFIL_DECISION);
+}
+
+/**
+ * @brief Tarea de adquisición y filtrado (núcleo @ref NUCLEO_ADQUISICION).
+ * @details Si @ref anilloFiltrado está lleno el bloque se filtra igualmente, para no romper la
+ * continuidad del estado de los biquads, pero se descarta y queda contado en el anillo. Tras un
+ * reinicio software el estado de los biquads se recupera de la memoria RTC (@ref persistencia.h).
+ */
+void tarea_adquisicion(void *parametros)
+{
+  static muestra_emg_t descarte[ANILLO_MUESTRAS_HUECO];
+
+  if (!persistencia_restaurar_filtro())
+  {
+    filtro_reiniciar();
+  }
+  if (muestreo_iniciar(xTaskGetCurrentTaskHandle()) != ESP_OK)
+  {
+    vTaskDelete(NULL);
+    return;
+  }
+
+  while (1)
+  {
+    const uint16_t *crudo = muestreo_esperar_bloque(portMAX_DELAY);
+    if (crudo == NULL)
+    {
+      continue;
+    }
+
+    grabacion_anotar(crudo);
+    int64_t captura = tiempoCapturaEMG[anillo_hueco(&anilloEMG, crudo)];
+    uint16_t *destino = anillo_reservar(&anilloFiltrado);
+    muestra_emg_t *filtrado = destino != NULL ? (muestra_emg_t *)destino : descarte;
+    PERFIL_INICIO(PERFIL_FILTRO);
+    filtro_procesar_bloque(crudo, filtrado, ANILLO_MUESTRAS_POR_BLOQUE, ANILLO_FILA_CANAL);
+    PERFIL_FIN(PERFIL_FILTRO);
+    muestreo_liberar_bloque();
+    persistencia_guardar_filtro();
+#if ESPECTRO_EMG
+    if (plazos_degradado(NIVEL_SIN_ESPECTRO))
+    {
+      espectro_omitir_bloque();
+    }
+    else
+    {
+      espectro_enviar_bloque(filtrado);
+    }
+#endif
+
+    if (destino != NULL)
+    {
+      uint32_t hueco = anillo_hueco(&anilloFiltrado, destino);
+      tiempoBloqueFiltrado[hueco] = esp_timer_get_time();
+      tiempoCapturaFiltrado[hueco] = captura;
+      anillo_publicar(&anilloFiltrado);
+    }
+    plazos_anotar(PLAZO_ADQUISICION, captura, esp_timer_get_time());
+  }
+}
+
+/**
+ * @brief Alarma del temporizador de control: despierta a la tarea de control (`user_ctx`).
+ */
+static bool IRAM_ATTR tareas_alarma_control(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *user_ctx)
+{
+  BaseType_t despertar = pdFALSE;
+  vTaskNotifyGiveFromISR((TaskHandle_t)user_ctx, &despertar);
+  return despertar == pdTRUE;
+}
+
+/**
+ * @brief Configura y arranca el temporizador que marca el bucle de control.
+ * @details Se llama desde la propia tarea de control para que la interrupción quede en su núcleo.
+ */
+static esp_err_t tareas_iniciar_temporizador()
+{
+  gptimer_config_t cfg = {0};
+  cfg.clk_src = GPTIMER_CLK_SRC_DEFAULT;
+  cfg.direction = GPTIMER_COUNT_UP;
+  cfg.resolution_hz = TIMER_FREQ;
+  esp_err_t err = gptimer_new_timer(&cfg, &temporizadorControl);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+
+  gptimer_event_callbacks_t cbs = {0};
+  cbs.on_alarm = tareas_alarma_control;
+  err = gptimer_register_event_callbacks(temporizadorControl, &cbs, xTaskGetCurrentTaskHandle());
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+
+  gptimer_alarm_config_t alarma = {0};
+  alarma.alarm_count = TIMER_FREQ / FREC_BUCLE_CONTROL;
+  alarma.reload_count = 0;
+  alarma.flags.auto_reload_on_alarm = true;
+  err = gptimer_set_alarm_action(temporizadorControl, &alarma);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+
+  err = gptimer_enable(temporizadorControl);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+  return gptimer_start(temporizadorControl);
+}
+
+/**
+ * @brief Aplica un gesto a la máquina de estados y, si cambia la fase, arma la medida de latencia.
+ */
+static inline void tareas_aplicar_gesto(const struct evento_gesto *gesto)
+{
+  enum Estado_Protesis estado = estado_protesis.estado_actual;
+  enum Fase_Estado fase = estado_protesis.fase_actual;
+  gestos_aplicar(gesto);
+  if (estado_protesis.estado_actual != estado || estado_protesis.fase_actual != fase)
+  {
+    latencia_armar(gesto->instanteUs);
+  }
+}
+
+/**
+ * @brief Tarea del bucle de control (núcleo @ref NUCLEO_CONTROL).
+ * @details En cada periodo: aplica los parámetros publicados desde el anterior
+ * (@ref parametros_confirmar), consume todos los bloques filtrados pendientes, actualiza las
+ * características, la decisión y los gestos, aplica los gestos recogidos de @ref colaGestos y la
+ * orden de calibración de motores de la consola (@ref calibracion_motores_aplicar), ejecuta
+ * @ref activacionMotores y mide la latencia del bloque más antiguo consumido en ese periodo.
+ * Si los motores no se pueden iniciar (@ref iniciaEncoder) la tarea termina sin accionarlos.
+ * Al final anota los plazos del periodo y de cada bloque y revisa la degradación (@ref plazos_revisar).
+ */
+void tarea_control(void *parametros)
+{
+  esp_err_t err = iniciaEncoder();
+  if (err != ESP_OK)
+  {
+    // Sin encoders no hay control de posición: la prótesis no se acciona
+    printf("motores no disponibles: %s\n", esp_err_to_name(err));
+    vTaskDelete(NULL);
+    return;
+  }
+  latencia_iniciar();
+  persistencia_restaurar_posicion();
+  sensores_iniciar(motorPrincipal);
+  ventanas_reiniciar();
+  if (tareas_iniciar_temporizador() != ESP_OK)
+  {
+    vTaskDelete(NULL);
+    return;
+  }
+
+  while (1)
+  {
+    uint32_t periodos = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    PERFIL_PERIODO(PERFIL_PERIODO_CONTROL);
+    PERFIL_INICIO(PERFIL_CONTROL);
+    int64_t inicioPeriodo = esp_timer_get_time();
+    if (periodos > 1)
+    {
+      periodosControlPerdidos += periodos - 1;
+    }
+    parametros_confirmar();
+
+    int64_t tiempoBloque = 0;
+    while (anillo_pendientes(&anilloFiltrado) > 0)
+    {
+      const uint16_t *bloque = anillo_bloque(&anilloFiltrado, 0);
+      uint32_t hueco = anillo_hueco(&anilloFiltrado, bloque);
+      tiempoBloqueDecision = tiempoCapturaFiltrado[hueco];
+      if (tiempoBloque == 0)
+      {
+        tiempoBloque = tiempoBloqueFiltrado[hueco];
+      }
+      // Las ventanas leen las filas del hueco directamente; el hueco se libera después
+      const muestra_emg_t *filas = (const muestra_emg_t *)bloque;
+      ultimaMuestraEMG = ANILLO_CANAL(filas, CANAL_EMG_PRINCIPAL)[0];
+      PERFIL_INICIO(PERFIL_CARACTERISTICAS);
+      ventana_procesar_bloque(filas, ANILLO_MUESTRAS_POR_BLOQUE, ANILLO_FILA_CANAL, tareas_decidir);
+      PERFIL_FIN(PERFIL_CARACTERISTICAS);
+      plazos_anotar(PLAZO_PROCESADO, tiempoBloqueDecision, esp_timer_get_time());
+      anillo_liberar(&anilloFiltrado);
+    }
+
+    struct evento_gesto gesto;
+    while (gestos_recibir(&gesto))
+    {
+      tareas_aplicar_gesto(&gesto);
+    }
+    calibracion_motores_aplicar();
+
+    PERFIL_INICIO(PERFIL_MOTORES);
+    activacionMotores();
+    PERFIL_FIN(PERFIL_MOTORES);
+    persistencia_guardar_posicion_rtc(posicionesMotores, motoresCalibrados && estado_protesis.estado_actual != ESTADO_CALIBRADO_MOTORES);
+
+    int64_t finPeriodo = esp_timer_get_time();
+    if (tiempoBloque != 0)
+    {
+      uint32_t latencia = (uint32_t)(finPeriodo - tiempoBloque);
+      latenciaControlUs = latencia;
+      if (latencia > latenciaControlMaximaUs)
+      {
+        latenciaControlMaximaUs = latencia;
+      }
+    }
+    plazos_anotar(PLAZO_CONTROL, inicioPeriodo, finPeriodo);
+    plazos_revisar(anillo_desbordamientos(&anilloEMG) + anillo_desbordamientos(&anilloFiltrado) + periodosControlPerdidos,
+                   &estado_protesis, motorArrived);
+    PERFIL_FIN(PERFIL_CONTROL);
+  }
+}
+
+/**
+ * @brief Crea las tareas de adquisición y de control, cada una fijada a su núcleo.
+ * @details La máquina de estados arranca en el estado que indica @ref persistencia_estado_arranque,
+ * así que debe llamarse después de @ref persistencia_iniciar.
+ * @return `ESP_OK` si la cola de gestos y ambas tareas se han creado, `ESP_ERR_NO_MEM` en caso contrario.
+ */
+esp_err_t tareas_iniciar()
+{
+  maquina_inicializar(&estado_protesis);
+  maquina_cambiarEstado(&estado_protesis, persistencia_estado_arranque());
+  if (gestos_iniciar() != ESP_OK)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+
+  if (xTaskCreatePinnedToCore(tarea_control, "control", 4096, NULL, PRIORIDAD_CONTROL, &task_core1, NUCLEO_CONTROL) != pdPASS)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+  if (xTaskCreatePinnedToCore(tarea_adquisicion, "adquisicion", 4096, NULL, PRIORIDAD_ADQUISICION, &task_core0, NUCLEO_ADQUISICION) != pdPASS)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+#if ESPECTRO_EMG
+  // Sin etapa espectral la red recibe ceros en esas entradas, el camino temporal no cambia
+  espectro_iniciar();
+#endif
+  return ESP_OK;
+}
@@ -0,0 +1,257 @@
+/**
+ * @file traza.h
+ * @brief Registro de depuración binario y no bloqueante, con un anillo por núcleo.
+ * @details
+ * @ref logTarea escribe un @ref RegistroTraza de 16 bytes en el anillo del núcleo que la ejecuta y
+ * vuelve inmediatamente; nunca espera. Si el anillo está lleno el registro se descarta y se cuenta
+ * en `descartados`. La marca de tiempo es el contador de ciclos de la CPU, sin llamar a
+ * `esp_timer_get_time()`.
+ *
+ * Varias tareas (o una interrupción) de un mismo núcleo pueden escribir a la vez: el hueco se
+ * reserva con una comparación e intercambio sobre `cabeza` y se confirma al final escribiendo su
+ * número de `secuencia` con semántica *release*. La tarea de vaciado (@ref traza_tarea_vaciado),
+ * de baja prioridad, solo consume registros confirmados y los envía por USB-Serial-JTAG.
+ *
+ * Formato en el cable (little endian):
+ * - Registro: `0xA0 | núcleo`, Δciclos (varint LEB128), tarea, `estado << 4 | fase`, resDet,
+ *   EMG (int16), posición del motor (uint16). Δciclos es la diferencia con el registro anterior
+ *   del mismo núcleo (el contador de ciclos es propio de cada núcleo).
+ * - Descartes: `0xB0 | núcleo`, total de registros descartados (varint). Se envía cuando cambia.
+ *
+ * @note USB-Serial-JTAG queda reservado para la traza: la consola secundaria está desactivada en
+ * `sdkconfig` para que los mensajes de texto no se mezclen con los registros binarios. Mientras
+ * @ref trazaCedida está activo (grabación en curso, ver grabacion_emg.h) el enlace es de otro
+ * flujo y la traza no envía nada.
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_err.h"
+#include "driver/usb_serial_jtag.h"
+#include "globales.h"
+
+#define TRAZA_REGISTROS_POR_NUCLEO 256 ///< Huecos del anillo de cada núcleo. Potencia de 2.
+#define TRAZA_BYTES_SALIDA 512         ///< Tamaño del bloque que la tarea de vaciado envía de una vez.
+#define TRAZA_PERIODO_VACIADO_MS 10    ///< Espera de la tarea de vaciado cuando no hay registros.
+#define TRAZA_PRIORIDAD_VACIADO 1      ///< Prioridad de la tarea de vaciado (justo por encima de idle).
+
+#define TRAZA_MARCA_REGISTRO 0xA0  ///< Primer byte de un registro (ORed con el núcleo).
+#define TRAZA_MARCA_DESCARTES 0xB0 ///< Primer byte de un contador de descartes (ORed con el núcleo).
+#define TRAZA_MAX_BYTES_PAQUETE 13 ///< Tamaño máximo de un paquete codificado.
+
+_Static_assert((TRAZA_REGISTROS_POR_NUCLEO & (TRAZA_REGISTROS_POR_NUCLEO - 1)) == 0, "TRAZA_REGISTROS_POR_NUCLEO debe ser potencia de 2");
+
+/**
+ * @struct RegistroTraza
+ * @brief Registro de ejecución de una tarea tal como se guarda en el anillo.
+ */
+typedef struct
+{
+  atomic_uint_least32_t secuencia; ///< Número de hueco + 1 una vez escrito el registro (0 = libre).
+  uint32_t ciclos;                 ///< Contador de ciclos de la CPU del núcleo.
+  int16_t emg;                     ///< Última muestra EMG filtrada.
+  uint16_t posMotor;               ///< Posición actual del motor.
+  uint8_t tarea;                   ///< ID de la tarea ejecutada.
+  uint8_t estado;                  ///< Estado actual de la prótesis (ver @ref Estado_Protesis).
+  uint8_t fase;                    ///< Fase actual (ver @ref Fase_Estado), empezando en 1.
+  uint8_t resDet;                  ///< Resultado detección EMG (0/1).
+} RegistroTraza;
+
+/**
+ * @struct traza_nucleo
+ * @brief Anillo de registros de un núcleo: varios productores del núcleo, un consumidor.
+ */
+struct traza_nucleo
+{
+  RegistroTraza registros[TRAZA_REGISTROS_POR_NUCLEO]; ///< Almacenamiento de los registros.
+  atomic_uint_least32_t cabeza;                        ///< Huecos reservados por los productores.
+  atomic_uint_least32_t cola;                          ///< Registros consumidos por la tarea de vaciado.
+  atomic_uint_least32_t descartados;                   ///< Registros perdidos por encontrarse el anillo lleno.
+};
+
+struct traza_nucleo trazaNucleos[portNUM_PROCESSORS]; ///< Un anillo de traza por núcleo.
+TaskHandle_t tareaVaciadoTraza = NULL;               ///< Tarea que envía la traza por USB-Serial-JTAG.
+atomic_bool trazaCedida = false;                     ///< `true` = USB-Serial-JTAG lo usa otro flujo y la traza no envía.
+atomic_bool trazaEnviando = false;                   ///< `true` mientras la tarea de vaciado escribe en USB-Serial-JTAG.
+
+/**
+ * @brief Escribe un registro de tarea en el anillo del núcleo actual sin bloquear.
+ * @param tareaID Identificador numérico de la tarea.
+ * @details Incluye en el registro: ciclos, estado, fase, ID de tarea, valor EMG, resultado de
+ * detección y posición del motor. Puede llamarse desde una interrupción.
+ */
+void IRAM_ATTR logTarea(uint8_t tareaID)
+{
+  struct traza_nucleo *t = &trazaNucleos[xPortGetCoreID()];
+
+  uint32_t cabeza = atomic_load_explicit(&t->cabeza, memory_order_relaxed);
+  do
+  {
+    uint32_t cola = atomic_load_explicit(&t->cola, memory_order_acquire);
+    if (cabeza - cola >= TRAZA_REGISTROS_POR_NUCLEO)
+    {
+      atomic_fetch_add_explicit(&t->descartados, 1, memory_order_relaxed);
+      return;
+    }
+  } while (!atomic_compare_exchange_weak_explicit(&t->cabeza, &cabeza, cabeza + 1,
+                                                  memory_order_relaxed, memory_order_relaxed));
+
+  RegistroTraza *r = &t->registros[cabeza & (TRAZA_REGISTROS_POR_NUCLEO - 1)];
+  r->ciclos = esp_cpu_get_cycle_count();
+  r->emg = (int16_t)ultimaMuestraEMG;
+  r->posMotor = posicionMotor;
+  r->tarea = tareaID;
+  r->estado = estado_protesis.estado_actual;
+  r->fase = estado_protesis.fase_actual + 1;
+  r->resDet = resultDeteccion;
+  atomic_store_explicit(&r->secuencia, cabeza + 1, memory_order_release);
+}
+
+/**
+ * @brief Escribe `v` en formato varint LEB128 (7 bits por byte, el bit alto indica continuación).
+ * @return Número de bytes escritos (1 a 5).
+ */
+static inline uint32_t traza_varint(uint8_t *p, uint32_t v)
+{
+  uint32_t n = 0;
+  while (v >= 0x80)
+  {
+    p[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  p[n++] = (uint8_t)v;
+  return n;
+}
+
+/**
+ * @brief Codifica los registros confirmados de un núcleo en `salida`.
+ * @param nucleo Núcleo cuyo anillo se vacía.
+ * @param salida Bloque de salida.
+ * @param usados Bytes ya ocupados en `salida`.
+ * @param ultimosCiclos Ciclos del último registro enviado de este núcleo (se actualiza).
+ * @return Bytes ocupados en `salida` tras añadir los registros.
+ */
+static uint32_t traza_codificar(int nucleo, uint8_t *salida, uint32_t usados, uint32_t *ultimosCiclos)
+{
+  struct traza_nucleo *t = &trazaNucleos[nucleo];
+  uint32_t cola = atomic_load_explicit(&t->cola, memory_order_relaxed);
+
+  while (usados + TRAZA_MAX_BYTES_PAQUETE <= TRAZA_BYTES_SALIDA)
+  {
+    RegistroTraza *r = &t->registros[cola & (TRAZA_REGISTROS_POR_NUCLEO - 1)];
+    if (atomic_load_explicit(&r->secuencia, memory_order_acquire) != cola + 1)
+    {
+      break; // Hueco libre o reservado pero aún sin confirmar
+    }
+
+    uint8_t *p = &salida[usados];
+    uint32_t n = 0;
+    p[n++] = TRAZA_MARCA_REGISTRO | nucleo;
+    n += traza_varint(&p[n], r->ciclos - *ultimosCiclos);
+    p[n++] = r->tarea;
+    p[n++] = (uint8_t)((r->estado << 4) | (r->fase & 0x0F));
+    p[n++] = r->resDet;
+    p[n++] = (uint8_t)r->emg;
+    p[n++] = (uint8_t)((uint16_t)r->emg >> 8);
+    p[n++] = (uint8_t)r->posMotor;
+    p[n++] = (uint8_t)(r->posMotor >> 8);
+    usados += n;
+    *ultimosCiclos = r->ciclos;
+
+    cola++;
+    atomic_store_explicit(&t->cola, cola, memory_order_release);
+  }
+  return usados;
+}
+
+/**
+ * @brief Tarea de vaciado: envía por USB-Serial-JTAG los registros de ambos núcleos.
+ * @details Alterna entre núcleos en bloques de @ref TRAZA_BYTES_SALIDA bytes y solo duerme cuando
+ * no queda nada pendiente. Si el host no lee, la escritura vence y los anillos se llenan, con lo
+ * que las tareas de control siguen sin esperar y los registros perdidos quedan contados. Lo mismo
+ * ocurre mientras @ref trazaCedida está activo.
+ */
+void traza_tarea_vaciado(void *parametros)
+{
+  static uint8_t salida[TRAZA_BYTES_SALIDA];
+  uint32_t ultimosCiclos[portNUM_PROCESSORS] = {0};
+  uint32_t descartesEnviados[portNUM_PROCESSORS] = {0};
+
+  while (1)
+  {
+    // Se anuncia la escritura antes de mirar la cesión; ver traza_ceder
+    atomic_store(&trazaEnviando, true);
+    if (atomic_load(&trazaCedida))
+    {
+      atomic_store_explicit(&trazaEnviando, false, memory_order_release);
+      vTaskDelay(pdMS_TO_TICKS(TRAZA_PERIODO_VACIADO_MS));
+      continue;
+    }
+
+    uint32_t usados = 0;
+    for (int nucleo = 0; nucleo < portNUM_PROCESSORS; nucleo++)
+    {
+      uint32_t descartados = atomic_load_explicit(&trazaNucleos[nucleo].descartados, memory_order_relaxed);
+      if (descartados != descartesEnviados[nucleo] && usados + TRAZA_MAX_BYTES_PAQUETE <= TRAZA_BYTES_SALIDA)
+      {
+        salida[usados++] = TRAZA_MARCA_DESCARTES | nucleo;
+        usados += traza_varint(&salida[usados], descartados);
+        descartesEnviados[nucleo] = descartados;
+      }
+      usados = traza_codificar(nucleo, salida, usados, &ultimosCiclos[nucleo]);
+    }
+
+    if (usados == 0)
+    {
+      atomic_store_explicit(&trazaEnviando, false, memory_order_release);
+      vTaskDelay(pdMS_TO_TICKS(TRAZA_PERIODO_VACIADO_MS));
+      continue;
+    }
+    usb_serial_jtag_write_bytes(salida, usados, pdMS_TO_TICKS(TRAZA_PERIODO_VACIADO_MS));
+    atomic_store_explicit(&trazaEnviando, false, memory_order_release);
+  }
+}
+
+/**
+ * @brief Cede USB-Serial-JTAG a otro flujo y espera a que termine la escritura de traza en curso.
+ * @details La tarea de vaciado anuncia cada escritura en @ref trazaEnviando antes de comprobar
+ * @ref trazaCedida, y aquí se activa la cesión antes de mirar ese indicador (ambos con orden
+ * secuencial), así que al volver no hay ni habrá bytes de traza mezclados con los del otro flujo.
+ * La espera está acotada por el plazo de escritura, @ref TRAZA_PERIODO_VACIADO_MS.
+ * Para devolver el enlace basta con poner @ref trazaCedida a `false`.
+ */
+void traza_ceder()
+{
+  atomic_store(&trazaCedida, true);
+  while (atomic_load(&trazaEnviando))
+  {
+    vTaskDelay(1);
+  }
+}
+
+/**
+ * @brief Instala el driver de USB-Serial-JTAG y arranca la tarea de vaciado de la traza.
+ * @return `ESP_OK` si la traza está en marcha, o el error correspondiente en caso contrario.
+ * @note Aunque no se llame, @ref logTarea sigue sin bloquear: los registros se descartan al
+ * llenarse los anillos.
+ */
+esp_err_t traza_iniciar()
+{
+  usb_serial_jtag_driver_config_t cfg = USB_SERIAL_JTAG_DRIVER_CONFIG_DEFAULT();
+  cfg.tx_buffer_size = 2 * TRAZA_BYTES_SALIDA;
+  esp_err_t err = usb_serial_jtag_driver_install(&cfg);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+
+  if (xTaskCreate(traza_tarea_vaciado, "traza", 2048, NULL, TRAZA_PRIORIDAD_VACIADO, &tareaVaciadoTraza) != pdPASS)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
@@ -0,0 +1,213 @@
+/**
+ * @file ventana_deslizante.h
+ * @brief Cálculo incremental de las características EMG sobre una ventana deslizante.
+ * @details
+ * Mantiene las últimas @ref CIRCULAR_ARRAY_SIZE muestras y las sumas de @ref sumas_emg
+ * (Σ|x|, Σx, Σx², Σ|dx|). Cada muestra nueva suma su contribución y resta la de la muestra que
+ * sale de la ventana, de modo que el coste por salto es O(@ref SALTO_VENTANA) en lugar de
+ * O(@ref CIRCULAR_ARRAY_SIZE). Con muestras `int16_t` las sumas son enteras y no se acumula error:
+ * el resultado es idéntico al de recalcular la ventana completa con @ref caracteristicas_calcular.
+ * Con @ref EMG_MUESTRA_FLOAT son `double` y el error de restar lo que sale queda muy por debajo
+ * del de la variante entera.
+ *
+ * Cada @ref SALTO_VENTANA muestras (una vez llena la ventana) hay características nuevas y, por
+ * tanto, una nueva decisión de activación.
+ *
+ * Hay una ventana por canal de @ref CANALES_EMG (@ref ventanasEMG). Se reinician y avanzan juntas,
+ * así que saltan en la misma muestra y cada salto produce la matriz completa
+ * @ref caracteristicasEMG (canal × característica).
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "globales.h"
+#include "caracteristicas_emg.h"
+
+_Static_assert(SALTO_VENTANA >= 1 && SALTO_VENTANA <= CIRCULAR_ARRAY_SIZE, "SALTO_VENTANA debe estar entre 1 y CIRCULAR_ARRAY_SIZE");
+
+/**
+ * @struct ventana_deslizante
+ * @brief Historial circular de muestras y sumas de la ventana actual.
+ */
+struct ventana_deslizante
+{
+  muestra_emg_t muestras[CIRCULAR_ARRAY_SIZE]; ///< Historial circular de la ventana.
+  uint32_t indice;                             ///< Muestra más antigua (siguiente posición de escritura).
+  uint32_t llenas;                             ///< Muestras válidas en la ventana (hasta @ref CIRCULAR_ARRAY_SIZE).
+  uint32_t desdeSalto;                         ///< Muestras recibidas desde el último salto.
+  acumulador_emg_t sumaAbs;                    ///< Σ|x| de la ventana.
+  acumulador_emg_t sumaDifAbs;                 ///< Σ|x[i] - x[i-1]| de la ventana.
+  acumulador_emg_t suma;                       ///< Σx de la ventana.
+  acumulador_cuadrados_emg_t sumaCuadrados;    ///< Σx² de la ventana.
+};
+
+struct ventana_deslizante ventanasEMG[NUMERO_CANALES_EMG];           ///< Ventana deslizante de cada canal de la señal EMG filtrada.
+float caracteristicasEMG[NUMERO_CANALES_EMG][NUMERO_CARACTERISTICAS]; ///< Características del último salto, una fila por canal.
+
+/**
+ * @brief Vacía la ventana (tras un cambio de estado o una pérdida de muestras).
+ */
+static inline void ventana_reiniciar(struct ventana_deslizante *v)
+{
+  v->indice = 0;
+  v->llenas = 0;
+  v->desdeSalto = 0;
+  v->sumaAbs = 0;
+  v->sumaDifAbs = 0;
+  v->suma = 0;
+  v->sumaCuadrados = 0;
+}
+
+/**
+ * @brief Vacía las ventanas de todos los canales a la vez, para que sigan saltando en fase.
+ */
+static inline void ventanas_reiniciar()
+{
+  for (int c = 0; c < NUMERO_CANALES_EMG; c++)
+  {
+    ventana_reiniciar(&ventanasEMG[c]);
+  }
+}
+
+/**
+ * @brief Muestras que faltan para que @ref ventana_agregar complete el siguiente salto.
+ */
+static inline uint32_t ventana_hasta_salto(const struct ventana_deslizante *v)
+{
+  return (v->llenas < CIRCULAR_ARRAY_SIZE) ? CIRCULAR_ARRAY_SIZE - v->llenas : SALTO_VENTANA - v->desdeSalto;
+}
+
+/**
+ * @brief Añade una muestra a la ventana actualizando las sumas en O(1).
+ * @param v Ventana.
+ * @param x Muestra nueva.
+ * @retval true  Si se ha completado un salto y hay características nuevas.
+ * @retval false En caso contrario (ventana incompleta o salto en curso).
+ */
+static inline bool ventana_agregar(struct ventana_deslizante *v, muestra_emg_t x)
+{
+  acumulador_emg_t nueva = x;
+
+  if (v->llenas == CIRCULAR_ARRAY_SIZE)
+  {
+    // Sale la muestra más antigua y la diferencia que la unía con la siguiente
+    uint32_t siguienteIndice = (v->indice + 1 == CIRCULAR_ARRAY_SIZE) ? 0 : v->indice + 1;
+    acumulador_emg_t vieja = v->muestras[v->indice];
+    acumulador_emg_t dif = v->muestras[siguienteIndice] - vieja;
+    v->suma -= vieja;
+    v->sumaAbs -= (vieja < 0) ? -vieja : vieja;
+    v->sumaCuadrados -= vieja * vieja;
+    v->sumaDifAbs -= (dif < 0) ? -dif : dif;
+  }
+
+  if (v->llenas > 0)
+  {
+    uint32_t ultimoIndice = (v->indice == 0) ? CIRCULAR_ARRAY_SIZE - 1 : v->indice - 1;
+    acumulador_emg_t dif = nueva - v->muestras[ultimoIndice];
+    v->sumaDifAbs += (dif < 0) ? -dif : dif;
+  }
+
+  v->suma += nueva;
+  v->sumaAbs += (nueva < 0) ? -nueva : nueva;
+  v->sumaCuadrados += nueva * nueva;
+
+  v->muestras[v->indice] = x;
+  v->indice = (v->indice + 1 == CIRCULAR_ARRAY_SIZE) ? 0 : v->indice + 1;
+
+  if (v->llenas < CIRCULAR_ARRAY_SIZE)
+  {
+    v->llenas++;
+    if (v->llenas < CIRCULAR_ARRAY_SIZE)
+    {
+      return false;
+    }
+    v->desdeSalto = 0;
+    return true; // Primera ventana completa
+  }
+
+  if (++v->desdeSalto < SALTO_VENTANA)
+  {
+    return false;
+  }
+  v->desdeSalto = 0;
+  return true;
+}
+
+/**
+ * @brief Obtiene las características de la ventana actual a partir de las sumas acumuladas.
+ * @param v Ventana (debe estar completa).
+ * @param caracteristicas Vector de @ref NUMERO_CARACTERISTICAS resultados (ver @ref Indice_Caracteristica).
+ */
+static inline void ventana_caracteristicas(const struct ventana_deslizante *v, float caracteristicas[NUMERO_CARACTERISTICAS])
+{
+  struct sumas_emg s;
+  s.suma_abs = v->sumaAbs;
+  s.suma_dif_abs = v->sumaDifAbs;
+  s.suma = v->suma;
+  caracteristicas_fijar_cuadrados(&s, v->sumaCuadrados);
+  caracteristicas_desde_sumas(&s, CIRCULAR_ARRAY_SIZE, caracteristicas);
+}
+
+/**
+ * @brief Función llamada en cada salto con las características nuevas.
+ * @param caracteristicas Matriz de características de la ventana de cada canal (@ref caracteristicasEMG).
+ * @param muestra Posición, dentro del bloque, de la muestra que completa el salto.
+ */
+typedef void (*ventana_salto_cb_t)(const float caracteristicas[NUMERO_CANALES_EMG][NUMERO_CARACTERISTICAS], uint32_t muestra);
+
+/**
+ * @brief Pasa un bloque de todos los canales por sus ventanas y actualiza @ref caracteristicasEMG.
+ * @param muestras Bloque de muestras filtradas, una fila por canal (@ref Indice_Canal_EMG).
+ * @param n Número de muestras de cada canal.
+ * @param paso Distancia, en muestras, entre las filas de dos canales consecutivos.
+ * @param alSaltar Función llamada en cada salto completado (puede ser `NULL`).
+ * @details El bloque se recorre por tramos que terminan en un salto: dentro de cada tramo se
+ * procesa un canal entero antes de pasar al siguiente, sobre memoria consecutiva. En cada salto
+ * se actualizan también @ref MAVEMG, @ref VarianzaEMG y @ref WLEMG con el canal principal.
+ * @return Número de saltos completados en el bloque (decisiones nuevas disponibles).
+ */
+uint32_t ventana_procesar_bloque(const muestra_emg_t *muestras, uint32_t n, uint32_t paso, ventana_salto_cb_t alSaltar)
+{
+  uint32_t saltos = 0;
+
+  for (uint32_t i = 0; i < n;)
+  {
+    uint32_t tramo = ventana_hasta_salto(&ventanasEMG[0]);
+    if (tramo > n - i)
+    {
+      tramo = n - i;
+    }
+
+    // Solo la última muestra del tramo puede completar un salto, y lo hace en todos los canales
+    bool salto = false;
+    for (uint32_t c = 0; c < NUMERO_CANALES_EMG; c++)
+    {
+      const muestra_emg_t *x = &muestras[c * paso + i];
+      for (uint32_t k = 0; k < tramo; k++)
+      {
+        salto = ventana_agregar(&ventanasEMG[c], x[k]);
+      }
+    }
+    i += tramo;
+    if (!salto)
+    {
+      continue;
+    }
+
+    saltos++;
+    for (uint32_t c = 0; c < NUMERO_CANALES_EMG; c++)
+    {
+      ventana_caracteristicas(&ventanasEMG[c], caracteristicasEMG[c]);
+    }
+    MAVEMG = caracteristicasEMG[CANAL_EMG_PRINCIPAL][CARACTERISTICA_MAV];
+    VarianzaEMG = caracteristicasEMG[CANAL_EMG_PRINCIPAL][CARACTERISTICA_VARIANZA];
+    WLEMG = caracteristicasEMG[CANAL_EMG_PRINCIPAL][CARACTERISTICA_WL];
+    if (alSaltar != NULL)
+    {
+      alSaltar(caracteristicasEMG, i - 1);
+    }
+  }
+  return saltos;
+}
@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+"""
+Comprobación tras el enlazado: las rutinas de interrupción solo alcanzan código y datos en RAM interna.
+
+Recorre el grafo de llamadas del ELF desde cada raíz (las rutinas registradas como IRAM-safe) con el
+desensamblado de objdump y falla si encuentra:
+- una función alcanzable fuera de IRAM o ROM (código en flash, que se detiene con la caché
+  desactivada durante las escrituras en flash: NVS, OTA);
+- en las funciones del componente `main`, un literal que apunta a flash (código o constantes en
+  `.flash.rodata`, por ejemplo una tabla `const` sin `DRAM_ATTR` o una cadena de formato).
+
+En Xtensa una llamada de IRAM a flash no cabe en el alcance de `call8` y se hace siempre con
+`l32r` + `callx8`, así que revisar los literales cubre también esas llamadas. Las funciones de
+ESP-IDF se comprueban solo en su punto de entrada: su contenido es responsabilidad de las opciones
+`*_ISR_IRAM_SAFE` de `sdkconfig`, y su camino de `assert` (que aborta igualmente) usa cadenas en flash.
+
+Un literal numérico que caiga en un rango de flash (por ejemplo algunos `float`) da un falso
+positivo; en una rutina de interrupción no debe haber coma flotante.
+
+Uso: comprobar_iram.py --objdump OBJDUMP --nm NM --componente libmain.a programa.elf raiz [raiz ...]
+"""
+
+import argparse
+import re
+import struct
+import subprocess
+import sys
+
+# Mapa de memoria del ESP32-S3 (TRM, tabla 4-1), solo lo necesario para clasificar direcciones
+REGIONES = [
+    (0x40000000, 0x40060000, "rom"),
+    (0x40370000, 0x403E0000, "iram"),
+    (0x600FE000, 0x60100000, "rtc"),
+    (0x42000000, 0x44000000, "flash"),
+    (0x3C000000, 0x3E000000, "flash"),
+    (0x3FC88000, 0x3FD00000, "dram"),
+    (0x3FF00000, 0x3FF20000, "rom"),
+]
+
+RE_SIMBOLO = re.compile(r"^([0-9a-f]{8}) (.{7}) (\S+)\s+([0-9a-f]+)\s+(\S+)$")
+RE_INSTRUCCION = re.compile(r"^\s*([0-9a-f]+):\s+(\S+)\s*(.*)$")
+RE_DESTINO = re.compile(r"([0-9a-f]{8}) <")
+RE_L32R = re.compile(r"a\d+, ([0-9a-f]{8}) <")
+
+
+def region(direccion):
+    for inicio, fin, nombre in REGIONES:
+        if inicio <= direccion < fin:
+            return nombre
+    return "otra"
+
+
+class Elf:
+    """Lector mínimo de ELF32 little-endian: solo el contenido de las secciones con datos."""
+
+    def __init__(self, ruta):
+        with open(ruta, "rb") as f:
+            self.datos = f.read()
+        if self.datos[:4] != b"\x7fELF" or self.datos[4] != 1 or self.datos[5] != 1:
+            raise ValueError(f"{ruta}: no es un ELF32 little-endian")
+        shoff, = struct.unpack_from("<I", self.datos, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", self.datos, 0x2E)
+        self.secciones = []
+        for i in range(shnum):
+            _, tipo, _, addr, offset, size = struct.unpack_from("<IIIIII", self.datos, shoff + i * shentsize)
+            if tipo == 1 and addr != 0:  # SHT_PROGBITS
+                self.secciones.append((addr, size, offset))
+
+    def palabra(self, direccion):
+        for addr, size, offset in self.secciones:
+            if addr <= direccion and direccion + 4 <= addr + size:
+                return struct.unpack_from("<I", self.datos, offset + direccion - addr)[0]
+        return None
+
+
+def ejecutar(*orden):
+    return subprocess.run(orden, check=True, capture_output=True, text=True).stdout
+
+
+def leer_funciones(objdump, elf):
+    """Funciones del ELF: dirección -> (nombre, tamaño), y nombre -> [direcciones]."""
+    por_direccion = {}
+    por_nombre = {}
+    for linea in ejecutar(objdump, "-t", elf).splitlines():
+        m = RE_SIMBOLO.match(linea)
+        if not m or "F" not in m.group(2):
+            continue
+        direccion, tamano, nombre = int(m.group(1), 16), int(m.group(4), 16), m.group(5)
+        if tamano == 0:
+            continue
+        por_direccion[direccion] = (nombre, tamano)
+        por_nombre.setdefault(nombre, []).append(direccion)
+    return por_direccion, por_nombre
+
+
+def leer_componente(nm, archivo):
+    """Nombres de las funciones definidas en el componente (globales y estáticas)."""
+    nombres = set()
+    for linea in ejecutar(nm, "--defined-only", archivo).splitlines():
+        partes = linea.split()
+        if len(partes) == 3 and partes[1] in "tT":
+            nombres.add(partes[2])
+    return nombres
+
+
+def desensamblar(objdump, elf, direccion, tamano):
+    salida = ejecutar(objdump, "-d", "--no-show-raw-insn", f"--start-address={direccion:#x}",
+                      f"--stop-address={direccion + tamano:#x}", elf)
+    for linea in salida.splitlines():
+        m = RE_INSTRUCCION.match(linea)
+        if m:
+            yield int(m.group(1), 16), m.group(2), m.group(3)
+
+
+def comprobar(args):
+    imagen = Elf(args.elf)
+    funciones, por_nombre = leer_funciones(args.objdump, args.elf)
+    propias = leer_componente(args.nm, args.componente)
+
+    errores = []
+    pendientes = []
+    for raiz in args.raices:
+        if raiz not in por_nombre:
+            # Sin símbolo la rutina no está enlazada y no puede ejecutarse (p. ej. ENCODER_PCNT a 0)
+            print(f"comprobar_iram: aviso: {raiz} no está en el ELF, se omite")
+            continue
+        pendientes += [(d, [raiz]) for d in por_nombre[raiz]]
+
+    visitadas = set()
+    while pendientes:
+        direccion, camino = pendientes.pop()
+        if direccion in visitadas:
+            continue
+        visitadas.add(direccion)
+        nombre, tamano = funciones[direccion]
+        ruta = " -> ".join(camino)
+
+        if region(direccion) not in ("iram", "rom", "rtc"):
+            errores.append(f"{ruta}: {nombre} está en {region(direccion)} ({direccion:#010x})")
+            continue
+        if nombre not in propias:
+            continue
+
+        for pc, mnemonico, operandos in desensamblar(args.objdump, args.elf, direccion, tamano):
+            destino = None
+            if mnemonico in ("call0", "call4", "call8", "call12", "j"):
+                m = RE_DESTINO.search(operandos)
+                if m:
+                    destino = int(m.group(1), 16)
+                    if mnemonico == "j" and direccion <= destino < direccion + tamano:
+                        continue
+            elif mnemonico == "l32r":
+                m = RE_L32R.search(operandos)
+                valor = imagen.palabra(int(m.group(1), 16)) if m else None
+                if valor is None:
+                    continue
+                if region(valor) == "flash":
+                    objetivo = funciones.get(valor, (f"{valor:#010x}", 0))[0]
+                    errores.append(f"{ruta}: {nombre}+{pc - direccion:#x} referencia {objetivo} en flash")
+                    continue
+                if valor in funciones:
+                    destino = valor
+            if destino is None:
+                continue
+            if destino not in funciones:
+                if region(destino) not in ("iram", "rom", "rtc"):
+                    errores.append(f"{ruta}: {nombre}+{pc - direccion:#x} salta a {destino:#010x} fuera de IRAM")
+                continue
+            pendientes.append((destino, camino + [funciones[destino][0]]))
+
+    for error in errores:
+        print(f"comprobar_iram: error: {error}", file=sys.stderr)
+    if errores:
+        print(f"comprobar_iram: {len(errores)} referencias a flash alcanzables desde las ISR", file=sys.stderr)
+        return 1
+    print(f"comprobar_iram: {len(visitadas)} funciones alcanzables desde {len(args.raices)} raíces, todas en RAM interna")
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--objdump", required=True, help="objdump de la cadena Xtensa")
+    parser.add_argument("--nm", required=True, help="nm de la cadena Xtensa")
+    parser.add_argument("--componente", required=True, help="biblioteca del componente cuyas funciones se revisan enteras")
+    parser.add_argument("elf", help="programa enlazado")
+    parser.add_argument("raices", nargs="+", help="rutinas de interrupción registradas como IRAM-safe")
+    return comprobar(parser.parse_args())
+
+
+if __name__ == "__main__":
+    sys.exit(main())